@@ -0,0 +1,292 @@
+#!/usr/bin/env python3
+"""
+Differential harness between the Python and C++ implementations.
+
+Converts every PNG of a corpus (see `make corpus` in cpp/) with both
+vectorizer.py and the png2svg binary, using option 0 as `--auto` does, and
+compares the results: palette, number of paths and, when an SVG renderer
+is available, a rasterized difference score. Also reports how much faster
+the C++ version is per image and overall.
+"""
+
+import argparse
+import contextlib
+import io
+import json
+import math
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+from pathlib import Path
+from typing import Any, Dict, List
+
+import numpy as np
+from PIL import Image
+
+REPO_DIR = Path(__file__).resolve().parent
+DEFAULT_BINARY = REPO_DIR / 'cpp' / 'build' / 'bin' / 'png2svg'
+DEFAULT_CORPUS = REPO_DIR / 'cpp' / 'build' / 'corpus'
+
+
+def count_paths(svg_content: str) -> int:
+    """Number of <path> elements in an SVG."""
+    return svg_content.count('<path')
+
+
+def find_rasterizer():
+    """
+    Return a function rendering SVG text to an RGB array of a given size,
+    or None if neither cairosvg nor rsvg-convert is available.
+    """
+    try:
+        import cairosvg
+
+        def render(svg_content: str, width: int, height: int) -> np.ndarray:
+            png = cairosvg.svg2png(bytestring=svg_content.encode('utf-8'),
+                                   output_width=width, output_height=height)
+            return flatten(Image.open(io.BytesIO(png)))
+        return render
+    except ImportError:
+        pass
+
+    if shutil.which('rsvg-convert'):
+        def render(svg_content: str, width: int, height: int) -> np.ndarray:
+            result = subprocess.run(['rsvg-convert', '-w', str(width), '-h', str(height)],
+                                    input=svg_content.encode('utf-8'), capture_output=True, check=True)
+            return flatten(Image.open(io.BytesIO(result.stdout)))
+        return render
+
+    return None
+
+
+def flatten(img: Image.Image) -> np.ndarray:
+    """Composite an image onto white and return it as a float RGB array."""
+    img = img.convert('RGBA')
+    background = Image.new('RGBA', img.size, (255, 255, 255, 255))
+    return np.asarray(Image.alpha_composite(background, img).convert('RGB'), dtype=np.float32)
+
+
+def raster_difference(render, python_svg: str, cpp_svg: str, width: int, height: int) -> float:
+    """
+    Mean absolute difference of the two SVGs rendered at the image size,
+    as a percentage of full scale (0 = identical, 100 = black vs white).
+    """
+    a = render(python_svg, width, height)
+    b = render(cpp_svg, width, height)
+    return float(np.abs(a - b).mean() / 255.0 * 100.0)
+
+
+def run_python(png_path: Path, work_dir: Path, option_index: int) -> Dict[str, Any]:
+    """
+    Inspect and convert one image with vectorizer.py, timed in-process.
+    vectorizer.py works on ./<name>.png, so the image is copied into
+    `work_dir` and converted there.
+    """
+    from colorthief import ColorThief
+    from vectorizer import Vectorizer, inspect_image, parse_image
+
+    shutil.copy2(png_path, work_dir / png_path.name)
+    cwd = os.getcwd()
+    os.chdir(work_dir)
+    try:
+        # replace_colors samples pixels at random
+        np.random.seed(0)
+        start = time.perf_counter()
+        options = inspect_image(png_path.stem)
+        if not options:
+            raise RuntimeError('没有矢量化选项')
+        option = options[min(option_index, len(options) - 1)]
+        with contextlib.redirect_stdout(io.StringIO()):
+            svg_content = parse_image(png_path.stem, option['step'], option['colors'])
+        ms = (time.perf_counter() - start) * 1000.0
+    finally:
+        os.chdir(cwd)
+
+    # The full dominant-color palette, as png2svg records it in the manifest
+    palette = [Vectorizer.rgb_to_hex(c) for c in
+               ColorThief(str(png_path)).get_palette(color_count=5, quality=1)]
+    return {'svg': svg_content, 'ms': ms, 'option': option, 'palette': palette}
+
+
+def run_cpp(binary: Path, corpus: List[Path], work_dir: Path, option_index: int) -> Dict[str, Dict[str, Any]]:
+    """
+    Convert the whole corpus with png2svg in directory mode and read the
+    per-image results and timings from its manifest, so process start-up
+    is not charged to any image.
+    """
+    for png_path in corpus:
+        shutil.copy2(png_path, work_dir / png_path.name)
+    manifest = work_dir / 'manifest.jsonl'
+    subprocess.run([str(binary), str(work_dir), '--auto', '--option', str(option_index),
+                    '--manifest', str(manifest), '--log-level', 'warn'],
+                   check=False, stdout=subprocess.DEVNULL)
+
+    results = {}
+    with open(manifest, encoding='utf-8') as f:
+        for line in f:
+            entry = json.loads(line)
+            name = Path(entry['input']).name
+            if entry['status'] != 'ok':
+                results[name] = {'error': entry['error']}
+                continue
+            with open(entry['output'], encoding='utf-8') as svg:
+                svg_content = svg.read()
+            option = entry['option']
+            results[name] = {
+                'svg': svg_content,
+                'ms': entry['wallMs'],
+                'option': {'step': option['step'], 'colors': option['colors']},
+                'palette': entry['palette'],
+                'width': entry['width'],
+                'height': entry['height'],
+            }
+    return results
+
+
+def compare_image(name: str, python: Dict[str, Any], cpp: Dict[str, Any], render) -> Dict[str, Any]:
+    """Differences between the two conversions of one image."""
+    row = {
+        'image': name,
+        'pythonMs': python['ms'],
+        'cppMs': cpp['ms'],
+        'speedup': python['ms'] / cpp['ms'] if cpp['ms'] > 0 else math.inf,
+        'optionEqual': python['option'] == cpp['option'],
+        'paletteEqual': [c.lower() for c in python['palette']] == [c.lower() for c in cpp['palette']],
+        'pythonPaths': count_paths(python['svg']),
+        'cppPaths': count_paths(cpp['svg']),
+        'rasterDiff': None,
+    }
+    if render is not None:
+        try:
+            row['rasterDiff'] = raster_difference(render, python['svg'], cpp['svg'], cpp['width'], cpp['height'])
+        except Exception as e:
+            row['renderError'] = str(e)
+    return row
+
+
+def geometric_mean(values: List[float]) -> float:
+    values = [v for v in values if v > 0 and math.isfinite(v)]
+    if not values:
+        return 0.0
+    return math.exp(sum(math.log(v) for v in values) / len(values))
+
+
+def print_report(rows: List[Dict[str, Any]], failures: List[str], max_diff: float) -> int:
+    """Print the comparison table and summary; return the number of mismatches."""
+    print(f"{'image':<28} {'py ms':>9} {'c++ ms':>9} {'speedup':>8} {'option':>7} "
+          f"{'palette':>8} {'paths py/c++':>14} {'diff %':>7}")
+    mismatches = 0
+    for row in rows:
+        diff = row['rasterDiff']
+        mismatch = (not row['optionEqual'] or not row['paletteEqual'] or
+                    row['pythonPaths'] != row['cppPaths'] or (diff is not None and diff > max_diff))
+        mismatches += mismatch
+        print(f"{row['image']:<28} {row['pythonMs']:>9.1f} {row['cppMs']:>9.1f} {row['speedup']:>7.1f}x "
+              f"{'=' if row['optionEqual'] else '≠':>7} {'=' if row['paletteEqual'] else '≠':>8} "
+              f"{str(row['pythonPaths']) + '/' + str(row['cppPaths']):>14} "
+              f"{'-' if diff is None else f'{diff:.2f}':>7}{'  !' if mismatch else ''}")
+
+    total_python = sum(row['pythonMs'] for row in rows)
+    total_cpp = sum(row['cppMs'] for row in rows)
+    print()
+    print(f"图片: {len(rows)} 张比较, {len(failures)} 张转换失败, {mismatches} 张结果不一致")
+    if rows:
+        print(f"选项一致: {sum(r['optionEqual'] for r in rows)}/{len(rows)}, "
+              f"调色板一致: {sum(r['paletteEqual'] for r in rows)}/{len(rows)}, "
+              f"路径数一致: {sum(r['pythonPaths'] == r['cppPaths'] for r in rows)}/{len(rows)}")
+        diffs = [r['rasterDiff'] for r in rows if r['rasterDiff'] is not None]
+        if diffs:
+            print(f"栅格差异: 平均 {sum(diffs) / len(diffs):.2f}%, 最大 {max(diffs):.2f}% (阈值 {max_diff}%)")
+        else:
+            print("栅格差异: 未计算（需要 cairosvg 或 rsvg-convert）")
+        print(f"总耗时: Python {total_python / 1000:.2f} s, C++ {total_cpp / 1000:.2f} s, "
+              f"总加速 {total_python / total_cpp if total_cpp > 0 else 0:.1f}x, "
+              f"每张图片几何平均加速 {geometric_mean([r['speedup'] for r in rows]):.1f}x")
+    for failure in failures:
+        print(f"  ✗ {failure}")
+    return mismatches
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='比较Python与C++实现在同一图片集上的输出与速度',
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+        epilog='''
+示例:
+  # 先生成图片集并构建C++版本
+  make -C cpp all corpus
+
+  python compare.py
+  python compare.py cpp/build/corpus --json compare.json
+  python compare.py /path/to/pngs --binary cpp/build/bin/png2svg --max-diff 1
+        ''')
+    parser.add_argument('corpus', nargs='?', default=str(DEFAULT_CORPUS),
+                        help=f'PNG图片目录（默认: {DEFAULT_CORPUS.relative_to(REPO_DIR)}）')
+    parser.add_argument('--binary', default=str(DEFAULT_BINARY),
+                        help=f'png2svg可执行文件（默认: {DEFAULT_BINARY.relative_to(REPO_DIR)}）')
+    parser.add_argument('--option', type=int, default=0, help='两边都使用第N个矢量化选项（默认: 0）')
+    parser.add_argument('--max-diff', type=float, default=0.5,
+                        help='栅格差异超过该百分比即为不一致（默认: 0.5）')
+    parser.add_argument('--json', help='把每张图片的比较结果与速度比写入JSON文件')
+    args = parser.parse_args()
+
+    corpus_dir = Path(args.corpus)
+    binary = Path(args.binary)
+    corpus = sorted(corpus_dir.glob('*.png'))
+    if not corpus:
+        print(f"错误: 目录中没有PNG文件 - {corpus_dir}")
+        return 1
+    if not binary.exists():
+        print(f"错误: 找不到png2svg - {binary}（先运行 make -C cpp）")
+        return 1
+
+    render = find_rasterizer()
+    rows = []
+    failures = []
+    with tempfile.TemporaryDirectory() as tmp:
+        python_dir = Path(tmp) / 'python'
+        cpp_dir = Path(tmp) / 'cpp'
+        python_dir.mkdir()
+        cpp_dir.mkdir()
+
+        print(f"C++: 转换 {len(corpus)} 张图片...")
+        cpp_results = run_cpp(binary, corpus, cpp_dir, args.option)
+
+        for i, png_path in enumerate(corpus, 1):
+            print(f"Python: [{i}/{len(corpus)}] {png_path.name}", file=sys.stderr)
+            cpp = cpp_results.get(png_path.name, {'error': '没有结果'})
+            try:
+                python = run_python(png_path, python_dir, args.option)
+            except Exception as e:
+                failures.append(f"{png_path.name}: Python - {e}")
+                continue
+            if 'error' in cpp:
+                failures.append(f"{png_path.name}: C++ - {cpp['error']}")
+                continue
+            rows.append(compare_image(png_path.name, python, cpp, render))
+
+    print()
+    mismatches = print_report(rows, failures, args.max_diff)
+
+    if args.json:
+        with open(args.json, 'w', encoding='utf-8') as f:
+            json.dump({
+                'corpus': str(corpus_dir),
+                'option': args.option,
+                'maxDiff': args.max_diff,
+                'speedupTotal': (sum(r['pythonMs'] for r in rows) / sum(r['cppMs'] for r in rows)
+                                 if rows else 0),
+                'speedupGeometricMean': geometric_mean([r['speedup'] for r in rows]),
+                'images': rows,
+                'failures': failures,
+            }, f, ensure_ascii=False, indent=2)
+        print(f"结果已写入: {args.json}")
+
+    return 1 if mismatches or failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
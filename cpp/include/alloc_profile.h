@@ -0,0 +1,71 @@
+#ifndef ALLOC_PROFILE_H
+#define ALLOC_PROFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Heap allocations and large copies made by one thread
+struct AllocCounters {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t copies = 0;      // copies of at least AllocProfile::kLargeCopy bytes
+    uint64_t copyBytes = 0;
+
+    AllocCounters& operator+=(const AllocCounters& other) {
+        allocations += other.allocations;
+        bytes += other.bytes;
+        copies += other.copies;
+        copyBytes += other.copyBytes;
+        return *this;
+    }
+
+    AllocCounters operator-(const AllocCounters& other) const {
+        return {allocations - other.allocations, bytes - other.bytes,
+                copies - other.copies, copyBytes - other.copyBytes};
+    }
+};
+
+// Per-stage allocation and copy accounting.
+//
+// In profiling builds (cmake -DPNG2SVG_PROFILE=ON) the global operator new
+// is replaced to count every heap allocation per thread, and the SVG passes
+// report whole-document copies through countCopy(). The vectorizer's stage
+// clock charges the difference to each stage. Normal builds compile the
+// counting away; the counters then stay zero and only stage times are kept.
+class AllocProfile {
+public:
+#ifdef PNG2SVG_PROFILE
+    static constexpr bool kCounting = true;
+#else
+    static constexpr bool kCounting = false;
+#endif
+
+    // Smallest copy worth reporting
+    static constexpr size_t kLargeCopy = 4096;
+
+    // Counters of the calling thread since it started
+    static AllocCounters current();
+
+    // Note a copy of `bytes` bytes made by the calling thread
+    static void countCopy(size_t bytes) {
+        if (kCounting && bytes >= kLargeCopy) {
+            addCopy(bytes);
+        }
+    }
+
+    // Start collecting process-wide per-stage totals for report()
+    static void enable();
+    static bool enabled();
+
+    // Add one run of a stage to the totals; no-op unless enabled
+    static void addStage(const char* stage, double ms, const AllocCounters& counters);
+
+    // Print the per-stage totals as a table
+    static void report(std::ostream& out);
+
+private:
+    static void addCopy(size_t bytes);
+};
+
+#endif // ALLOC_PROFILE_H
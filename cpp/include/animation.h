@@ -0,0 +1,58 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "vectorizer.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// How a traced animated GIF is written out
+enum class AnimationOutput {
+    Smil,     // one SVG, its frames shown in turn by SMIL <animate>
+    Frames    // one SVG per frame: <name>_0001.svg, <name>_0002.svg, ...
+};
+
+// Frames of a GIF, each composited onto the full canvas as RGBA
+struct GifFrames {
+    int width = 0;
+    int height = 0;
+    int count = 0;
+    std::vector<int> delaysMs;     // display time of each frame
+    std::vector<uint8_t> pixels;   // count x height x width x 4
+};
+
+// An animation traced with one option and one palette for all frames
+struct TracedAnimation {
+    int width = 0;
+    int height = 0;
+    std::vector<int> delaysMs;
+    std::vector<std::string> frames;   // one SVG document per frame
+    int optionIndex = 0;
+    VectorizationOption option{};
+    ConversionStats stats;             // over all frames; palette is the shared one
+    size_t tiles = 0;                  // of all frames
+    size_t tilesTraced = 0;
+};
+
+// True if the data starts with a GIF signature
+bool isGif(const uint8_t* data, size_t size);
+
+// Decode every frame; throws std::runtime_error if the GIF is invalid
+GifFrames decodeGif(const uint8_t* data, size_t size);
+
+// Choose the option and palette from all frames at once, so colors do not
+// flicker between frames, then trace the frames on `jobs` threads. Each
+// thread takes a run of consecutive frames and passes them through one
+// TileCache, so a frame only retraces the tiles that differ from the frame
+// before it. Throws std::runtime_error if the GIF cannot be traced.
+TracedAnimation traceAnimation(const uint8_t* data, size_t size, int optionIndex, int jobs, int tileSize);
+
+// One SVG showing the frames in turn with their delays, looping forever
+std::string animatedSvg(const TracedAnimation& animation);
+
+// File name of frame `index` of `count`, numbered from 1 with at least
+// four digits
+std::string frameFileName(const std::string& stem, size_t index, size_t count);
+
+#endif // ANIMATION_H
@@ -0,0 +1,104 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+// Per-job scratch memory.
+//
+// Every temporary buffer of a conversion (decoded pixels, gray buffers, SVG
+// string passes, stb_image internals) is carved out of one monotonic arena.
+// Nothing is freed individually; the whole arena is dropped when the job ends.
+// The arena keeps its backing block between jobs and grows it to the largest
+// job seen so far, so in steady state a reset is O(1) and the global
+// allocator is not touched at all. Overflow chunks come from the BufferPool.
+class JobArena {
+public:
+    explicit JobArena(size_t initialCapacity = 1 << 20);
+    ~JobArena();
+
+    JobArena(const JobArena&) = delete;
+    JobArena& operator=(const JobArena&) = delete;
+
+    // Memory resource for std::pmr containers
+    std::pmr::memory_resource* resource() { return &counting_; }
+
+    // Raw allocation from the arena
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    // Drop everything allocated since the last reset
+    void reset();
+
+    // Bytes handed out since the last reset
+    size_t bytesInUse() const { return used_; }
+
+    // Size of the retained backing block
+    size_t capacity() const { return block_.size(); }
+
+    // Arena of the calling thread (created on first use)
+    static JobArena& local();
+
+    // Resource for the job running on this thread, or the default resource
+    // when no job is active
+    static std::pmr::memory_resource* current();
+
+    // True while an ArenaScope is open on this thread
+    static bool active();
+
+private:
+    // Upstream that records how much the job overflowed the backing block
+    class OverflowResource : public std::pmr::memory_resource {
+    public:
+        size_t overflow = 0;
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    // Resource wrapper that tracks bytes handed out, for reporting and sizing
+    class CountingResource : public std::pmr::memory_resource {
+    public:
+        explicit CountingResource(JobArena& arena) : arena_(arena) {}
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+        JobArena& arena_;
+    };
+
+    void rebuild();
+
+    std::vector<std::byte> block_;
+    OverflowResource upstream_;
+    std::optional<std::pmr::monotonic_buffer_resource> monotonic_;
+    CountingResource counting_{*this};
+    size_t used_ = 0;
+
+    friend class ArenaScope;
+};
+
+// Marks the extent of one conversion job on the calling thread.
+// Scopes nest; the arena is reset when the outermost scope closes.
+class ArenaScope {
+public:
+    ArenaScope();
+    ~ArenaScope();
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+};
+
+// malloc-style entry points used as the stb_image allocation hooks.
+// Large blocks come from the thread's BufferPool (or scratch files for
+// out-of-core jobs); smaller ones come from the
+// arena inside a job (free is a no-op) and from the C heap outside one.
+// arenaRealloc's `oldSize` must be the bytes in use, as STBI_REALLOC_SIZED
+// passes them.
+void* arenaMalloc(size_t size);
+void* arenaRealloc(void* p, size_t oldSize, size_t newSize);
+void arenaFree(void* p);
+
+#endif // ARENA_H
@@ -0,0 +1,80 @@
+#ifndef BATCH_IO_H
+#define BATCH_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Contents of a whole file, or why it could not be read
+struct FileData {
+    std::string path;
+    std::vector<uint8_t> bytes;
+    std::string error;
+    uint64_t hash = 0;   // contentHash of `bytes`, computed on the reader thread
+};
+
+// An output to publish as a copy of another, already written one
+struct OutputCopy {
+    std::string source;
+    std::string path;
+};
+
+// Batched file I/O for directory conversion.
+//
+// A reader thread reads upcoming inputs ahead of the converter and a writer
+// thread writes finished outputs behind it, one batch at a time. On Linux a
+// batch goes through io_uring: the opens, the reads or writes, and the
+// closes of the whole batch are one submission each, instead of several
+// syscalls per file. Where io_uring is unavailable (other platforms, old
+// kernels, seccomp) the threads use ordinary blocking calls instead. Either
+// way the converting thread only waits when it gets ahead of the reads.
+//
+// Outputs are published atomically: each is written to a hidden temp file
+// in the target directory and renamed over the final name once complete,
+// so readers never see a half-written file. With `sync`, every batch is
+// fsync'd before its renames and the target directory after them.
+class BatchIO {
+public:
+    explicit BatchIO(size_t batchSize = 32, bool sync = false);
+    ~BatchIO();
+
+    BatchIO(const BatchIO&) = delete;
+    BatchIO& operator=(const BatchIO&) = delete;
+
+    // Queue files to read ahead; nextRead() returns them in this order
+    void prefetch(const std::vector<std::string>& paths);
+
+    // Next prefetched file, blocking until it has been read
+    FileData nextRead();
+
+    // Queue `data` to be written to `path` (created or replaced)
+    void write(const std::string& path, std::string data);
+
+    // Wait for all queued writes; returns one message per failed write
+    std::vector<std::string> flush();
+
+    // Publish each copy's `path` as a hard link to its `source`, or as a
+    // copy of it when `link` is false or the file system refuses links,
+    // atomically and durably like write(). Call after flush(); returns one
+    // message per failed copy.
+    std::vector<std::string> copyOutputs(const std::vector<OutputCopy>& copies, bool link);
+
+    // "io_uring" or "threads"
+    const char* backend() const;
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+// 64-bit hash of a file's contents, for spotting duplicate inputs. Not
+// cryptographic: equal hashes still need a byte comparison.
+uint64_t contentHash(const uint8_t* data, size_t size);
+
+// Flush a file or directory to stable storage; false on failure.
+// A no-op on platforms without fsync.
+bool syncPath(const std::string& path);
+
+#endif // BATCH_IO_H
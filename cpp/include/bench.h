@@ -0,0 +1,97 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "alloc_profile.h"
+#include "vectorizer.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// PNG file of a benchmark corpus, held in memory
+struct CorpusImage {
+    std::string name;
+    std::vector<uint8_t> png;
+};
+
+// Outcome of converting one image once
+struct Conversion {
+    bool ok = false;
+    double ms = 0;
+    uint64_t svgHash = 0;          // FNV-1a of the SVG bytes
+    ConversionStats stats;
+};
+
+// Every PNG in `dir`, in name order. Throws std::runtime_error if the
+// directory has none or a file cannot be read.
+std::vector<CorpusImage> loadCorpus(const std::string& dir);
+
+// Inspect and convert like the batch modes do, keeping the SVG in memory;
+// failures are logged at debug level
+void convertCorpusImage(const CorpusImage& image, int optionIndex, Conversion& result);
+
+// Settings of `png2svg bench`
+struct BenchOptions {
+    std::string corpus;            // directory of PNG files
+    int warmup = 1;                // untimed passes before each thread count
+    int iterations = 5;            // timed passes per thread count
+    std::vector<int> threads;      // thread counts to compare, ascending
+    int optionIndex = 0;           // vectorization option, as with --option
+};
+
+// Measurements of one thread count
+struct BenchRun {
+    int threads = 1;
+    std::vector<double> passMs;     // wall time of each timed pass
+    std::vector<size_t> passImages; // successful conversions in each timed pass
+    std::vector<double> latencyMs;  // every successful conversion, all passes
+    size_t images = 0;              // successful conversions, all passes
+    size_t failures = 0;
+    size_t downgrades = 0;          // conversions that hit a complexity cap
+    double megapixels = 0;          // pixels converted, all passes
+    double peakResidentBytes = 0;   // during this thread count, 0 if unknown
+    double cpuMs = 0;               // converting threads
+    double potraceCpuMs = 0;        // potrace child processes
+    std::vector<std::pair<std::string, double>> stageMs;              // summed, pipeline order
+    std::vector<std::pair<std::string, AllocCounters>> stageAllocs;   // profiling builds only
+
+    // Per corpus image, in name order: its latency in each timed pass where
+    // it converted
+    std::vector<std::pair<std::string, std::vector<double>>> imageMs;
+
+    // Per corpus image, in the same order: the distinct hashes of its SVG
+    // over all passes, one unless the output varied
+    std::vector<std::vector<uint64_t>> imageHashes;
+
+    double seconds() const;
+    double imagesPerSecond() const;
+    double megapixelsPerSecond() const;
+
+    // Throughput of each timed pass, the samples a baseline compares
+    std::vector<double> passImagesPerSecond() const;
+
+    // Latency at quantile q in [0, 1], nearest rank
+    double latencyPercentile(double q) const;
+};
+
+// Convert every PNG in the corpus `iterations` times per thread count,
+// in memory, discarding the SVGs. Throws std::runtime_error if the corpus
+// has no PNG files or cannot be read.
+std::vector<BenchRun> runBenchmark(const BenchOptions& options);
+
+// Corpus images whose SVG was not byte-identical across every pass and
+// thread count, in name order
+std::vector<std::string> nondeterministicImages(const std::vector<BenchRun>& runs);
+
+// Corpus images with a conversion slower than `maxMs` in any pass and
+// thread count, with their slowest time, in name order
+std::vector<std::pair<std::string, double>> slowImages(const std::vector<BenchRun>& runs, double maxMs);
+
+// Throughput, latency and scaling table followed by the per-stage breakdown
+void printBenchReport(const BenchOptions& options, const std::vector<BenchRun>& runs, std::ostream& out);
+
+// `png2svg bench ...`; argv[0] is "bench". Returns the exit code.
+int benchCommand(int argc, char* argv[]);
+
+#endif // BENCH_H
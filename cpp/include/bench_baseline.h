@@ -0,0 +1,56 @@
+#ifndef BENCH_BASELINE_H
+#define BENCH_BASELINE_H
+
+#include "bench.h"
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// One benchmarked quantity with a sample per timed pass
+struct BenchSeries {
+    std::string name;              // "throughput/threads=4", "latency/logo_256_rgb.png"
+    std::string unit;              // "images/s" or "ms"
+    bool higherIsBetter = false;
+    std::vector<double> samples;
+};
+
+// Benchmark results saved as JSON for later comparison. The file records
+// the format version, the converter version and host that produced it,
+// the settings of the run and every series with its raw samples.
+struct BenchBaseline {
+    static constexpr int kFormatVersion = 1;
+
+    std::string converterVersion;
+    std::string created;           // UTC, ISO 8601
+    std::string host;
+    int hardwareThreads = 0;
+    BenchOptions options;
+    std::vector<BenchSeries> series;
+    // Profiling builds only: per-stage allocation and copy counts of the
+    // first thread count, summed over the timed passes
+    std::vector<std::pair<std::string, AllocCounters>> stageAllocs;
+};
+
+// Series of a finished benchmark: throughput per thread count, and the
+// latency of each image at the first thread count; profiling builds also
+// keep that thread count's stage allocation counts
+BenchBaseline makeBaseline(const BenchOptions& options, const std::vector<BenchRun>& runs);
+
+// Throw std::runtime_error if the file cannot be written, read or parsed,
+// or was written by a newer format version
+void saveBaseline(const BenchBaseline& baseline, const std::string& path);
+BenchBaseline loadBaseline(const std::string& path);
+
+// Compare each series present in both runs with Welch's t-test at 95%
+// confidence and print a table of the changes. A throughput series
+// regresses when the whole confidence interval of its change lies on the
+// slow side and the estimated slowdown is at least `thresholdPercent`.
+// A latency series must meet the same test and also survive a
+// Holm-Bonferroni correction over all latency series. Stage allocation
+// counts, when both runs have them, regress on any increase. Returns the
+// number of regressions.
+int compareBaselines(const BenchBaseline& baseline, const BenchBaseline& current,
+                     double thresholdPercent, std::ostream& out);
+
+#endif // BENCH_BASELINE_H
@@ -0,0 +1,125 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+class BufferPool;
+
+// Large image buffer borrowed from a BufferPool.
+// Move-only; the memory goes back to the calling thread's pool on destruction.
+class PooledBuffer {
+public:
+    PooledBuffer() = default;
+    ~PooledBuffer();
+
+    PooledBuffer(PooledBuffer&& other) noexcept;
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    uint8_t& operator[](size_t i) { return data_[i]; }
+    const uint8_t& operator[](size_t i) const { return data_[i]; }
+    explicit operator bool() const { return data_ != nullptr; }
+
+    // Return the memory to the pool now
+    void reset();
+
+private:
+    friend class BufferPool;
+    PooledBuffer(uint8_t* data, size_t size, size_t capacity)
+        : data_(data), size_(size), capacity_(capacity) {}
+
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+};
+
+// Thread-local cache of large, page-aligned buffers.
+//
+// Requests are rounded up to a size class (four classes per power of two,
+// so at most 25% slack) and served from a per-class free list. Buffers come
+// straight from the OS and are never unmapped while cached, so a batch that
+// converts many similar images stops paying for mmap/munmap and first-touch
+// page faults after the first image. Optionally the buffers are advised as
+// transparent huge pages.
+class BufferPool {
+public:
+    // Smallest buffer worth pooling; smaller requests still get this size
+    static constexpr size_t kMinBuffer = size_t(64) << 10;
+
+    BufferPool();
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Pool of the calling thread
+    static BufferPool& local();
+
+    // Borrow a buffer of at least `bytes` bytes (contents are unspecified)
+    PooledBuffer acquire(size_t bytes);
+
+    // Raw interface for allocators layered on top of the pool.
+    // `bytes` passed to release must equal the value given to allocate.
+    void* allocate(size_t bytes);
+    void release(void* p, size_t bytes);
+
+    // Capacity actually reserved for a request of `bytes`
+    static size_t roundUp(size_t bytes);
+
+    // Memory resource drawing from this pool (for arena upstreams)
+    std::pmr::memory_resource* resource() { return &resource_; }
+
+    // Free all cached buffers
+    void trim();
+
+    // Bytes currently cached in free lists
+    size_t cachedBytes() const { return cachedBytes_; }
+
+    // Bytes currently handed out, and the most handed out at once since the
+    // last resetPeak(); used to report the working set of one conversion
+    size_t lentBytes() const { return lentBytes_; }
+    size_t peakLentBytes() const { return peakLentBytes_; }
+    void resetPeak();
+
+    // Requests served from a free list and from the OS, across all threads
+    static uint64_t cacheHits();
+    static uint64_t cacheMisses();
+
+    // Process-wide settings, read when buffers are created or released
+    static void setHugePages(bool enabled);
+    static void setCacheLimit(size_t bytes);
+
+private:
+    // Classes cover up to 64 GiB; larger requests are not cached
+    static constexpr int kClassCount = 1 + 20 * 4;
+
+    class PoolResource : public std::pmr::memory_resource {
+    public:
+        explicit PoolResource(BufferPool& pool) : pool_(pool) {}
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+        BufferPool& pool_;
+    };
+
+    static int classIndex(size_t bytes);
+    static size_t classSize(int index);
+
+    std::array<std::vector<void*>, kClassCount> freeLists_;
+    size_t cachedBytes_ = 0;
+    size_t lentBytes_ = 0;
+    size_t peakLentBytes_ = 0;
+    PoolResource resource_{*this};
+};
+
+#endif // BUFFER_POOL_H
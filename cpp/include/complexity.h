@@ -0,0 +1,87 @@
+#ifndef COMPLEXITY_H
+#define COMPLEXITY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// What to do with an image whose bitmap is too complex to trace in bounded
+// time (noise, dithering, fine halftones)
+enum class ComplexityFallback {
+    Preview,   // trace a box-filtered bitmap reduced until it fits the caps
+    Raster     // embed the original PNG in the SVG as an <image>
+};
+
+// Work caps on the 1-bit bitmap handed to potrace; 0 disables a cap
+struct ComplexityLimits {
+    size_t maxEdges = 10000000;      // black/white pixel boundaries
+    size_t maxComponents = 100000;   // 4-connected black regions
+    ComplexityFallback fallback = ComplexityFallback::Preview;
+};
+
+// Process-wide caps, configured once at startup like ScratchSpace
+class ComplexityGuard {
+public:
+    static void configure(const ComplexityLimits& limits);
+    static const ComplexityLimits& limits();
+
+    // Parse "preview" / "raster"; false if unknown
+    static bool parseFallback(const char* text, ComplexityFallback& fallback);
+};
+
+// Thrown by a bitmap stage as soon as the counts projected from the rows seen
+// so far exceed a cap; carries those projected counts
+struct ComplexityExceeded : std::runtime_error {
+    ComplexityExceeded(size_t edges, size_t components)
+        : std::runtime_error("bitmap too complex to trace"), edges(edges), components(components) {}
+
+    size_t edges;
+    size_t components;
+};
+
+// Streaming estimate of how much work potrace and the SVG passes will do,
+// taken from the packed rows as they go by. Potrace emits one path per
+// black region and hole, and its output grows with the boundary length,
+// so it counts boundary edges (horizontal from the runs in a row, vertical
+// from the XOR with the row above) and 4-connected black components (runs
+// overlapping runs of the row above are merged with a union-find over the
+// previous row's components only, so memory stays proportional to a row).
+class ComplexityMeter {
+public:
+    void begin(int width, int height);
+
+    // One PBM row, MSB first, 1 = black, padding bits clear
+    void addRow(const uint8_t* packed);
+
+    size_t edges() const { return edges_; }
+    size_t components() const { return components_; }
+    int rows() const { return rows_; }
+
+    // Throw ComplexityExceeded if the counts so far, projected to the full
+    // height once enough rows are in, break `limits`
+    void check(const ComplexityLimits& limits) const;
+
+private:
+    struct Run {
+        int start;
+        int end;     // exclusive
+        int label;   // component, indexes parent_ while the row is current
+    };
+
+    int find(int label);
+
+    int width_ = 0;
+    int height_ = 0;
+    int rows_ = 0;
+    size_t packedBytes_ = 0;
+    size_t edges_ = 0;
+    size_t components_ = 0;
+    std::vector<uint8_t> previous_;
+    std::vector<Run> previousRuns_;
+    std::vector<Run> runs_;
+    std::vector<int> parent_;
+    std::vector<int> remap_;
+};
+
+#endif // COMPLEXITY_H
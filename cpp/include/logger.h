@@ -0,0 +1,105 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum class LogLevel { Debug, Info, Warn, Error };
+
+enum class LogFormat {
+    Text,   // the message alone, as the CLI has always printed it
+    Json    // one object per line: time, level, thread, event, message, fields
+};
+
+// Asynchronous, leveled, structured log.
+//
+// Producers format a record and push it into a bounded lock-free ring
+// (Vyukov MPMC queue, used with a single consumer); a background thread
+// writes the records out and flushes only when the ring runs dry, so a
+// worker never waits on a stream lock or a per-line flush. A full ring
+// makes producers yield until there is room; nothing is dropped. Debug
+// and info records go to stdout and the rest to stderr, unless stdout
+// carries data (an archive written to `-`), in which case all go to stderr.
+//
+// Library code logs through this instead of writing to stdout.
+class Logger {
+public:
+    static void setLevel(LogLevel level);
+    static void setFormat(LogFormat format);
+    static void setStdoutReserved(bool reserved);
+
+    static bool enabled(LogLevel level);
+
+    // Parse "debug", "info", "warn", "error" / "text", "json"; false if unknown
+    static bool parseLevel(const std::string& text, LogLevel& level);
+    static bool parseFormat(const std::string& text, LogFormat& format);
+
+    // Queue one record; `event` names it for machine consumers and must
+    // outlive the logger (a string literal). Records with an empty event
+    // are terminal decoration and are left out of JSON output.
+    static void submit(LogLevel level, const char* event, std::string message,
+                       std::vector<std::pair<std::string, std::string>> fields);
+
+    // Block until everything logged so far has been written, e.g. before
+    // prompting on the terminal
+    static void flush();
+};
+
+// One record under construction: stream the message in, attach fields,
+// and it is queued when the statement ends.
+//
+//   logInfo("file_done").field("output", path) << "  ✓ 已保存到: " << name;
+class LogLine {
+public:
+    LogLine(LogLevel level, const char* event)
+        : level_(level), event_(event), enabled_(Logger::enabled(level)) {}
+
+    ~LogLine() {
+        if (enabled_) {
+            Logger::submit(level_, event_, text_.str(), std::move(fields_));
+        }
+    }
+
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    template <typename T>
+    LogLine& operator<<(const T& value) {
+        if (enabled_) text_ << value;
+        return *this;
+    }
+
+    template <typename T>
+    LogLine& field(const char* key, const T& value) {
+        if (enabled_) {
+            std::ostringstream text;
+            text << value;
+            fields_.emplace_back(key, text.str());
+        }
+        return *this;
+    }
+
+    LogLine& field(const char* key, const std::string& value) {
+        if (enabled_) fields_.emplace_back(key, value);
+        return *this;
+    }
+
+private:
+    LogLevel level_;
+    const char* event_;
+    bool enabled_;
+    std::ostringstream text_;
+    std::vector<std::pair<std::string, std::string>> fields_;
+};
+
+inline LogLine logDebug(const char* event) { return LogLine(LogLevel::Debug, event); }
+inline LogLine logInfo(const char* event) { return LogLine(LogLevel::Info, event); }
+inline LogLine logWarn(const char* event) { return LogLine(LogLevel::Warn, event); }
+inline LogLine logError(const char* event) { return LogLine(LogLevel::Error, event); }
+
+// Horizontal rule between the header, progress and summary of a batch
+inline void logSeparator() { logInfo("") << std::string(50, '-'); }
+
+#endif // LOGGER_H
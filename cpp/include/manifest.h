@@ -0,0 +1,37 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include "vectorizer.h"
+#include <fstream>
+#include <string>
+
+// Outcome of one input, as recorded in the manifest
+struct ManifestEntry {
+    std::string input;
+    std::string output;           // empty when the conversion failed
+    size_t inputBytes = 0;
+    int optionIndex = -1;         // -1 when no option was chosen
+    VectorizationOption option{};
+    ConversionStats stats;
+    double wallMs = 0;
+    std::string error;
+    std::string duplicateOf;      // input whose result was reused, if any
+};
+
+// Results manifest in JSON lines: one object per input, in processing
+// order, with the chosen option, image facts, output size and the timing
+// and memory figures from ConversionStats. Each line is flushed as it is
+// written, so a running batch can be followed with `tail -f`.
+class ManifestWriter {
+public:
+    // Throws std::runtime_error if the file cannot be created
+    explicit ManifestWriter(const std::string& path);
+
+    void write(const ManifestEntry& entry);
+
+private:
+    std::ofstream out_;
+    std::string path_;
+};
+
+#endif // MANIFEST_H
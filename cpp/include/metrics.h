@@ -0,0 +1,122 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Monotonic count; updates are relaxed atomic adds
+class Counter {
+public:
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// Value that goes up and down
+class Gauge {
+public:
+    void set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+    void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+// Distribution over fixed, ascending upper bounds. observe() is lock-free:
+// one relaxed add on the bucket and a CAS loop on the sum.
+class Histogram {
+public:
+    explicit Histogram(std::vector<double> bounds);
+
+    void observe(double value);
+
+    const std::vector<double>& bounds() const { return bounds_; }
+
+    // Per-bucket counts (not cumulative); the last bucket is +Inf
+    std::vector<uint64_t> counts() const;
+    double sum() const { return sum_.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<double> bounds_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+    std::atomic<double> sum_{0};
+};
+
+// Named metrics rendered in the Prometheus text exposition format.
+//
+// Registration takes a lock and returns a reference that stays valid for
+// the life of the registry; updating a registered metric never locks.
+// Series of one family must be registered together, with the same help
+// text, and are told apart by their label string (`stage="potrace"`).
+class MetricsRegistry {
+public:
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    Histogram& histogram(const std::string& name, const std::string& help,
+                         const std::vector<double>& bounds, const std::string& labels = "");
+
+    // Series whose value is sampled when rendering (memory use, pool stats)
+    void sampled(const std::string& name, const std::string& help, const std::string& type,
+                 std::function<double()> sample, const std::string& labels = "");
+
+    std::string render() const;
+
+private:
+    struct Series {
+        std::string name;
+        std::string help;
+        std::string type;
+        std::string labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        std::function<double()> sample;
+    };
+
+    Series& add(const std::string& name, const std::string& help, const std::string& type,
+                const std::string& labels);
+
+    mutable std::mutex mutex_;
+    std::deque<Series> series_;
+};
+
+// The converter's own metrics: files and bytes converted, per-file and
+// per-stage latency, queue depth, buffer pool hit rate, memory use and
+// failures. Everything is a no-op until enable().
+class Metrics {
+public:
+    // Register the metrics; call before starting worker threads
+    static void enable();
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    static MetricsRegistry& registry();
+
+    // Time spent in one pipeline stage
+    static void observeStage(const char* stage, double ms);
+
+    // One input finished
+    static void fileDone(bool ok, size_t inputBytes, size_t outputBytes, double ms);
+
+    // Inputs waiting for a converter
+    static void setQueueDepth(int64_t depth);
+
+    // Write the registry to `path` every `intervalMs` from a background
+    // thread, replacing the file atomically, until stopExporter() writes it
+    // one last time. Throws std::runtime_error if the first write fails.
+    static void startExporter(const std::string& path, int intervalMs = 1000);
+    static void stopExporter();
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,127 @@
+#ifndef PIXEL_PIPELINE_H
+#define PIXEL_PIPELINE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// Per-pixel stages specialized at compile time for each channel layout.
+//
+// Images are dispatched once on their channel count (dispatchLayout); inside
+// a stage the layout is a template parameter, so the per-pixel loops carry
+// no branches on `channels` and the compiler can unroll and vectorize each
+// variant separately.
+
+// Channel layout as decoded by stb_image
+template <int Channels>
+struct PixelLayout {
+    static constexpr int channels = Channels;
+    static constexpr bool hasColor = Channels >= 3;
+    static constexpr bool hasAlpha = Channels == 2 || Channels == 4;
+    static constexpr int alphaIndex = Channels - 1;
+
+    // Luminance of one pixel; alpha does not contribute
+    static uint8_t gray(const uint8_t* p) {
+        if constexpr (hasColor) {
+            return static_cast<uint8_t>(0.299 * p[0] + 0.587 * p[1] + 0.114 * p[2]);
+        } else {
+            return p[0];
+        }
+    }
+};
+
+using LayoutL = PixelLayout<1>;
+using LayoutLA = PixelLayout<2>;
+using LayoutRGB = PixelLayout<3>;
+using LayoutRGBA = PixelLayout<4>;
+
+// Invoke fn with the PixelLayout matching `channels`
+template <typename Fn>
+decltype(auto) dispatchLayout(int channels, Fn&& fn) {
+    switch (channels) {
+        case 1: return fn(LayoutL{});
+        case 2: return fn(LayoutLA{});
+        case 3: return fn(LayoutRGB{});
+        case 4: return fn(LayoutRGBA{});
+        default:
+            throw std::runtime_error("Unsupported channel count: " + std::to_string(channels));
+    }
+}
+
+// Lookup table mapping a gray value to its posterization level
+using PosterizeTable = std::array<uint8_t, 256>;
+
+inline PosterizeTable makePosterizeTable(int levels) {
+    PosterizeTable table;
+    int step = levels > 1 ? 256 / levels : 1;
+    for (int v = 0; v < 256; ++v) {
+        table[v] = static_cast<uint8_t>((v / step) * step);
+    }
+    return table;
+}
+
+// Convert `count` pixels to 8-bit gray
+template <typename Layout>
+void convertToGray(const uint8_t* src, uint8_t* dst, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = Layout::gray(src + i * Layout::channels);
+    }
+}
+
+// Convert `count` pixels to gray and posterize them in the same pass
+template <typename Layout>
+void convertToPosterizedGray(const uint8_t* src, uint8_t* dst, size_t count,
+                             const PosterizeTable& table) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = table[Layout::gray(src + i * Layout::channels)];
+    }
+}
+
+// Pack `count` gray pixels into one PBM row (MSB first, 1 = black), using
+// potrace's own cutoff for gray input: black below half intensity
+inline void packBitmapRow(const uint8_t* gray, uint8_t* dst, size_t count) {
+    size_t x = 0;
+    for (; x + 8 <= count; x += 8) {
+        uint8_t bits = 0;
+        for (int b = 0; b < 8; ++b) {
+            bits = static_cast<uint8_t>((bits << 1) | (gray[x + b] < 128));
+        }
+        *dst++ = bits;
+    }
+    if (x < count) {
+        uint8_t bits = 0;
+        for (int b = 0; b < 8; ++b) {
+            bits = static_cast<uint8_t>((bits << 1) | (x + b < count && gray[x + b] < 128));
+        }
+        *dst = bits;
+    }
+}
+
+// Visit every `sampleStep`-th pixel of every `sampleStep`-th row that has
+// color and is not mostly transparent, passing its color quantized to 32
+// levels per channel as packed 0xRRGGBB. Gray layouts have no colors to visit.
+template <typename Layout, typename Fn>
+void forEachSampledColor(const uint8_t* pixels, int width, int height, int sampleStep, Fn&& fn) {
+    if constexpr (Layout::hasColor) {
+        for (int y = 0; y < height; y += sampleStep) {
+            const uint8_t* row = pixels + static_cast<size_t>(y) * width * Layout::channels;
+            for (int x = 0; x < width; x += sampleStep) {
+                const uint8_t* px = row + static_cast<size_t>(x) * Layout::channels;
+                if constexpr (Layout::hasAlpha) {
+                    // Skip transparent pixels
+                    if (px[Layout::alphaIndex] < 128) {
+                        continue;
+                    }
+                }
+                uint32_t r = (px[0] / 32) * 32;
+                uint32_t g = (px[1] / 32) * 32;
+                uint32_t b = (px[2] / 32) * 32;
+                fn((r << 16) | (g << 8) | b);
+            }
+        }
+    }
+}
+
+#endif // PIXEL_PIPELINE_H
@@ -0,0 +1,46 @@
+#ifndef PNG_STREAM_H
+#define PNG_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Receives decoded scanlines, top to bottom, in chunks of consecutive rows.
+// Pixels use the same 8-bit channel layout stbi_load(..., 0) would return.
+class RowSink {
+public:
+    virtual ~RowSink() = default;
+
+    // Called once with the image geometry before any rows arrive
+    virtual void begin(int width, int height, int channels) = 0;
+
+    // `count` rows starting at row `y`; row i is at data + i * stride.
+    // The memory is only valid for the duration of the call.
+    virtual void rows(int y, int count, const uint8_t* data, size_t stride) = 0;
+
+    // Called after the last row
+    virtual void end() {}
+};
+
+// Incremental PNG decoder.
+//
+// IDAT data is inflated through a 32 KiB window and unfiltered one scanline
+// at a time; finished rows are handed to the sink in chunks while decoding
+// continues, so neither the compressed stream nor the full image is ever
+// held in memory and downstream stages work on rows that are still in cache.
+//
+// Interlaced images and Apple CgBI files are not handled; decode() returns
+// false for them (and for non-PNG input) before the sink sees anything, so
+// the caller can fall back to stb_image. Corrupt data throws.
+class PngStreamDecoder {
+public:
+    explicit PngStreamDecoder(int chunkRows = 32);
+
+    bool decode(const std::string& path, RowSink& sink);
+    bool decode(const uint8_t* data, size_t size, RowSink& sink);
+
+private:
+    int chunkRows_;
+};
+
+#endif // PNG_STREAM_H
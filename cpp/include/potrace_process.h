@@ -0,0 +1,54 @@
+#ifndef POTRACE_PROCESS_H
+#define POTRACE_PROCESS_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+
+// One run of the external potrace tracer.
+//
+// potrace is spawned directly (posix_spawn, no shell) as
+// `potrace - -s -o - --opttolerance 0.5`: the bitmap is streamed into its
+// stdin while it is being decoded, and the SVG is read back from its stdout,
+// so nothing touches the file system and concurrent runs cannot collide.
+// Both pipes are serviced with poll() so neither side can stall the other.
+class PotraceProcess {
+public:
+    // True if a potrace executable is on PATH; the search runs once per process
+    static bool available();
+
+    // Start potrace; throws if it cannot be spawned
+    PotraceProcess();
+
+    // Kills and reaps potrace if finish() was not reached
+    ~PotraceProcess();
+
+    PotraceProcess(const PotraceProcess&) = delete;
+    PotraceProcess& operator=(const PotraceProcess&) = delete;
+
+    // Feed bitmap bytes (a PBM/PGM stream) to potrace
+    void write(const void* data, size_t size);
+
+    // Close potrace's input and return its SVG output, allocated from the
+    // current job arena; throws if potrace fails
+    std::pmr::string finish();
+
+    // CPU time potrace used, known once finish() has returned
+    double cpuMs() const { return cpuMs_; }
+
+private:
+    std::pmr::string output_;
+    double cpuMs_ = 0;
+#ifdef _WIN32
+    std::string input_;
+#else
+    void readAvailable();
+
+    int pid_ = -1;
+    int stdin_ = -1;
+    int stdout_ = -1;
+    bool broken_ = false;
+#endif
+};
+
+#endif // POTRACE_PROCESS_H
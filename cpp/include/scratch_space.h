@@ -0,0 +1,56 @@
+#ifndef SCRATCH_SPACE_H
+#define SCRATCH_SPACE_H
+
+#include <cstddef>
+#include <string>
+
+// Out-of-core support for images that do not fit in memory.
+//
+// When a resident limit is configured, a job whose decoded image would
+// exceed it runs "out of core": its large buffers are memory-mapped from
+// unlinked scratch files instead of anonymous memory, the per-pixel stages
+// walk them in horizontal strips sized to the limit, and each strip is
+// dropped from the resident set once processed. Pages are file-backed, so
+// under pressure the kernel writes them to the scratch file instead of swap.
+class ScratchSpace {
+public:
+    // Enable out-of-core processing for jobs whose decoded image exceeds
+    // `residentLimit` bytes (0 disables). Scratch files are created in
+    // `directory`, or the system temp directory when empty.
+    static void configure(size_t residentLimit, const std::string& directory = "");
+
+    // Configured limit in bytes, 0 when disabled
+    static size_t residentLimit();
+
+    // True if a job needing `bytes` of decoded pixels must run out of core
+    static bool exceedsLimit(size_t bytes);
+
+    // Rows per strip so that `rowBytes` per row stays under the limit
+    static int stripRows(size_t rowBytes);
+
+    // True while the job on this thread runs out of core
+    static bool active();
+
+    // Map `bytes` of zeroed memory backed by a fresh scratch file
+    static void* map(size_t bytes);
+    static void unmap(void* p, size_t bytes);
+
+    // Access hints for ranges inside a map() block; no-ops on other memory
+    static void adviseSequential(const void* p, size_t bytes);
+    static void dropResident(const void* p, size_t bytes);
+};
+
+// Marks the job on the calling thread as out-of-core while alive
+class ScratchScope {
+public:
+    explicit ScratchScope(bool enable);
+    ~ScratchScope();
+
+    ScratchScope(const ScratchScope&) = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+
+private:
+    bool previous_;
+};
+
+#endif // SCRATCH_SPACE_H
@@ -0,0 +1,66 @@
+#ifndef SOAK_H
+#define SOAK_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Settings of `png2svg soak`
+struct SoakOptions {
+    std::string corpus;              // directory of PNG files
+    double durationSeconds = 3600;
+    double intervalSeconds = 10;     // between samples
+    double warmupFraction = 0.1;     // leading share of samples the verdict ignores
+    int threads = 1;
+    int optionIndex = 0;             // vectorization option, as with --option
+    std::string samplesPath;         // CSV of every sample, empty for none
+
+    // Drift limits, last quarter of the samples after warm-up against the
+    // first quarter
+    double maxRssGrowthPercent = 10;
+    double maxLatencyGrowthPercent = 25;
+    int maxFdGrowth = 4;
+    int maxThreadGrowth = 0;
+};
+
+// Process and throughput state over one sampling interval
+struct SoakSample {
+    double elapsedSeconds = 0;
+    size_t conversions = 0;          // finished in this interval
+    size_t failures = 0;
+    double imagesPerSecond = 0;
+    double latencyP50Ms = 0;
+    double latencyP99Ms = 0;
+    double residentBytes = 0;        // current RSS, 0 if unknown
+    int openFds = -1;                // -1 if unknown
+    int threads = -1;                // -1 if unknown
+    std::vector<uint64_t> latencyCounts;  // conversions of the interval per latency bucket
+};
+
+// One drift check of the final verdict
+struct SoakCheck {
+    std::string name;                // "rss", "latency p50", "open fds", "threads"
+    double first = 0;                // first quarter after warm-up
+    double last = 0;                 // last quarter
+    double change = 0;               // percent, or absolute for counts
+    double limit = 0;
+    bool percent = true;
+    bool failed = false;
+};
+
+// Convert the corpus round and round on `threads` threads for the whole
+// duration, starting each cycle one image further along so neighbours
+// vary, and sample every interval. Samples are printed as they are taken.
+// Throws std::runtime_error if the corpus cannot be loaded.
+std::vector<SoakSample> runSoak(const SoakOptions& options, std::ostream& out);
+
+// Compare the first and last quarter of the samples after warm-up; empty
+// if there are too few samples to judge
+std::vector<SoakCheck> evaluateSoak(const SoakOptions& options, const std::vector<SoakSample>& samples);
+
+// `png2svg soak ...`; argv[0] is "soak". Returns the exit code: 1 if any
+// check failed.
+int soakCommand(int argc, char* argv[]);
+
+#endif // SOAK_H
@@ -0,0 +1,57 @@
+#ifndef TAR_STREAM_H
+#define TAR_STREAM_H
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// One regular file inside a tar archive
+struct TarMember {
+    std::string name;
+    std::vector<uint8_t> data;
+    int64_t mtime = 0;
+};
+
+// Sequential reader for ustar/GNU/pax archives, as written by GNU tar,
+// bsdtar and Python's tarfile. Only regular files are returned; directories,
+// links and other entries are skipped. Long names from GNU 'L' records and
+// pax 'path' records are honored. Works on non-seekable streams (pipes).
+class TarReader {
+public:
+    explicit TarReader(std::istream& in) : in_(in) {}
+
+    // Read the next regular file; false at the end of the archive.
+    // Throws std::runtime_error on a truncated or corrupt archive.
+    bool next(TarMember& member);
+
+private:
+    bool readBlock(char* block);
+    void readData(uint64_t size, std::vector<uint8_t>& data);
+    void skipData(uint64_t size);
+
+    std::istream& in_;
+    bool ended_ = false;
+};
+
+// Sequential writer producing ustar archives; names that do not fit the
+// ustar fields get a pax 'path' record.
+class TarWriter {
+public:
+    explicit TarWriter(std::ostream& out) : out_(out) {}
+
+    // Append a regular file
+    void add(const std::string& name, const std::string& data, int64_t mtime = 0);
+
+    // Write the end-of-archive marker and flush; throws if the stream failed
+    void finish();
+
+private:
+    void writeHeader(const std::string& name, uint64_t size, int64_t mtime, char type);
+    void writePadded(const char* data, size_t size);
+
+    std::ostream& out_;
+};
+
+#endif // TAR_STREAM_H
@@ -0,0 +1,70 @@
+#ifndef TRACE_LOG_H
+#define TRACE_LOG_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Timeline of what every thread was doing, for finding idle time in the
+// parallel pipelines.
+//
+// Each thread records its spans into its own fixed-size ring buffer, so
+// recording takes no locks and never allocates after a thread's first span;
+// when a ring fills up the oldest spans are overwritten. A thread that
+// exits hands its ring, spans included, to the next new thread, so the
+// number of rings follows the most threads alive at once rather than the
+// number ever started; the exported timeline shows both on one row. Disabled (the
+// default), a span costs one relaxed atomic load. The rings are exported in
+// Chrome trace-event format, viewable in Perfetto or chrome://tracing.
+class TraceLog {
+public:
+    // Start recording; each thread keeps its last `spansPerThread` spans
+    static void enable(size_t spansPerThread = 1 << 16);
+
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // Monotonic timestamp in nanoseconds, same clock as std::chrono::steady_clock
+    static uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Record a span of the calling thread. `name` must outlive the log
+    // (a string literal); no-op unless enabled.
+    static void record(const char* name, uint64_t startNs, uint64_t endNs);
+
+    // Label the calling thread in the exported trace
+    static void setThreadName(const std::string& name);
+
+    // Write all recorded spans as Chrome trace-event JSON; throws
+    // std::runtime_error if the file cannot be written. Threads still
+    // recording while this runs may have their newest spans left out.
+    static void write(const std::string& path);
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+// Records the enclosing scope as one span
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name)
+        : name_(name), active_(TraceLog::enabled()), start_(active_ ? TraceLog::now() : 0) {}
+
+    ~TraceSpan() {
+        if (active_) {
+            TraceLog::record(name_, start_, TraceLog::now());
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name_;
+    bool active_;
+    uint64_t start_;
+};
+
+#endif // TRACE_LOG_H
@@ -1,7 +1,11 @@
 #ifndef VECTORIZER_H
 #define VECTORIZER_H
 
+#include "alloc_profile.h"
+#include <cstdint>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <tuple>
 #include <unordered_map>
@@ -14,11 +18,74 @@ struct VectorizationOption {
 
 // Structure to represent pixel data
 struct PixelData {
-    std::vector<std::vector<std::vector<uint8_t>>> pixels;  // height x width x channels
+    std::pmr::vector<uint8_t> pixels;  // row-major, height x width x channels
     int width;
     int height;
     int channels;
     std::string mode;
+
+    // Channels of the pixel at (x, y)
+    const uint8_t* pixel(int x, int y) const {
+        return pixels.data() + (static_cast<size_t>(y) * width + x) * channels;
+    }
+};
+
+// Measurements of the conversions done by one Vectorizer, for manifests.
+// Use one Vectorizer per image; every inspect/convert call adds to these.
+struct ConversionStats {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::vector<std::string> palette;  // dominant colors found by inspection
+    size_t pathCount = 0;
+    size_t nodeCount = 0;              // path segments, one per drawn curve or line
+    size_t outputBytes = 0;
+    std::vector<std::pair<std::string, double>> stageMs;  // in pipeline order
+    std::vector<std::pair<std::string, AllocCounters>> stageAllocs;  // profiling builds only
+    double cpuMs = 0;                  // this thread, all stages
+    double potraceCpuMs = 0;           // the potrace child process
+    size_t peakBytes = 0;              // largest working set of one call
+    size_t edges = 0;                  // bitmap boundary edges, estimated while decoding
+    size_t components = 0;             // black regions of the bitmap
+    std::string downgrade;             // "preview" or "raster" when a complexity cap was hit
+    int previewScale = 1;              // bitmap reduction of a preview trace
+};
+
+// PNG input: a file on disk, an encoded image already in memory, or
+// pixels already decoded (animation frames)
+struct ImageSource {
+    std::string path;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    const uint8_t* pixels = nullptr;   // row-major, width x channels bytes per row
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+
+    bool inMemory() const { return data != nullptr; }
+    bool decoded() const { return pixels != nullptr; }
+};
+
+// State kept between conversions of an image that is edited in place
+// (watch mode): the bitmap potrace saw last time and the paths traced for
+// each tile of it. A conversion through the cache decodes the whole image
+// but traces again only the tiles whose bitmap changed, and splices their
+// paths between the kept ones.
+//
+// With `wholeFirst`, a conversion that would retrace every tile (the first
+// one, a new size or option, an edit touching all tiles) traces the bitmap
+// whole instead, so it matches a one-shot conversion; the tiles are then
+// traced on the next edit.
+struct TileCache {
+    int tileSize = 256;               // pixels per side, rounded up to a multiple of 8
+    bool wholeFirst = false;          // trace whole when nothing can be reused
+    int width = 0;
+    int height = 0;
+    int step = 0;                     // posterization the bitmap was made with
+    std::vector<uint8_t> bitmap;      // packed PBM rows
+    std::vector<std::string> tiles;   // spliceable paths per tile, row-major
+    bool tilesCurrent = false;        // tiles are traced from bitmap, not left over from a whole trace
+    size_t tilesTraced = 0;           // by the last conversion
 };
 
 class Vectorizer {
@@ -63,16 +130,61 @@ public:
     
     // Inspect an image and return possible vectorization options
     std::vector<VectorizationOption> inspectImage(const std::string& imageName);
+    
+    // In-memory variants for batch conversion: the PNG is read from a buffer
+    // and the SVG is returned instead of being written to disk.
+    std::vector<VectorizationOption> inspectImage(const uint8_t* data, size_t size);
+    std::string convertImage(const uint8_t* data, size_t size, int step,
+                             const std::vector<std::string>& colors);
+    
+    // convertImage retracing only what changed since the previous
+    // conversion through `cache`. Tiles are traced separately, so shapes
+    // crossing a tile edge become one path per tile.
+    std::string convertImage(const uint8_t* data, size_t size, int step,
+                             const std::vector<std::string>& colors, TileCache& cache);
+    
+    // Animation frames, already decoded to RGBA: inspect all `frames`
+    // stacked frames as one image, or convert one frame through `cache`
+    std::vector<VectorizationOption> inspectFrames(const uint8_t* rgba, int width, int height, int frames);
+    std::string convertFrame(const uint8_t* rgba, int width, int height, int step,
+                             const std::vector<std::string>& colors, TileCache& cache);
+    
+    // Recolor with these dominant colors, most frequent first, instead of
+    // the image's own, so every frame of an animation gets the same colors
+    void sharePalette(std::vector<std::string> palette) { sharedPalette_ = std::move(palette); }
+    
+    // Measurements of the calls made so far
+    const ConversionStats& stats() const { return stats_; }
 
 private:
+    // Arena-backed SVG passes used by parseImage; the public methods above
+    // wrap these and copy the result out of the job arena
+    std::pmr::string solidPass(std::string_view svgContent, bool stroke);
+    std::pmr::string recolorPass(std::string_view svgContent, const ImageSource& original);
+    std::pmr::string optimizePass(std::string_view svgContent);
+    std::pmr::string viewboxPass(std::string_view svgContent);
+
     // Helper function to extract dominant colors using K-means clustering
     std::vector<std::string> extractDominantColors(const PixelData& data, int numColors);
+    std::vector<std::string> extractDominantColors(const uint8_t* pixels, int width, int height,
+                                                   int channels, int numColors);
+    
+    // Shared bodies of the file and in-memory entry points
+    std::pmr::string traceImage(const ImageSource& image, int step,
+                                const std::vector<std::string>& colors);
+    std::pmr::string traceTiles(const ImageSource& image, int step,
+                                const std::vector<std::string>& colors, TileCache& cache);
+    // Tile pass of traceTiles; throws ComplexityExceeded for bitmaps over the caps
+    std::pmr::string traceTileGrid(const ImageSource& image, int step,
+                                   const std::vector<std::string>& colors, TileCache& cache);
     
-    // Helper function to run potrace command
-    bool runPotrace(const std::string& inputPath, const std::string& outputPath);
+    // SVG passes after potrace, shared by whole-image and tiled traces
+    std::pmr::string finishTrace(std::pmr::string svgContent, const ImageSource& image, int step,
+                                 const std::vector<std::string>& colors);
+    std::vector<VectorizationOption> inspectSource(const ImageSource& image);
     
-    // Helper function to posterize an image
-    void posterizeImage(const std::string& inputPath, const std::string& outputPath, int levels);
+    ConversionStats stats_;
+    std::vector<std::string> sharedPalette_;
 };
 
 // Standalone functions for compatibility
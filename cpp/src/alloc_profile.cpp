@@ -0,0 +1,187 @@
+#include "alloc_profile.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+
+// Plain data so that thread_local needs no constructor call inside operator new
+thread_local AllocCounters gThreadCounters;
+
+struct StageTotals {
+    std::string stage;
+    uint64_t runs = 0;
+    double ms = 0;
+    AllocCounters counters;
+};
+
+std::atomic<bool> gEnabled{false};
+std::mutex gMutex;
+std::vector<StageTotals> gStages;   // in first-seen order
+
+} // namespace
+
+AllocCounters AllocProfile::current() {
+    return gThreadCounters;
+}
+
+void AllocProfile::addCopy(size_t bytes) {
+    gThreadCounters.copies++;
+    gThreadCounters.copyBytes += bytes;
+}
+
+void AllocProfile::enable() {
+    gEnabled.store(true, std::memory_order_relaxed);
+}
+
+bool AllocProfile::enabled() {
+    return gEnabled.load(std::memory_order_relaxed);
+}
+
+void AllocProfile::addStage(const char* stage, double ms, const AllocCounters& counters) {
+    if (!enabled()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(gMutex);
+    StageTotals* totals = nullptr;
+    for (auto& s : gStages) {
+        if (s.stage == stage) {
+            totals = &s;
+            break;
+        }
+    }
+    if (!totals) {
+        gStages.emplace_back();
+        totals = &gStages.back();
+        totals->stage = stage;
+    }
+    totals->runs++;
+    totals->ms += ms;
+    totals->counters += counters;
+}
+
+void AllocProfile::report(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(gMutex);
+    char line[160];
+    out << "阶段统计:" << std::endl;
+    std::snprintf(line, sizeof(line), "  %-10s %6s %11s %10s %13s %8s %13s",
+                  "stage", "runs", "ms", "allocs", "alloc bytes", "copies", "copy bytes");
+    out << line << std::endl;
+    StageTotals sum;
+    sum.stage = "total";
+    for (const auto& s : gStages) {
+        std::snprintf(line, sizeof(line), "  %-10s %6llu %11.3f %10llu %13llu %8llu %13llu",
+                      s.stage.c_str(), static_cast<unsigned long long>(s.runs), s.ms,
+                      static_cast<unsigned long long>(s.counters.allocations),
+                      static_cast<unsigned long long>(s.counters.bytes),
+                      static_cast<unsigned long long>(s.counters.copies),
+                      static_cast<unsigned long long>(s.counters.copyBytes));
+        out << line << std::endl;
+        sum.ms += s.ms;
+        sum.counters += s.counters;
+    }
+    std::snprintf(line, sizeof(line), "  %-10s %6s %11.3f %10llu %13llu %8llu %13llu",
+                  sum.stage.c_str(), "", sum.ms,
+                  static_cast<unsigned long long>(sum.counters.allocations),
+                  static_cast<unsigned long long>(sum.counters.bytes),
+                  static_cast<unsigned long long>(sum.counters.copies),
+                  static_cast<unsigned long long>(sum.counters.copyBytes));
+    out << line << std::endl;
+    if (!kCounting) {
+        out << "  （分配与复制计数需要使用 -DPNG2SVG_PROFILE=ON 构建）" << std::endl;
+    }
+}
+
+#ifdef PNG2SVG_PROFILE
+
+// Counting replacements for the global allocation functions. Only
+// allocations are counted; the delete operators just match the allocator.
+namespace {
+
+void* countedAllocate(std::size_t size) {
+    gThreadCounters.allocations++;
+    gThreadCounters.bytes += size;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* countedAllocateAligned(std::size_t size, std::size_t alignment) {
+    gThreadCounters.allocations++;
+    gThreadCounters.bytes += size;
+#ifdef _WIN32
+    return _aligned_malloc(size == 0 ? 1 : size, alignment);
+#else
+    // aligned_alloc wants a multiple of the alignment
+    size_t rounded = (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment;
+    return std::aligned_alloc(alignment, rounded);
+#endif
+}
+
+void freeAligned(void* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    if (void* p = countedAllocate(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    if (void* p = countedAllocate(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    if (void* p = countedAllocateAligned(size, static_cast<size_t>(alignment))) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    if (void* p = countedAllocateAligned(size, static_cast<size_t>(alignment))) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAllocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAllocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(p); }
+
+#endif
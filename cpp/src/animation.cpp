@@ -0,0 +1,241 @@
+#include "animation.h"
+#include "arena.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+namespace {
+
+// Browsers show frames with a delay of 0 or 10 ms for 100 ms; do the same
+constexpr int kMinDelayMs = 20;
+constexpr int kDefaultDelayMs = 100;
+
+// Add the measurements of one thread's frames to the animation's
+void mergeStats(ConversionStats& total, const ConversionStats& part) {
+    total.pathCount += part.pathCount;
+    total.nodeCount += part.nodeCount;
+    total.outputBytes += part.outputBytes;
+    total.cpuMs += part.cpuMs;
+    total.potraceCpuMs += part.potraceCpuMs;
+    total.peakBytes = std::max(total.peakBytes, part.peakBytes);
+    for (const auto& stage : part.stageMs) {
+        auto it = std::find_if(total.stageMs.begin(), total.stageMs.end(),
+                               [&](const auto& s) { return s.first == stage.first; });
+        if (it == total.stageMs.end()) {
+            total.stageMs.push_back(stage);
+        } else {
+            it->second += stage.second;
+        }
+    }
+    for (const auto& stage : part.stageAllocs) {
+        auto it = std::find_if(total.stageAllocs.begin(), total.stageAllocs.end(),
+                               [&](const auto& s) { return s.first == stage.first; });
+        if (it == total.stageAllocs.end()) {
+            total.stageAllocs.push_back(stage);
+        } else {
+            it->second.allocations += stage.second.allocations;
+            it->second.bytes += stage.second.bytes;
+            it->second.copies += stage.second.copies;
+            it->second.copyBytes += stage.second.copyBytes;
+        }
+    }
+}
+
+// The drawing of an SVG document, without its XML prologue and root tag
+std::string_view svgBody(std::string_view svg) {
+    size_t begin = svg.find("<svg");
+    if (begin == std::string_view::npos) return std::string_view();
+    begin = svg.find('>', begin);
+    size_t end = svg.rfind("</svg>");
+    if (begin == std::string_view::npos || end == std::string_view::npos || end <= begin) {
+        return std::string_view();
+    }
+    return svg.substr(begin + 1, end - begin - 1);
+}
+
+// The viewBox of an SVG document's root tag, or an empty view if it has none
+std::string_view svgViewBox(std::string_view svg) {
+    size_t tag = svg.find("<svg");
+    if (tag == std::string_view::npos) return std::string_view();
+    size_t tagEnd = svg.find('>', tag);
+    size_t begin = svg.find(" viewBox=\"", tag);
+    if (tagEnd == std::string_view::npos || begin == std::string_view::npos || begin > tagEnd) {
+        return std::string_view();
+    }
+    begin += 10;
+    size_t end = svg.find('"', begin);
+    if (end == std::string_view::npos || end > tagEnd) return std::string_view();
+    return svg.substr(begin, end - begin);
+}
+
+// True if the view is the canvas itself, so the frame's drawing can be
+// placed in the animation's root without a viewport of its own
+bool isCanvasView(std::string_view viewBox, int width, int height) {
+    double x = 0, y = 0, w = 0, h = 0;
+    std::string text(viewBox);
+    if (std::sscanf(text.c_str(), "%lf %lf %lf %lf", &x, &y, &w, &h) != 4) return false;
+    return x == 0 && y == 0 && w == width && h == height;
+}
+
+// Fraction of the animation's duration, for keyTimes
+std::string keyTime(long ms, long total) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.6g", static_cast<double>(ms) / total);
+    return text;
+}
+
+} // namespace
+
+bool isGif(const uint8_t* data, size_t size) {
+    return size >= 6 && (std::memcmp(data, "GIF87a", 6) == 0 || std::memcmp(data, "GIF89a", 6) == 0);
+}
+
+GifFrames decodeGif(const uint8_t* data, size_t size) {
+    // stb_image allocates from the job arena; the frames are copied out
+    // before the scope drops it
+    ArenaScope scope;
+    GifFrames gif;
+    int* delays = nullptr;
+    int channels = 0;
+    stbi_uc* pixels = stbi_load_gif_from_memory(data, static_cast<int>(size), &delays, &gif.width,
+                                                &gif.height, &gif.count, &channels, 4);
+    if (!pixels) {
+        throw std::runtime_error(std::string("Failed to load GIF: ") + stbi_failure_reason());
+    }
+    gif.pixels.assign(pixels, pixels + static_cast<size_t>(gif.count) * gif.height * gif.width * 4);
+    for (int i = 0; i < gif.count; ++i) {
+        int delay = delays ? delays[i] : 0;
+        gif.delaysMs.push_back(delay < kMinDelayMs ? kDefaultDelayMs : delay);
+    }
+    stbi_image_free(pixels);
+    if (delays) {
+        stbi_image_free(delays);
+    }
+    return gif;
+}
+
+TracedAnimation traceAnimation(const uint8_t* data, size_t size, int optionIndex, int jobs, int tileSize) {
+    GifFrames gif = decodeGif(data, size);
+    TracedAnimation animation;
+    animation.width = gif.width;
+    animation.height = gif.height;
+    animation.delaysMs = gif.delaysMs;
+    animation.frames.resize(gif.count);
+    
+    // One option and one palette for all frames
+    Vectorizer inspector;
+    std::vector<VectorizationOption> options =
+        inspector.inspectFrames(gif.pixels.data(), gif.width, gif.height, gif.count);
+    if (options.empty()) {
+        throw std::runtime_error("无法获取矢量化选项");
+    }
+    animation.optionIndex = std::max(0, std::min(optionIndex, static_cast<int>(options.size()) - 1));
+    animation.option = options[animation.optionIndex];
+    animation.stats = inspector.stats();
+    const std::vector<std::string>& palette = inspector.stats().palette;
+    
+    // Consecutive runs of frames, one per thread
+    size_t frameBytes = static_cast<size_t>(gif.width) * gif.height * 4;
+    int threads = std::max(1, std::min(jobs, gif.count));
+    std::vector<Vectorizer> vectorizers(threads);
+    std::vector<size_t> tiles(threads, 0), tilesTraced(threads, 0);
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            try {
+                Vectorizer& vectorizer = vectorizers[t];
+                vectorizer.sharePalette(palette);
+                TileCache cache;
+                cache.tileSize = tileSize;
+                int first = static_cast<int>(static_cast<long>(gif.count) * t / threads);
+                int last = static_cast<int>(static_cast<long>(gif.count) * (t + 1) / threads);
+                for (int i = first; i < last; ++i) {
+                    animation.frames[i] = vectorizer.convertFrame(gif.pixels.data() + i * frameBytes, gif.width,
+                                                                  gif.height, animation.option.step,
+                                                                  animation.option.colors, cache);
+                    tiles[t] += cache.tiles.size();
+                    tilesTraced[t] += cache.tilesTraced;
+                }
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (const auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+    
+    for (int t = 0; t < threads; ++t) {
+        mergeStats(animation.stats, vectorizers[t].stats());
+        animation.tiles += tiles[t];
+        animation.tilesTraced += tilesTraced[t];
+    }
+    return animation;
+}
+
+std::string animatedSvg(const TracedAnimation& animation) {
+    long total = 0;
+    for (int delay : animation.delaysMs) {
+        total += delay;
+    }
+    std::string w = std::to_string(animation.width);
+    std::string h = std::to_string(animation.height);
+    std::string dur = std::to_string(total) + "ms";
+    
+    // Each frame is hidden except between its start and end time. xlink is
+    // declared for frames embedded as rasters after hitting a complexity cap.
+    std::string svg = "<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\""
+                      " viewBox=\"0 0 " + w + " " + h +
+                      "\" width=\"" + w + "\" height=\"" + h + "\">";
+    long start = 0;
+    for (size_t i = 0; i < animation.frames.size(); ++i) {
+        long end = start + animation.delaysMs[i];
+        std::string values, keyTimes;
+        if (start == 0) {
+            values = "inline";
+            keyTimes = "0";
+        } else {
+            values = "none;inline";
+            keyTimes = "0;" + keyTime(start, total);
+        }
+        if (end < total) {
+            values += ";none";
+            keyTimes += ";" + keyTime(end, total);
+        }
+        svg += "<g display=\"none\"><animate attributeName=\"display\" values=\"" + values +
+               "\" keyTimes=\"" + keyTimes + "\" dur=\"" + dur +
+               "\" calcMode=\"discrete\" repeatCount=\"indefinite\"/>";
+        // A frame traced from a reduced bitmap after a complexity cap draws
+        // in its own coordinates; a nested viewport scales it to the canvas
+        std::string_view viewBox = svgViewBox(animation.frames[i]);
+        if (viewBox.empty() || isCanvasView(viewBox, animation.width, animation.height)) {
+            svg += svgBody(animation.frames[i]);
+        } else {
+            svg += "<svg viewBox=\"";
+            svg += viewBox;
+            svg += "\" width=\"" + w + "\" height=\"" + h + "\">";
+            svg += svgBody(animation.frames[i]);
+            svg += "</svg>";
+        }
+        svg += "</g>";
+        start = end;
+    }
+    svg += "</svg>";
+    return svg;
+}
+
+std::string frameFileName(const std::string& stem, size_t index, size_t count) {
+    int digits = std::max<int>(4, static_cast<int>(std::to_string(count).size()));
+    char number[32];
+    std::snprintf(number, sizeof(number), "%0*zu", digits, index + 1);
+    return stem + "_" + number + ".svg";
+}
@@ -0,0 +1,193 @@
+#include "arena.h"
+#include "buffer_pool.h"
+#include "scratch_space.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+namespace {
+
+// Upper bound on the backing block kept alive between jobs
+constexpr size_t kMaxRetained = size_t(64) << 20;
+
+// stb allocations at least this large (decoded images, zlib output) are
+// served by the buffer pool so they can be recycled across jobs
+constexpr size_t kPooledAllocation = size_t(256) << 10;
+
+enum Origin : size_t { kFromHeap, kFromArena, kFromPool, kFromScratch };
+
+// Nesting depth of ArenaScope on this thread
+thread_local int tScopeDepth = 0;
+
+// Header placed in front of every stb allocation so arenaFree/arenaRealloc
+// know where the block came from
+struct alignas(16) AllocHeader {
+    size_t size;
+    size_t origin;
+};
+
+AllocHeader* headerOf(void* p) {
+    return static_cast<AllocHeader*>(p) - 1;
+}
+
+} // namespace
+
+JobArena::JobArena(size_t initialCapacity)
+    : block_(initialCapacity) {
+    // Make sure the thread's pool outlives its arena: thread-locals are
+    // destroyed in reverse order of construction
+    BufferPool::local();
+    rebuild();
+}
+
+JobArena::~JobArena() {
+    monotonic_.reset();
+}
+
+void JobArena::rebuild() {
+    monotonic_.emplace(block_.data(), block_.size(), &upstream_);
+    upstream_.overflow = 0;
+    used_ = 0;
+}
+
+void* JobArena::allocate(size_t bytes, size_t alignment) {
+    return counting_.allocate(bytes, alignment);
+}
+
+void JobArena::reset() {
+    // Grow the retained block so the next job of this size never leaves it
+    if (upstream_.overflow > 0 && block_.size() < kMaxRetained) {
+        size_t wanted = std::min(kMaxRetained, block_.size() + upstream_.overflow);
+        monotonic_.reset();
+        block_ = std::vector<std::byte>();
+        block_.resize(wanted);
+    }
+    // Re-seating the monotonic resource onto the block is O(1); overflow
+    // chunks (if any) are returned upstream by the old resource's destructor
+    rebuild();
+}
+
+JobArena& JobArena::local() {
+    thread_local JobArena arena;
+    return arena;
+}
+
+std::pmr::memory_resource* JobArena::current() {
+    return tScopeDepth > 0 ? local().resource() : std::pmr::get_default_resource();
+}
+
+bool JobArena::active() {
+    return tScopeDepth > 0;
+}
+
+void* JobArena::OverflowResource::do_allocate(size_t bytes, size_t alignment) {
+    overflow += bytes;
+    if (bytes >= BufferPool::kMinBuffer) {
+        return BufferPool::local().allocate(bytes);
+    }
+    return ::operator new(bytes, std::align_val_t(alignment));
+}
+
+void JobArena::OverflowResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    if (bytes >= BufferPool::kMinBuffer) {
+        BufferPool::local().release(p, bytes);
+        return;
+    }
+    ::operator delete(p, bytes, std::align_val_t(alignment));
+}
+
+bool JobArena::OverflowResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+void* JobArena::CountingResource::do_allocate(size_t bytes, size_t alignment) {
+    arena_.used_ += bytes;
+    return arena_.monotonic_->allocate(bytes, alignment);
+}
+
+void JobArena::CountingResource::do_deallocate(void*, size_t, size_t) {
+    // Monotonic: memory comes back all at once on reset
+}
+
+bool JobArena::CountingResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+ArenaScope::ArenaScope() {
+    ++tScopeDepth;
+}
+
+ArenaScope::~ArenaScope() {
+    if (--tScopeDepth == 0) {
+        JobArena::local().reset();
+    }
+}
+
+void* arenaMalloc(size_t size) {
+    AllocHeader* header;
+    size_t total = sizeof(AllocHeader) + size;
+    try {
+        if (size >= kPooledAllocation && ScratchSpace::active()) {
+            // Out-of-core job: large blocks live in memory-mapped scratch files
+            header = static_cast<AllocHeader*>(ScratchSpace::map(total));
+            header->origin = kFromScratch;
+        } else if (size >= kPooledAllocation) {
+            header = static_cast<AllocHeader*>(BufferPool::local().allocate(total));
+            header->origin = kFromPool;
+        } else if (JobArena::active()) {
+            header = static_cast<AllocHeader*>(JobArena::local().allocate(total, alignof(AllocHeader)));
+            header->origin = kFromArena;
+        } else {
+            header = static_cast<AllocHeader*>(std::malloc(total));
+            if (!header) return nullptr;
+            header->origin = kFromHeap;
+        }
+    } catch (const std::exception&) {
+        // stb reports a null return as "out of memory"
+        return nullptr;
+    }
+    header->size = size;
+    return header + 1;
+}
+
+void* arenaRealloc(void* p, size_t oldSize, size_t newSize) {
+    if (!p) return arenaMalloc(newSize);
+
+    AllocHeader* header = headerOf(p);
+    if (header->origin == kFromHeap && newSize < kPooledAllocation) {
+        header = static_cast<AllocHeader*>(std::realloc(header, sizeof(AllocHeader) + newSize));
+        if (!header) return nullptr;
+        header->size = newSize;
+        return header + 1;
+    }
+
+    // Pool buffers have size-class slack to grow into. header->size stays
+    // the size first requested, which is what picks the class on release;
+    // the bytes in use are the caller's `oldSize`.
+    if (header->origin == kFromPool &&
+        sizeof(AllocHeader) + newSize <= BufferPool::roundUp(sizeof(AllocHeader) + header->size)) {
+        return p;
+    }
+
+    // Otherwise move; arena blocks are reclaimed on reset
+    void* q = arenaMalloc(newSize);
+    if (q) {
+        std::memcpy(q, p, std::min(oldSize, newSize));
+        arenaFree(p);
+    }
+    return q;
+}
+
+void arenaFree(void* p) {
+    if (!p) return;
+    AllocHeader* header = headerOf(p);
+    if (header->origin == kFromHeap) {
+        std::free(header);
+    } else if (header->origin == kFromPool) {
+        BufferPool::local().release(header, sizeof(AllocHeader) + header->size);
+    } else if (header->origin == kFromScratch) {
+        ScratchSpace::unmap(header, sizeof(AllocHeader) + header->size);
+    }
+}
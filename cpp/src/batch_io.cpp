@@ -0,0 +1,759 @@
+#include "batch_io.h"
+#include "trace_log.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+namespace fs = std::filesystem;
+
+struct WriteJob {
+    std::string path;
+    std::string tempPath;  // written first, then renamed over `path`
+    std::string data;
+    std::string error;
+};
+
+// Sibling of `path` that no other writer uses: same directory, so the
+// final rename stays atomic, and hidden so directory scans skip it
+std::string tempPathFor(const std::string& path) {
+    static std::atomic<unsigned long> counter{0};
+#ifdef _WIN32
+    unsigned long pid = static_cast<unsigned long>(_getpid());
+#else
+    unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+    fs::path target(path);
+    std::string name = "." + target.filename().string() + "." + std::to_string(pid) + "-" +
+                       std::to_string(counter++) + ".tmp";
+    return (target.parent_path() / name).string();
+}
+
+void removeQuietly(const std::string& path) {
+    std::error_code ec;
+    fs::remove(path, ec);
+}
+
+// Publish a fully written temp file under its final name
+void publish(WriteJob& job) {
+    std::error_code ec;
+    fs::rename(job.tempPath, job.path, ec);
+    if (ec) {
+        job.error = "Failed to rename " + job.tempPath + " to " + job.path + ": " + ec.message();
+        removeQuietly(job.tempPath);
+    }
+}
+
+// With fsync enabled, make the renames of a batch durable: one fsync per
+// distinct target directory
+void syncDirectories(const std::vector<WriteJob>& jobs) {
+    std::vector<std::string> dirs;
+    for (const auto& job : jobs) {
+        if (!job.error.empty()) continue;
+        std::string dir = fs::path(job.path).parent_path().string();
+        if (std::find(dirs.begin(), dirs.end(), dir) == dirs.end()) {
+            dirs.push_back(dir);
+        }
+    }
+    for (const auto& dir : dirs) {
+        syncPath(dir.empty() ? "." : dir);
+    }
+}
+
+// Performs one batch of reads or writes. Writes go to each job's temp file,
+// are flushed to disk when `sync` is set, and are then renamed into place.
+class Backend {
+public:
+    virtual ~Backend() = default;
+    virtual void read(std::vector<FileData>& files) = 0;
+    virtual void write(std::vector<WriteJob>& jobs, bool sync) = 0;
+    virtual const char* name() const = 0;
+};
+
+// Plain blocking I/O, one file after another on the I/O thread
+class BlockingBackend : public Backend {
+public:
+    void read(std::vector<FileData>& files) override {
+        for (auto& file : files) {
+            std::ifstream in(file.path, std::ios::binary);
+            if (!in) {
+                file.error = "Failed to open " + file.path;
+                continue;
+            }
+            file.bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            if (in.bad()) {
+                file.error = "Failed to read " + file.path;
+            }
+        }
+    }
+
+    void write(std::vector<WriteJob>& jobs, bool sync) override {
+        for (auto& job : jobs) {
+            std::ofstream out(job.tempPath, std::ios::binary | std::ios::trunc);
+            out.write(job.data.data(), static_cast<std::streamsize>(job.data.size()));
+            out.close();
+            if (!out) {
+                job.error = "Failed to write " + job.tempPath;
+            } else if (sync && !syncPath(job.tempPath)) {
+                job.error = "Failed to sync " + job.tempPath;
+            }
+            if (job.error.empty()) {
+                publish(job);
+            } else {
+                removeQuietly(job.tempPath);
+            }
+        }
+        if (sync) {
+            syncDirectories(jobs);
+        }
+    }
+
+    const char* name() const override { return "threads"; }
+};
+
+#ifdef __linux__
+
+// Minimal io_uring driver on the raw syscalls (no liburing dependency).
+// Each phase queues one SQE per file, submits them with a single
+// io_uring_enter and waits for all completions.
+class UringBackend : public Backend {
+public:
+    static std::unique_ptr<UringBackend> create(unsigned entries) {
+        std::unique_ptr<UringBackend> ring(new UringBackend());
+        if (!ring->init(entries)) {
+            return nullptr;
+        }
+        return ring;
+    }
+
+    ~UringBackend() override {
+        if (sqes_) munmap(sqes_, sqesSize_);
+        if (cqRing_ && cqRing_ != sqRing_) munmap(cqRing_, cqRingSize_);
+        if (sqRing_) munmap(sqRing_, sqRingSize_);
+        if (fd_ >= 0) close(fd_);
+    }
+
+    void read(std::vector<FileData>& files) override {
+        for (size_t begin = 0; begin < files.size(); begin += entries_) {
+            size_t end = std::min(files.size(), begin + entries_);
+            readRange(files, begin, end);
+        }
+    }
+
+    void write(std::vector<WriteJob>& jobs, bool sync) override {
+        for (size_t begin = 0; begin < jobs.size(); begin += entries_) {
+            size_t end = std::min(jobs.size(), begin + entries_);
+            writeRange(jobs, begin, end, sync);
+        }
+        if (sync) {
+            syncDirectories(jobs);
+        }
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+private:
+    // First read per file; files that fill it are read again with a doubled buffer
+    static constexpr size_t kInitialRead = 64 * 1024;
+    static constexpr size_t kMaxIo = 1u << 30;
+
+    UringBackend() = default;
+
+    static int setup(unsigned entries, io_uring_params* params) {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int enter(unsigned toSubmit, unsigned minComplete) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd_, toSubmit, minComplete,
+                                        IORING_ENTER_GETEVENTS, nullptr, 0));
+    }
+
+    bool init(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd_ = setup(entries, &params);
+        if (fd_ < 0) {
+            return false;
+        }
+        entries_ = params.sq_entries;
+
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) {
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        }
+        sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       fd_, IORING_OFF_SQ_RING);
+        if (sqRing_ == MAP_FAILED) {
+            sqRing_ = nullptr;
+            return false;
+        }
+        if (single) {
+            cqRing_ = sqRing_;
+        } else {
+            cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           fd_, IORING_OFF_CQ_RING);
+            if (cqRing_ == MAP_FAILED) {
+                cqRing_ = nullptr;
+                return false;
+            }
+        }
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        char* sq = static_cast<char*>(sqRing_);
+        char* cq = static_cast<char*>(cqRing_);
+        sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        return supportsOpcodes();
+    }
+
+    // The file opcodes appeared in 5.6; older kernels take the blocking path.
+    // RENAMEAT (5.11) is optional: without it renames are plain syscalls.
+    bool supportsOpcodes() {
+        constexpr unsigned kOps = 64;
+        std::vector<uint8_t> buffer(sizeof(io_uring_probe) + kOps * sizeof(io_uring_probe_op), 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, kOps) < 0) {
+            return false;
+        }
+        auto supported = [&](int op) {
+            return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+        };
+        for (int op : {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC, IORING_OP_CLOSE}) {
+            if (!supported(op)) {
+                return false;
+            }
+        }
+        hasRenameAt_ = supported(IORING_OP_RENAMEAT);
+        return true;
+    }
+
+    io_uring_sqe* nextSqe(uint64_t userData) {
+        unsigned index = queuedTail_ & sqMask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->user_data = userData;
+        sqArray_[index] = index;
+        ++queuedTail_;
+        ++queued_;
+        return sqe;
+    }
+
+    void prepOpen(uint64_t userData, const std::string& path, int flags, unsigned mode) {
+        io_uring_sqe* sqe = nextSqe(userData);
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(path.c_str());
+        sqe->len = mode;
+        sqe->open_flags = static_cast<uint32_t>(flags);
+    }
+
+    void prepRw(uint64_t userData, uint8_t opcode, int fd, const void* buffer, size_t bytes, uint64_t offset) {
+        io_uring_sqe* sqe = nextSqe(userData);
+        sqe->opcode = opcode;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(buffer);
+        sqe->len = static_cast<uint32_t>(std::min(bytes, kMaxIo));
+        sqe->off = offset;
+    }
+
+    void prepClose(int fd) {
+        io_uring_sqe* sqe = nextSqe(0);
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = fd;
+    }
+
+    void prepFsync(uint64_t userData, int fd) {
+        io_uring_sqe* sqe = nextSqe(userData);
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fd = fd;
+    }
+
+    void prepRename(uint64_t userData, const std::string& from, const std::string& to) {
+        io_uring_sqe* sqe = nextSqe(userData);
+        sqe->opcode = IORING_OP_RENAMEAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(from.c_str());
+        sqe->len = static_cast<uint32_t>(AT_FDCWD);
+        sqe->addr2 = reinterpret_cast<uint64_t>(to.c_str());
+    }
+
+    // Submit everything queued and call fn(userData, result) for each completion
+    template <typename Fn>
+    void submitAndWait(Fn&& fn) {
+        unsigned expected = queued_;
+        if (expected == 0) return;
+        __atomic_store_n(sqTail_, queuedTail_, __ATOMIC_RELEASE);
+        unsigned toSubmit = queued_;
+        queued_ = 0;
+
+        unsigned completed = 0;
+        while (completed < expected) {
+            int ret = enter(toSubmit, expected - completed);
+            if (ret < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                    toSubmit = queuedTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+                } else {
+                    throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+                }
+            } else {
+                toSubmit -= std::min(toSubmit, static_cast<unsigned>(ret));
+            }
+
+            unsigned head = *cqHead_;
+            unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head) {
+                const io_uring_cqe& cqe = cqes_[head & cqMask_];
+                fn(cqe.user_data, cqe.res);
+                ++completed;
+            }
+            __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+        }
+    }
+
+    void readRange(std::vector<FileData>& files, size_t begin, size_t end) {
+        std::vector<int> fds(end - begin, -1);
+        std::vector<size_t> filled(end - begin, 0);
+
+        for (size_t i = begin; i < end; ++i) {
+            prepOpen(i - begin, files[i].path, O_RDONLY | O_CLOEXEC, 0);
+        }
+        submitAndWait([&](uint64_t k, int res) {
+            if (res < 0) {
+                files[begin + k].error = "Failed to open " + files[begin + k].path + ": " + std::strerror(-res);
+            } else {
+                fds[k] = res;
+            }
+        });
+
+        // Read until a short read marks the end of each file
+        std::vector<size_t> pending, more;
+        for (size_t k = 0; k < fds.size(); ++k) {
+            if (fds[k] >= 0) {
+                files[begin + k].bytes.resize(kInitialRead);
+                pending.push_back(k);
+            }
+        }
+        while (!pending.empty()) {
+            for (size_t k : pending) {
+                std::vector<uint8_t>& bytes = files[begin + k].bytes;
+                prepRw(k, IORING_OP_READ, fds[k], bytes.data() + filled[k], bytes.size() - filled[k], filled[k]);
+            }
+            more.clear();
+            submitAndWait([&](uint64_t k, int res) {
+                FileData& file = files[begin + k];
+                if (res < 0) {
+                    file.error = "Failed to read " + file.path + ": " + std::strerror(-res);
+                    return;
+                }
+                filled[k] += static_cast<size_t>(res);
+                if (res > 0 && filled[k] == file.bytes.size()) {
+                    file.bytes.resize(file.bytes.size() * 2);
+                    more.push_back(k);
+                }
+            });
+            pending.swap(more);
+        }
+
+        for (size_t k = 0; k < fds.size(); ++k) {
+            if (fds[k] < 0) continue;
+            files[begin + k].bytes.resize(filled[k]);
+            prepClose(fds[k]);
+        }
+        submitAndWait([](uint64_t, int) {});
+    }
+
+    void writeRange(std::vector<WriteJob>& jobs, size_t begin, size_t end, bool sync) {
+        std::vector<int> fds(end - begin, -1);
+        std::vector<size_t> written(end - begin, 0);
+
+        for (size_t i = begin; i < end; ++i) {
+            prepOpen(i - begin, jobs[i].tempPath, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        }
+        submitAndWait([&](uint64_t k, int res) {
+            if (res < 0) {
+                jobs[begin + k].error = "Failed to create " + jobs[begin + k].tempPath + ": " + std::strerror(-res);
+            } else {
+                fds[k] = res;
+            }
+        });
+
+        // Short writes are resubmitted for the remainder
+        std::vector<size_t> pending, more;
+        for (size_t k = 0; k < fds.size(); ++k) {
+            if (fds[k] >= 0 && !jobs[begin + k].data.empty()) pending.push_back(k);
+        }
+        while (!pending.empty()) {
+            for (size_t k : pending) {
+                const std::string& data = jobs[begin + k].data;
+                prepRw(k, IORING_OP_WRITE, fds[k], data.data() + written[k], data.size() - written[k], written[k]);
+            }
+            more.clear();
+            submitAndWait([&](uint64_t k, int res) {
+                WriteJob& job = jobs[begin + k];
+                if (res <= 0) {
+                    job.error = "Failed to write " + job.tempPath + ": " + std::strerror(res < 0 ? -res : EIO);
+                    return;
+                }
+                written[k] += static_cast<size_t>(res);
+                if (written[k] < job.data.size()) {
+                    more.push_back(k);
+                }
+            });
+            pending.swap(more);
+        }
+
+        if (sync) {
+            for (size_t k = 0; k < fds.size(); ++k) {
+                if (fds[k] >= 0 && jobs[begin + k].error.empty()) prepFsync(k, fds[k]);
+            }
+            submitAndWait([&](uint64_t k, int res) {
+                if (res < 0) {
+                    jobs[begin + k].error = "Failed to sync " + jobs[begin + k].tempPath + ": " + std::strerror(-res);
+                }
+            });
+        }
+
+        for (size_t k = 0; k < fds.size(); ++k) {
+            if (fds[k] >= 0) prepClose(fds[k]);
+        }
+        submitAndWait([](uint64_t, int) {});
+
+        // Publish the complete files; failed ones leave no temp file behind
+        for (size_t i = begin; i < end; ++i) {
+            if (!jobs[i].error.empty()) {
+                if (fds[i - begin] >= 0) removeQuietly(jobs[i].tempPath);
+            } else if (hasRenameAt_) {
+                prepRename(i - begin, jobs[i].tempPath, jobs[i].path);
+            } else {
+                publish(jobs[i]);
+            }
+        }
+        submitAndWait([&](uint64_t k, int res) {
+            WriteJob& job = jobs[begin + k];
+            if (res < 0) {
+                job.error = "Failed to rename " + job.tempPath + " to " + job.path + ": " + std::strerror(-res);
+                removeQuietly(job.tempPath);
+            }
+        });
+    }
+
+    int fd_ = -1;
+    unsigned entries_ = 0;
+    void* sqRing_ = nullptr;
+    void* cqRing_ = nullptr;
+    size_t sqRingSize_ = 0;
+    size_t cqRingSize_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqesSize_ = 0;
+
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned cqMask_ = 0;
+
+    unsigned queuedTail_ = 0;
+    unsigned queued_ = 0;
+    bool hasRenameAt_ = false;
+};
+
+#endif
+
+std::unique_ptr<Backend> createBackend(size_t batchSize) {
+#ifdef __linux__
+    if (auto ring = UringBackend::create(static_cast<unsigned>(std::max<size_t>(batchSize, 8)))) {
+        return ring;
+    }
+#endif
+    (void)batchSize;
+    return std::make_unique<BlockingBackend>();
+}
+
+} // namespace
+
+struct BatchIO::State {
+    // Reads and writes have a thread (and an io_uring) each, so slow or
+    // fsync'd writes never hold up the read-ahead the converter waits on
+    std::unique_ptr<Backend> readBackend;
+    std::unique_ptr<Backend> writeBackend;
+    size_t batchSize;
+    bool sync;
+
+    std::mutex mutex;
+    std::condition_variable readWake;   // work for the reader thread
+    std::condition_variable writeWake;  // work for the writer thread
+    std::condition_variable progress;   // a batch finished
+
+    std::deque<std::string> pendingReads;
+    std::deque<FileData> readyReads;
+    size_t readsInFlight = 0;
+
+    std::vector<WriteJob> pendingWrites;
+    size_t writesInFlight = 0;
+    std::vector<std::string> writeErrors;
+
+    bool stopping = false;
+    std::thread reader;
+    std::thread writer;
+
+    // Keep at most this many files read but not yet taken
+    size_t readAhead() const { return batchSize * 2; }
+
+    bool canRead() const {
+        return !pendingReads.empty() && readyReads.size() + readsInFlight < readAhead();
+    }
+
+    void runReads() {
+        TraceLog::setThreadName("io reader");
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            readWake.wait(lock, [&] { return stopping || canRead(); });
+            if (stopping) {
+                return;
+            }
+            size_t count = std::min({batchSize, pendingReads.size(), readAhead() - readyReads.size() - readsInFlight});
+            std::vector<FileData> batch(count);
+            for (auto& file : batch) {
+                file.path = std::move(pendingReads.front());
+                pendingReads.pop_front();
+            }
+            readsInFlight += count;
+            lock.unlock();
+            {
+                TraceSpan span("read");
+                runBatch([&] { readBackend->read(batch); }, batch);
+                for (auto& file : batch) {
+                    if (file.error.empty()) file.hash = contentHash(file.bytes.data(), file.bytes.size());
+                }
+            }
+            lock.lock();
+            for (auto& file : batch) {
+                readyReads.push_back(std::move(file));
+            }
+            readsInFlight -= count;
+            progress.notify_all();
+        }
+    }
+
+    void runWrites() {
+        TraceLog::setThreadName("io writer");
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            writeWake.wait(lock, [&] { return stopping || !pendingWrites.empty(); });
+            if (pendingWrites.empty()) {
+                return;
+            }
+            size_t count = std::min(batchSize, pendingWrites.size());
+            std::vector<WriteJob> batch(std::make_move_iterator(pendingWrites.begin()),
+                                        std::make_move_iterator(pendingWrites.begin() + count));
+            pendingWrites.erase(pendingWrites.begin(), pendingWrites.begin() + count);
+            writesInFlight += count;
+            lock.unlock();
+            {
+                TraceSpan span("write");
+                runBatch([&] { writeBackend->write(batch, sync); }, batch);
+            }
+            lock.lock();
+            for (auto& job : batch) {
+                if (!job.error.empty()) writeErrors.push_back(std::move(job.error));
+            }
+            writesInFlight -= count;
+            progress.notify_all();
+        }
+    }
+
+    // A backend failure fails the whole batch instead of the thread
+    template <typename Fn, typename Batch>
+    static void runBatch(Fn&& fn, Batch& batch) {
+        try {
+            fn();
+        } catch (const std::exception& e) {
+            for (auto& item : batch) {
+                if (item.error.empty()) item.error = e.what();
+            }
+        }
+    }
+};
+
+uint64_t contentHash(const uint8_t* data, size_t size) {
+    // splitmix64 finalizer over 8-byte words
+    auto mix = [](uint64_t x) {
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    };
+    uint64_t h = mix(size + 0x9E3779B97F4A7C15ull);
+    if (size == 0) {
+        // data may be null; the same value as the tail step below
+        return mix(h);
+    }
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        h = mix(h ^ word) + 0x9E3779B97F4A7C15ull;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, data + i, size - i);
+    return mix(h ^ tail);
+}
+
+bool syncPath(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+    return true;
+#else
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+#endif
+}
+
+BatchIO::BatchIO(size_t batchSize, bool sync)
+    : state_(new State()) {
+    state_->batchSize = std::max<size_t>(1, batchSize);
+    state_->sync = sync;
+    state_->readBackend = createBackend(state_->batchSize);
+    state_->writeBackend = createBackend(state_->batchSize);
+    state_->reader = std::thread([state = state_.get()] { state->runReads(); });
+    state_->writer = std::thread([state = state_.get()] { state->runWrites(); });
+}
+
+BatchIO::~BatchIO() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->stopping = true;
+        state_->pendingReads.clear();
+    }
+    state_->readWake.notify_all();
+    state_->writeWake.notify_all();
+    state_->reader.join();
+    state_->writer.join();
+}
+
+void BatchIO::prefetch(const std::vector<std::string>& paths) {
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->pendingReads.insert(state_->pendingReads.end(), paths.begin(), paths.end());
+    }
+    state_->readWake.notify_all();
+}
+
+FileData BatchIO::nextRead() {
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    if (state_->readyReads.empty() && state_->readsInFlight == 0 && state_->pendingReads.empty()) {
+        throw std::logic_error("BatchIO::nextRead without a pending prefetch");
+    }
+    state_->progress.wait(lock, [&] { return !state_->readyReads.empty(); });
+    FileData file = std::move(state_->readyReads.front());
+    state_->readyReads.pop_front();
+    lock.unlock();
+    // Room for the next read batch
+    state_->readWake.notify_all();
+    return file;
+}
+
+void BatchIO::write(const std::string& path, std::string data) {
+    WriteJob job{path, tempPathFor(path), std::move(data), {}};
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->pendingWrites.push_back(std::move(job));
+    }
+    state_->writeWake.notify_all();
+}
+
+std::vector<std::string> BatchIO::flush() {
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    state_->progress.wait(lock, [&] {
+        return state_->pendingWrites.empty() && state_->writesInFlight == 0;
+    });
+    std::vector<std::string> errors;
+    errors.swap(state_->writeErrors);
+    return errors;
+}
+
+std::vector<std::string> BatchIO::copyOutputs(const std::vector<OutputCopy>& copies, bool link) {
+    std::vector<WriteJob> jobs;
+    for (const auto& copy : copies) {
+        WriteJob job{copy.path, tempPathFor(copy.path), {}, {}};
+        std::error_code ec;
+        bool linked = false;
+        if (link) {
+            fs::create_hard_link(copy.source, job.tempPath, ec);
+            linked = !ec;
+        }
+        if (!linked) {
+            fs::copy_file(copy.source, job.tempPath, fs::copy_options::overwrite_existing, ec);
+            if (!ec && state_->sync && !syncPath(job.tempPath)) {
+                ec = std::make_error_code(std::errc::io_error);
+            }
+        }
+        if (ec) {
+            job.error = "Failed to copy " + copy.source + " to " + copy.path + ": " + ec.message();
+            removeQuietly(job.tempPath);
+        } else {
+            publish(job);
+            // Renaming a link over a name for the same file leaves the link
+            removeQuietly(job.tempPath);
+        }
+        jobs.push_back(std::move(job));
+    }
+    if (state_->sync) {
+        syncDirectories(jobs);
+    }
+    std::vector<std::string> errors;
+    for (auto& job : jobs) {
+        if (!job.error.empty()) errors.push_back(std::move(job.error));
+    }
+    return errors;
+}
+
+const char* BatchIO::backend() const {
+    return state_->readBackend->name();
+}
@@ -0,0 +1,579 @@
+#include "bench.h"
+#include "bench_baseline.h"
+#include "buffer_pool.h"
+#include "complexity.h"
+#include "logger.h"
+#include "scratch_space.h"
+#include "vectorizer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+namespace fs = std::filesystem;
+
+std::vector<CorpusImage> loadCorpus(const std::string& dir) {
+    if (!fs::is_directory(dir)) {
+        throw std::runtime_error("不是目录: " + dir);
+    }
+    std::vector<fs::path> paths;
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        std::string ext = entry.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (entry.is_regular_file() && ext == ".png") {
+            paths.push_back(entry.path());
+        }
+    }
+    if (paths.empty()) {
+        throw std::runtime_error("目录中没有PNG文件: " + dir);
+    }
+    std::sort(paths.begin(), paths.end());
+
+    std::vector<CorpusImage> images;
+    for (const auto& path : paths) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("无法读取: " + path.string());
+        }
+        CorpusImage image;
+        image.name = path.filename().string();
+        image.png.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        images.push_back(std::move(image));
+    }
+    return images;
+}
+
+void convertCorpusImage(const CorpusImage& image, int optionIndex, Conversion& result) {
+    auto start = std::chrono::steady_clock::now();
+    Vectorizer vectorizer;
+    try {
+        std::vector<VectorizationOption> options = vectorizer.inspectImage(image.png.data(), image.png.size());
+        if (!options.empty()) {
+            const VectorizationOption& option =
+                options[std::max(0, std::min(optionIndex, static_cast<int>(options.size()) - 1))];
+            std::string svg = vectorizer.convertImage(image.png.data(), image.png.size(), option.step,
+                                                      option.colors);
+            result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            result.svgHash = 14695981039346656037ull;
+            for (char c : svg) {
+                result.svgHash = (result.svgHash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+            }
+            result.ok = true;
+        }
+    } catch (const std::exception& e) {
+        logDebug("image_failed").field("input", image.name).field("error", e.what())
+            << "  ✗ " << image.name << ": " << e.what();
+    }
+    if (!result.ok) {
+        result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    result.stats = vectorizer.stats();
+}
+
+namespace {
+
+// Convert every image once on `threads` threads; returns the wall time
+double runPass(const std::vector<CorpusImage>& images, int threads, int optionIndex,
+               std::vector<Conversion>& results) {
+    results.assign(images.size(), Conversion());
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        for (size_t i = next.fetch_add(1); i < images.size(); i = next.fetch_add(1)) {
+            convertCorpusImage(images[i], optionIndex, results[i]);
+        }
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; ++t) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Forget the process's resident high-water mark so each thread count gets
+// its own; Linux only, elsewhere the peak is cumulative
+void resetPeakResident() {
+#if defined(__linux__)
+    std::ofstream clear("/proc/self/clear_refs");
+    clear << "5";
+#endif
+}
+
+double peakResident() {
+#if defined(__linux__)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::stod(line.substr(6)) * 1024;   // kB
+        }
+    }
+#endif
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        return static_cast<double>(usage.ru_maxrss);
+#else
+        return static_cast<double>(usage.ru_maxrss) * 1024;
+#endif
+    }
+#endif
+    return 0;
+}
+
+template <typename T>
+T& stageSlot(std::vector<std::pair<std::string, T>>& stages, const std::string& name) {
+    for (auto& stage : stages) {
+        if (stage.first == name) return stage.second;
+    }
+    stages.emplace_back(name, T());
+    return stages.back().second;
+}
+
+void accumulate(BenchRun& run, const std::vector<CorpusImage>& images, const std::vector<Conversion>& results) {
+    if (run.imageMs.empty()) {
+        for (const auto& image : images) {
+            run.imageMs.emplace_back(image.name, std::vector<double>());
+        }
+        run.imageHashes.resize(images.size());
+    }
+    size_t converted = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Conversion& c = results[i];
+        if (!c.ok) {
+            run.failures++;
+            continue;
+        }
+        converted++;
+        run.images++;
+        if (!c.stats.downgrade.empty()) run.downgrades++;
+        run.latencyMs.push_back(c.ms);
+        run.imageMs[i].second.push_back(c.ms);
+        std::vector<uint64_t>& hashes = run.imageHashes[i];
+        if (std::find(hashes.begin(), hashes.end(), c.svgHash) == hashes.end()) {
+            hashes.push_back(c.svgHash);
+        }
+        run.megapixels += static_cast<double>(c.stats.width) * c.stats.height / 1e6;
+        run.cpuMs += c.stats.cpuMs;
+        run.potraceCpuMs += c.stats.potraceCpuMs;
+        for (const auto& stage : c.stats.stageMs) {
+            stageSlot(run.stageMs, stage.first) += stage.second;
+        }
+        for (const auto& stage : c.stats.stageAllocs) {
+            stageSlot(run.stageAllocs, stage.first) += stage.second;
+        }
+    }
+    run.passImages.push_back(converted);
+}
+
+std::string formatBytes(double bytes) {
+    char text[32];
+    if (bytes <= 0) {
+        std::snprintf(text, sizeof(text), "-");
+    } else if (bytes >= 1024.0 * 1024 * 1024) {
+        std::snprintf(text, sizeof(text), "%.2f GB", bytes / (1024.0 * 1024 * 1024));
+    } else {
+        std::snprintf(text, sizeof(text), "%.1f MB", bytes / (1024.0 * 1024));
+    }
+    return text;
+}
+
+// 1, 2, 4, ... up to and including `max`
+std::vector<int> doublingThreads(int max) {
+    std::vector<int> counts;
+    for (int t = 1; t < max; t *= 2) {
+        counts.push_back(t);
+    }
+    counts.push_back(max);
+    return counts;
+}
+
+std::vector<int> parseThreads(const std::string& text) {
+    if (text.find(',') == std::string::npos) {
+        return doublingThreads(std::max(1, std::stoi(text)));
+    }
+    std::vector<int> counts;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        counts.push_back(std::max(1, std::stoi(item)));
+    }
+    std::sort(counts.begin(), counts.end());
+    counts.erase(std::unique(counts.begin(), counts.end()), counts.end());
+    return counts;
+}
+
+void showBenchUsage() {
+    std::cout << R"(
+用法: png2svg bench <目录> [选项]
+
+在内存中对目录里的每个PNG反复执行完整转换（检查 + 矢量化），不写出任何文件，
+报告吞吐量、延迟分位数、峰值内存、各阶段耗时，以及不同线程数下的扩展效率。
+
+选项:
+  --warmup N      每个线程数计时前的预热轮数（默认: 1）
+  --iterations N  每个线程数的计时轮数，每轮转换全部图片一次（默认: 5）
+  --threads N     比较 1、2、4 … N 个线程（默认: CPU核心数）
+  --threads A,B,C 只比较列出的线程数
+  --option N      使用第N个矢量化选项（默认: 0）
+  --save FILE     把结果保存为基线JSON（含格式版本、转换器版本、主机与每轮原始样本）
+  --compare FILE  与基线比较，吞吐量或单图延迟（经多重比较校正）显著变慢、或
+                  性能分析构建的分配计数增加时以状态码1退出；
+                  未指定的目录、--warmup、--iterations、--threads、--option 沿用基线中的设置
+  --threshold PCT 变慢至少PCT%且95%置信区间整体变慢才算回归（默认: 5）
+  --max-ms N      任一图片的任一次转换超过N毫秒时列出这些图片并以状态码1退出
+  --huge-pages    图像缓冲区使用透明大页（Linux）
+  --max-resident MB
+                  解码后超过MB兆字节的图像使用外存模式
+  --max-edges N, --max-components N, --complexity-fallback MODE
+                  复杂度上限与降级方式，同转换命令
+  --log-level LEVEL
+                  进度日志级别: debug（含每次失败的原因）, info（默认）, warn, error
+  --log-format FORMAT
+                  进度日志格式: text（默认）或 json
+  --help, -h      显示此帮助信息
+)" << std::endl;
+}
+
+} // namespace
+
+double BenchRun::seconds() const {
+    double ms = 0;
+    for (double pass : passMs) ms += pass;
+    return ms / 1000.0;
+}
+
+double BenchRun::imagesPerSecond() const {
+    double s = seconds();
+    return s > 0 ? static_cast<double>(images) / s : 0;
+}
+
+double BenchRun::megapixelsPerSecond() const {
+    double s = seconds();
+    return s > 0 ? megapixels / s : 0;
+}
+
+std::vector<double> BenchRun::passImagesPerSecond() const {
+    std::vector<double> rates;
+    for (size_t i = 0; i < passMs.size() && i < passImages.size(); ++i) {
+        rates.push_back(passMs[i] > 0 ? passImages[i] * 1000.0 / passMs[i] : 0);
+    }
+    return rates;
+}
+
+double BenchRun::latencyPercentile(double q) const {
+    if (latencyMs.empty()) {
+        return 0;
+    }
+    std::vector<double> sorted = latencyMs;
+    std::sort(sorted.begin(), sorted.end());
+    size_t rank = static_cast<size_t>(std::ceil(q * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+std::vector<BenchRun> runBenchmark(const BenchOptions& options) {
+    std::vector<CorpusImage> images = loadCorpus(options.corpus);
+    size_t pngBytes = 0;
+    for (const auto& image : images) pngBytes += image.png.size();
+    logInfo("bench_start").field("corpus", options.corpus).field("images", images.size())
+        << "基准测试: " << images.size() << " 个PNG文件 (" << formatBytes(static_cast<double>(pngBytes))
+        << "), 预热 " << options.warmup << " 轮, 计时 " << options.iterations << " 轮";
+
+    std::vector<BenchRun> runs;
+    std::vector<Conversion> results;
+    for (int threads : options.threads) {
+        for (int i = 0; i < options.warmup; ++i) {
+            runPass(images, threads, options.optionIndex, results);
+        }
+        BenchRun run;
+        run.threads = threads;
+        resetPeakResident();
+        for (int i = 0; i < options.iterations; ++i) {
+            run.passMs.push_back(runPass(images, threads, options.optionIndex, results));
+            accumulate(run, images, results);
+        }
+        run.peakResidentBytes = peakResident();
+        logInfo("bench_run").field("threads", threads).field("images_per_second", run.imagesPerSecond())
+            << "  " << threads << " 线程: " << run.imagesPerSecond() << " 图片/秒";
+        runs.push_back(std::move(run));
+    }
+    return runs;
+}
+
+std::vector<std::string> nondeterministicImages(const std::vector<BenchRun>& runs) {
+    std::vector<std::string> names;
+    if (runs.empty()) {
+        return names;
+    }
+    for (size_t i = 0; i < runs.front().imageHashes.size(); ++i) {
+        std::vector<uint64_t> distinct;
+        for (const BenchRun& run : runs) {
+            for (uint64_t hash : run.imageHashes[i]) {
+                if (std::find(distinct.begin(), distinct.end(), hash) == distinct.end()) {
+                    distinct.push_back(hash);
+                }
+            }
+        }
+        if (distinct.size() > 1) {
+            names.push_back(runs.front().imageMs[i].first);
+        }
+    }
+    return names;
+}
+
+std::vector<std::pair<std::string, double>> slowImages(const std::vector<BenchRun>& runs, double maxMs) {
+    std::vector<std::pair<std::string, double>> slow;
+    if (runs.empty()) {
+        return slow;
+    }
+    for (size_t i = 0; i < runs.front().imageMs.size(); ++i) {
+        double worst = 0;
+        for (const BenchRun& run : runs) {
+            for (double ms : run.imageMs[i].second) {
+                worst = std::max(worst, ms);
+            }
+        }
+        if (worst > maxMs) {
+            slow.emplace_back(runs.front().imageMs[i].first, worst);
+        }
+    }
+    return slow;
+}
+
+void printBenchReport(const BenchOptions& options, const std::vector<BenchRun>& runs, std::ostream& out) {
+    if (runs.empty()) {
+        return;
+    }
+    char line[200];
+    out << "吞吐量与扩展性 (" << options.corpus << "):" << std::endl;
+    std::snprintf(line, sizeof(line), "  %7s %10s %9s %9s %9s %9s %8s %10s %10s",
+                  "threads", "images/s", "MP/s", "p50 ms", "p95 ms", "p99 ms", "speedup", "efficiency",
+                  "peak RSS");
+    out << line << std::endl;
+    const BenchRun& base = runs.front();
+    for (const BenchRun& run : runs) {
+        double speedup = base.imagesPerSecond() > 0 ? run.imagesPerSecond() / base.imagesPerSecond() : 0;
+        // Relative to the first row, which is normally one thread
+        double efficiency = speedup * base.threads / run.threads;
+        std::snprintf(line, sizeof(line), "  %7d %10.2f %9.2f %9.2f %9.2f %9.2f %7.2fx %9.0f%% %10s",
+                      run.threads, run.imagesPerSecond(), run.megapixelsPerSecond(),
+                      run.latencyPercentile(0.50), run.latencyPercentile(0.95), run.latencyPercentile(0.99),
+                      speedup, efficiency * 100, formatBytes(run.peakResidentBytes).c_str());
+        out << line << std::endl;
+    }
+
+    // Stage times from the first thread count, where stages do not contend
+    double total = 0;
+    for (const auto& stage : base.stageMs) total += stage.second;
+    out << std::endl << "阶段耗时 (" << base.threads << " 线程, 每张图片平均):" << std::endl;
+    bool allocs = !base.stageAllocs.empty();
+    std::snprintf(line, sizeof(line), "  %-10s %11s %7s%s", "stage", "ms/image", "share",
+                  allocs ? "     allocs/image   alloc bytes/image" : "");
+    out << line << std::endl;
+    double perImage = base.images > 0 ? 1.0 / base.images : 0;
+    for (const auto& stage : base.stageMs) {
+        std::snprintf(line, sizeof(line), "  %-10s %11.3f %6.1f%%", stage.first.c_str(),
+                      stage.second * perImage, total > 0 ? stage.second / total * 100 : 0);
+        out << line;
+        if (allocs) {
+            AllocCounters counters;
+            for (const auto& a : base.stageAllocs) {
+                if (a.first == stage.first) counters = a.second;
+            }
+            std::snprintf(line, sizeof(line), " %16.1f %19.0f", counters.allocations * perImage,
+                          counters.bytes * perImage);
+            out << line;
+        }
+        out << std::endl;
+    }
+    std::snprintf(line, sizeof(line), "  %-10s %11.3f", "cpu", base.cpuMs * perImage);
+    out << line << std::endl;
+    std::snprintf(line, sizeof(line), "  %-10s %11.3f", "potrace cpu", base.potraceCpuMs * perImage);
+    out << line << std::endl;
+
+    size_t failures = 0, downgrades = 0;
+    for (const BenchRun& run : runs) {
+        failures += run.failures;
+        downgrades += run.downgrades;
+    }
+    if (downgrades > 0) {
+        out << std::endl << "复杂度超限降级: " << downgrades << " 次（preview 或 raster）" << std::endl;
+    }
+    if (failures > 0) {
+        out << std::endl << "转换失败: " << failures << " 次（不计入吞吐量与延迟；--log-level debug 查看原因）"
+            << std::endl;
+    }
+
+    std::vector<std::string> unstable = nondeterministicImages(runs);
+    if (!unstable.empty()) {
+        out << std::endl << "输出不一致: " << unstable.size() << " 张图片的SVG随轮次或线程数变化:";
+        for (const std::string& name : unstable) {
+            out << " " << name;
+        }
+        out << std::endl;
+    } else {
+        out << std::endl << "输出一致: 每张图片在各轮次与线程数下的SVG逐字节相同" << std::endl;
+    }
+}
+
+int benchCommand(int argc, char* argv[]) {
+    BenchOptions options;
+    options.threads = doublingThreads(static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+    size_t maxResidentMB = 0;
+    std::string savePath;
+    std::string comparePath;
+    double thresholdPercent = 5;
+    double maxMs = 0;
+    ComplexityLimits complexity;
+    // Settings given on the command line win over those of a baseline
+    bool setWarmup = false, setIterations = false, setThreads = false, setOption = false;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                showBenchUsage();
+                return 0;
+            } else if (arg == "--warmup" && i + 1 < argc) {
+                options.warmup = std::max(0, std::stoi(argv[++i]));
+                setWarmup = true;
+            } else if (arg == "--iterations" && i + 1 < argc) {
+                options.iterations = std::max(1, std::stoi(argv[++i]));
+                setIterations = true;
+            } else if (arg == "--threads" && i + 1 < argc) {
+                options.threads = parseThreads(argv[++i]);
+                setThreads = true;
+            } else if (arg == "--option" && i + 1 < argc) {
+                options.optionIndex = std::stoi(argv[++i]);
+                setOption = true;
+            } else if (arg == "--save" && i + 1 < argc) {
+                savePath = argv[++i];
+            } else if (arg == "--compare" && i + 1 < argc) {
+                comparePath = argv[++i];
+            } else if (arg == "--threshold" && i + 1 < argc) {
+                thresholdPercent = std::max(0.0, std::stod(argv[++i]));
+            } else if (arg == "--max-ms" && i + 1 < argc) {
+                maxMs = std::max(0.0, std::stod(argv[++i]));
+            } else if (arg == "--huge-pages") {
+                BufferPool::setHugePages(true);
+            } else if (arg == "--max-resident" && i + 1 < argc) {
+                maxResidentMB = std::stoul(argv[++i]);
+            } else if (arg == "--max-edges" && i + 1 < argc) {
+                complexity.maxEdges = std::stoull(argv[++i]);
+            } else if (arg == "--max-components" && i + 1 < argc) {
+                complexity.maxComponents = std::stoull(argv[++i]);
+            } else if (arg == "--complexity-fallback" && i + 1 < argc) {
+                if (!ComplexityGuard::parseFallback(argv[++i], complexity.fallback)) {
+                    std::cerr << "错误: 未知的降级方式 - " << argv[i] << std::endl;
+                    return 1;
+                }
+            } else if (arg == "--log-level" && i + 1 < argc) {
+                LogLevel level;
+                if (!Logger::parseLevel(argv[++i], level)) {
+                    std::cerr << "错误: 未知的日志级别 - " << argv[i] << std::endl;
+                    return 1;
+                }
+                Logger::setLevel(level);
+            } else if (arg == "--log-format" && i + 1 < argc) {
+                LogFormat format;
+                if (!Logger::parseFormat(argv[++i], format)) {
+                    std::cerr << "错误: 未知的日志格式 - " << argv[i] << std::endl;
+                    return 1;
+                }
+                Logger::setFormat(format);
+            } else if (options.corpus.empty() && arg[0] != '-') {
+                options.corpus = arg;
+            } else {
+                std::cerr << "错误: 未知的参数 - " << arg << std::endl;
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "错误: 参数无效 - " << e.what() << std::endl;
+        return 1;
+    }
+    BenchBaseline baseline;
+    if (!comparePath.empty()) {
+        try {
+            baseline = loadBaseline(comparePath);
+        } catch (const std::exception& e) {
+            logError("baseline_failed").field("error", e.what()) << "错误: " << e.what();
+            return 1;
+        }
+        if (options.corpus.empty()) options.corpus = baseline.options.corpus;
+        if (!setWarmup) options.warmup = baseline.options.warmup;
+        if (!setIterations) options.iterations = baseline.options.iterations;
+        if (!setThreads && !baseline.options.threads.empty()) options.threads = baseline.options.threads;
+        if (!setOption) options.optionIndex = baseline.options.optionIndex;
+    }
+    if (options.corpus.empty()) {
+        showBenchUsage();
+        return 1;
+    }
+    ScratchSpace::configure(maxResidentMB << 20);
+    ComplexityGuard::configure(complexity);
+
+    std::vector<BenchRun> runs;
+    try {
+        runs = runBenchmark(options);
+    } catch (const std::exception& e) {
+        logError("bench_failed").field("error", e.what()) << "错误: " << e.what();
+        return 1;
+    }
+    Logger::flush();
+    std::cout << std::endl;
+    printBenchReport(options, runs, std::cout);
+
+    // Any output that depends on the pass or thread count is a bug
+    int status = nondeterministicImages(runs).empty() ? 0 : 1;
+    for (const BenchRun& run : runs) {
+        if (run.images == 0) {
+            status = 1;
+        }
+    }
+    if (maxMs > 0) {
+        std::vector<std::pair<std::string, double>> slow = slowImages(runs, maxMs);
+        if (!slow.empty()) {
+            std::cout << std::endl << "超出时间上限: " << slow.size() << " 张图片的单次转换超过 " << maxMs << " ms:";
+            for (const auto& image : slow) {
+                std::cout << " " << image.first << " (" << image.second << " ms)";
+            }
+            std::cout << std::endl;
+            status = 1;
+        }
+    }
+    BenchBaseline current = makeBaseline(options, runs);
+    if (!savePath.empty()) {
+        try {
+            saveBaseline(current, savePath);
+            std::cout << std::endl << "基线已保存到: " << savePath << std::endl;
+        } catch (const std::exception& e) {
+            logError("baseline_failed").field("error", e.what()) << "错误: " << e.what();
+            status = 1;
+        }
+    }
+    if (!comparePath.empty()) {
+        std::cout << std::endl;
+        if (compareBaselines(baseline, current, thresholdPercent, std::cout) > 0) {
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,640 @@
+#include "bench_baseline.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#ifndef PNG2SVG_VERSION
+#define PNG2SVG_VERSION "unknown"
+#endif
+
+namespace {
+
+void appendJsonString(std::string& out, const std::string& value) {
+    out += '"';
+    for (unsigned char c : value) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += '"';
+}
+
+std::string formatNumber(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+    return buffer;
+}
+
+std::string utcNow() {
+    std::time_t seconds = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::tm utc{};
+#ifdef _WIN32
+    gmtime_s(&utc, &seconds);
+#else
+    gmtime_r(&seconds, &utc);
+#endif
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &utc);
+    return buffer;
+}
+
+std::string hostName() {
+#ifndef _WIN32
+    char name[256] = {};
+    if (gethostname(name, sizeof(name) - 1) == 0) {
+        return name;
+    }
+#endif
+    return "";
+}
+
+// Just enough JSON to read back what saveBaseline writes
+struct JsonValue {
+    enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+    bool boolean = false;
+    double number = 0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    const JsonValue* find(const std::string& key) const {
+        for (const auto& member : object) {
+            if (member.first == key) return &member.second;
+        }
+        return nullptr;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : text_(text) {}
+
+    JsonValue parse() {
+        JsonValue value = parseValue();
+        skipSpace();
+        if (pos_ != text_.size()) {
+            fail("trailing characters");
+        }
+        return value;
+    }
+
+private:
+    [[noreturn]] void fail(const std::string& what) {
+        throw std::runtime_error("JSON error at offset " + std::to_string(pos_) + ": " + what);
+    }
+
+    void skipSpace() {
+        while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) ++pos_;
+    }
+
+    bool consume(const char* literal) {
+        size_t length = std::char_traits<char>::length(literal);
+        if (text_.compare(pos_, length, literal) == 0) {
+            pos_ += length;
+            return true;
+        }
+        return false;
+    }
+
+    JsonValue parseValue() {
+        skipSpace();
+        if (pos_ >= text_.size()) fail("unexpected end");
+        JsonValue value;
+        char c = text_[pos_];
+        if (c == '{') {
+            value.type = JsonValue::Object;
+            ++pos_;
+            skipSpace();
+            if (consume("}")) return value;
+            do {
+                skipSpace();
+                std::string key = parseString();
+                skipSpace();
+                if (!consume(":")) fail("expected ':'");
+                value.object.emplace_back(std::move(key), parseValue());
+                skipSpace();
+            } while (consume(","));
+            if (!consume("}")) fail("expected '}'");
+        } else if (c == '[') {
+            value.type = JsonValue::Array;
+            ++pos_;
+            skipSpace();
+            if (consume("]")) return value;
+            do {
+                value.array.push_back(parseValue());
+                skipSpace();
+            } while (consume(","));
+            if (!consume("]")) fail("expected ']'");
+        } else if (c == '"') {
+            value.type = JsonValue::String;
+            value.string = parseString();
+        } else if (consume("true")) {
+            value.type = JsonValue::Bool;
+            value.boolean = true;
+        } else if (consume("false")) {
+            value.type = JsonValue::Bool;
+        } else if (consume("null")) {
+            value.type = JsonValue::Null;
+        } else {
+            const char* start = text_.c_str() + pos_;
+            char* end = nullptr;
+            value.type = JsonValue::Number;
+            value.number = std::strtod(start, &end);
+            if (end == start) fail("unexpected character");
+            pos_ += end - start;
+        }
+        return value;
+    }
+
+    std::string parseString() {
+        if (!consume("\"")) fail("expected string");
+        std::string out;
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+            char c = text_[pos_++];
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos_ >= text_.size()) break;
+            char e = text_[pos_++];
+            switch (e) {
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': {
+                    if (pos_ + 4 > text_.size()) fail("bad escape");
+                    unsigned code = static_cast<unsigned>(std::stoul(text_.substr(pos_, 4), nullptr, 16));
+                    pos_ += 4;
+                    // Only control characters are escaped by the writer
+                    if (code < 0x80) {
+                        out += static_cast<char>(code);
+                    } else {
+                        fail("unsupported escape");
+                    }
+                    break;
+                }
+                default: out += e;
+            }
+        }
+        if (!consume("\"")) fail("unterminated string");
+        return out;
+    }
+
+    const std::string& text_;
+    size_t pos_ = 0;
+};
+
+const JsonValue& member(const JsonValue& object, const std::string& key, JsonValue::Type type) {
+    const JsonValue* value = object.find(key);
+    if (!value || value->type != type) {
+        throw std::runtime_error("baseline is missing \"" + key + "\"");
+    }
+    return *value;
+}
+
+// Two-sided 95% quantile of Student's t with `df` degrees of freedom;
+// fractional df round down, which widens the interval slightly
+double tCritical95(double df) {
+    static const double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (df < 1) df = 1;
+    if (df <= 30) return table[static_cast<int>(df) - 1];
+    return 1.96 + 2.4 / df;   // within 0.002 of the exact value above 30
+}
+
+// Continued fraction of the regularized incomplete beta function, by
+// Lentz's method
+double betaFraction(double a, double b, double x) {
+    const double tiny = 1e-300;
+    auto clamp = [&](double v) { return std::fabs(v) < tiny ? tiny : v; };
+    double c = 1;
+    double d = 1 / clamp(1 - (a + b) * x / (a + 1));
+    double h = d;
+    for (int m = 1; m <= 300; ++m) {
+        double m2 = 2.0 * m;
+        double even = m * (b - m) * x / ((a + m2 - 1) * (a + m2));
+        d = 1 / clamp(1 + even * d);
+        c = clamp(1 + even / c);
+        h *= d * c;
+        double odd = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1));
+        d = 1 / clamp(1 + odd * d);
+        c = clamp(1 + odd / c);
+        double delta = d * c;
+        h *= delta;
+        if (std::fabs(delta - 1) < 1e-12) break;
+    }
+    return h;
+}
+
+// Regularized incomplete beta function I_x(a, b)
+double incompleteBeta(double a, double b, double x) {
+    if (x <= 0) return 0;
+    if (x >= 1) return 1;
+    double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) +
+                            a * std::log(x) + b * std::log1p(-x));
+    if (x < (a + 1) / (a + b + 2)) return front * betaFraction(a, b, x) / a;
+    return 1 - front * betaFraction(b, a, 1 - x) / b;
+}
+
+// P(T > t) for Student's t with `df` degrees of freedom
+double tUpperTail(double t, double df) {
+    double tail = 0.5 * incompleteBeta(df / 2, 0.5, df / (df + t * t));
+    return t > 0 ? tail : 1 - tail;
+}
+
+struct Summary {
+    size_t n = 0;
+    double mean = 0;
+    double variance = 0;   // sample variance, n - 1 denominator
+};
+
+Summary summarize(const std::vector<double>& samples) {
+    Summary s;
+    s.n = samples.size();
+    if (s.n == 0) return s;
+    for (double v : samples) s.mean += v;
+    s.mean /= s.n;
+    if (s.n > 1) {
+        for (double v : samples) s.variance += (v - s.mean) * (v - s.mean);
+        s.variance /= s.n - 1;
+    }
+    return s;
+}
+
+std::string formatPercent(double fraction) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%+.1f%%", fraction * 100);
+    return buffer;
+}
+
+// Throughput series are few and each is tested at 95%. The per-image
+// latency series are one family: with dozens of images some would pass a
+// 95% test by chance on every run, so they go through Holm-Bonferroni.
+bool inLatencyFamily(const BenchSeries& series) {
+    return series.name.rfind("latency/", 0) == 0;
+}
+
+// One compared series, kept until the latency family has been corrected
+struct Comparison {
+    const BenchSeries* series = nullptr;
+    Summary baseline;
+    Summary current;
+    double change = 0;
+    std::string interval = "-";
+    double pSlower = 1;    // one-sided p-value of "slower", 1 if untested
+    bool tested = false;
+    bool slower = false;   // significant at 95% on its own, past the threshold
+    bool faster = false;
+};
+
+void appendCounters(std::string& out, const AllocCounters& c) {
+    out += "\"allocations\": " + std::to_string(c.allocations) + ", \"bytes\": " + std::to_string(c.bytes) +
+           ", \"copies\": " + std::to_string(c.copies) + ", \"copyBytes\": " + std::to_string(c.copyBytes);
+}
+
+} // namespace
+
+BenchBaseline makeBaseline(const BenchOptions& options, const std::vector<BenchRun>& runs) {
+    BenchBaseline baseline;
+    baseline.converterVersion = PNG2SVG_VERSION;
+    baseline.created = utcNow();
+    baseline.host = hostName();
+    baseline.hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+    baseline.options = options;
+    for (const BenchRun& run : runs) {
+        BenchSeries series;
+        series.name = "throughput/threads=" + std::to_string(run.threads);
+        series.unit = "images/s";
+        series.higherIsBetter = true;
+        series.samples = run.passImagesPerSecond();
+        baseline.series.push_back(std::move(series));
+    }
+    // Per-image latency only where threads do not compete for the CPU
+    if (!runs.empty()) {
+        for (const auto& image : runs.front().imageMs) {
+            if (image.second.empty()) continue;
+            BenchSeries series;
+            series.name = "latency/" + image.first;
+            series.unit = "ms";
+            series.samples = image.second;
+            baseline.series.push_back(std::move(series));
+        }
+        baseline.stageAllocs = runs.front().stageAllocs;
+    }
+    return baseline;
+}
+
+void saveBaseline(const BenchBaseline& baseline, const std::string& path) {
+    const BenchOptions& o = baseline.options;
+    std::string text = "{\n  \"format\": \"png2svg-bench\",\n  \"formatVersion\": " +
+                       std::to_string(BenchBaseline::kFormatVersion) + ",\n  \"converterVersion\": ";
+    appendJsonString(text, baseline.converterVersion);
+    text += ",\n  \"created\": ";
+    appendJsonString(text, baseline.created);
+    text += ",\n  \"host\": ";
+    appendJsonString(text, baseline.host);
+    text += ",\n  \"hardwareThreads\": " + std::to_string(baseline.hardwareThreads);
+    text += ",\n  \"corpus\": ";
+    appendJsonString(text, o.corpus);
+    text += ",\n  \"warmup\": " + std::to_string(o.warmup);
+    text += ",\n  \"iterations\": " + std::to_string(o.iterations);
+    text += ",\n  \"option\": " + std::to_string(o.optionIndex);
+    text += ",\n  \"threads\": [";
+    for (size_t i = 0; i < o.threads.size(); ++i) {
+        text += (i ? ", " : "") + std::to_string(o.threads[i]);
+    }
+    text += "],\n  \"series\": [";
+    for (size_t i = 0; i < baseline.series.size(); ++i) {
+        const BenchSeries& s = baseline.series[i];
+        text += i ? ",\n    {\"name\": " : "\n    {\"name\": ";
+        appendJsonString(text, s.name);
+        text += ", \"unit\": ";
+        appendJsonString(text, s.unit);
+        text += std::string(", \"higherIsBetter\": ") + (s.higherIsBetter ? "true" : "false");
+        text += ", \"samples\": [";
+        for (size_t j = 0; j < s.samples.size(); ++j) {
+            text += (j ? ", " : "") + formatNumber(s.samples[j]);
+        }
+        text += "]}";
+    }
+    text += "\n  ]";
+    if (!baseline.stageAllocs.empty()) {
+        text += ",\n  \"stageAllocs\": [";
+        for (size_t i = 0; i < baseline.stageAllocs.size(); ++i) {
+            text += i ? ",\n    {\"stage\": " : "\n    {\"stage\": ";
+            appendJsonString(text, baseline.stageAllocs[i].first);
+            text += ", ";
+            appendCounters(text, baseline.stageAllocs[i].second);
+            text += "}";
+        }
+        text += "\n  ]";
+    }
+    text += "\n}\n";
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << text;
+    out.flush();
+    if (!out) {
+        throw std::runtime_error("Failed to write baseline: " + path);
+    }
+}
+
+BenchBaseline loadBaseline(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open baseline: " + path);
+    }
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    JsonValue root;
+    try {
+        root = JsonParser(text).parse();
+    } catch (const std::exception& e) {
+        throw std::runtime_error(path + ": " + e.what());
+    }
+    if (root.type != JsonValue::Object ||
+        member(root, "format", JsonValue::String).string != "png2svg-bench") {
+        throw std::runtime_error(path + ": not a png2svg benchmark baseline");
+    }
+    int version = static_cast<int>(member(root, "formatVersion", JsonValue::Number).number);
+    if (version > BenchBaseline::kFormatVersion) {
+        throw std::runtime_error(path + ": baseline format " + std::to_string(version) +
+                                 " is newer than this converter supports");
+    }
+
+    BenchBaseline baseline;
+    baseline.converterVersion = member(root, "converterVersion", JsonValue::String).string;
+    baseline.created = member(root, "created", JsonValue::String).string;
+    baseline.host = member(root, "host", JsonValue::String).string;
+    baseline.hardwareThreads = static_cast<int>(member(root, "hardwareThreads", JsonValue::Number).number);
+    baseline.options.corpus = member(root, "corpus", JsonValue::String).string;
+    baseline.options.warmup = static_cast<int>(member(root, "warmup", JsonValue::Number).number);
+    baseline.options.iterations = static_cast<int>(member(root, "iterations", JsonValue::Number).number);
+    baseline.options.optionIndex = static_cast<int>(member(root, "option", JsonValue::Number).number);
+    for (const JsonValue& t : member(root, "threads", JsonValue::Array).array) {
+        baseline.options.threads.push_back(static_cast<int>(t.number));
+    }
+    for (const JsonValue& s : member(root, "series", JsonValue::Array).array) {
+        BenchSeries series;
+        series.name = member(s, "name", JsonValue::String).string;
+        series.unit = member(s, "unit", JsonValue::String).string;
+        series.higherIsBetter = member(s, "higherIsBetter", JsonValue::Bool).boolean;
+        for (const JsonValue& v : member(s, "samples", JsonValue::Array).array) {
+            series.samples.push_back(v.number);
+        }
+        baseline.series.push_back(std::move(series));
+    }
+    // Written by profiling builds only
+    if (const JsonValue* stages = root.find("stageAllocs")) {
+        for (const JsonValue& s : stages->array) {
+            AllocCounters counters;
+            counters.allocations = static_cast<uint64_t>(member(s, "allocations", JsonValue::Number).number);
+            counters.bytes = static_cast<uint64_t>(member(s, "bytes", JsonValue::Number).number);
+            counters.copies = static_cast<uint64_t>(member(s, "copies", JsonValue::Number).number);
+            counters.copyBytes = static_cast<uint64_t>(member(s, "copyBytes", JsonValue::Number).number);
+            baseline.stageAllocs.emplace_back(member(s, "stage", JsonValue::String).string, counters);
+        }
+    }
+    return baseline;
+}
+
+int compareBaselines(const BenchBaseline& baseline, const BenchBaseline& current,
+                     double thresholdPercent, std::ostream& out) {
+    out << "与基线比较: 转换器 " << baseline.converterVersion << " (" << baseline.created;
+    if (!baseline.host.empty()) out << ", " << baseline.host;
+    out << ") -> " << current.converterVersion << std::endl;
+
+    // Differences that make the numbers less comparable
+    if (baseline.options.corpus != current.options.corpus) {
+        out << "  注意: 图片集不同 (" << baseline.options.corpus << " -> " << current.options.corpus << ")"
+            << std::endl;
+    }
+    if (baseline.hardwareThreads != current.hardwareThreads || baseline.host != current.host) {
+        out << "  注意: 主机不同 (" << baseline.hardwareThreads << " -> " << current.hardwareThreads
+            << " 个硬件线程)" << std::endl;
+    }
+    if (baseline.options.optionIndex != current.options.optionIndex) {
+        out << "  注意: 矢量化选项不同 (" << baseline.options.optionIndex << " -> "
+            << current.options.optionIndex << ")" << std::endl;
+    }
+
+    char line[240];
+    std::snprintf(line, sizeof(line), "  %-36s %12s %12s %9s %21s  %s", "benchmark", "baseline", "current",
+                  "change", "95% CI", "");
+    out << line << std::endl;
+
+    std::vector<Comparison> rows;
+    int untested = 0;
+    int missing = 0;
+    for (const BenchSeries& now : current.series) {
+        auto it = std::find_if(baseline.series.begin(), baseline.series.end(),
+                               [&](const BenchSeries& s) { return s.name == now.name; });
+        if (it == baseline.series.end()) {
+            continue;
+        }
+        Comparison row;
+        row.series = &now;
+        row.baseline = summarize(it->samples);
+        row.current = summarize(now.samples);
+        const Summary& b = row.baseline;
+        const Summary& c = row.current;
+        if (b.n == 0 || c.n == 0 || b.mean <= 0) {
+            continue;
+        }
+        // Welch's t-test: interval for the difference of the means, scaled
+        // to the baseline mean
+        row.change = (c.mean - b.mean) / b.mean;
+        if (b.n > 1 && c.n > 1) {
+            double vb = b.variance / b.n, vc = c.variance / c.n;
+            double se = std::sqrt(vb + vc);
+            double df = vb + vc > 0
+                ? (vb + vc) * (vb + vc) / (vb * vb / (b.n - 1) + vc * vc / (c.n - 1))
+                : static_cast<double>(b.n + c.n - 2);
+            double margin = tCritical95(df) * se / b.mean;
+            double low = row.change - margin, high = row.change + margin;
+            row.interval = "[" + formatPercent(low) + ", " + formatPercent(high) + "]";
+            // Slower means less throughput, or more time
+            double slowLow = now.higherIsBetter ? -high : low;
+            double slowHigh = now.higherIsBetter ? -low : high;
+            double slowdown = now.higherIsBetter ? -row.change : row.change;
+            double slowerBy = now.higherIsBetter ? b.mean - c.mean : c.mean - b.mean;
+            row.tested = true;
+            if (se > 0) {
+                row.pSlower = tUpperTail(slowerBy / se, df);
+            } else {
+                row.pSlower = slowerBy > 0 ? 0 : 1;
+            }
+            row.slower = slowLow > 0 && slowdown * 100 >= thresholdPercent;
+            row.faster = slowHigh < 0 && -slowdown * 100 >= thresholdPercent;
+        } else {
+            untested++;
+        }
+        rows.push_back(std::move(row));
+    }
+    for (const BenchSeries& old : baseline.series) {
+        bool found = std::any_of(current.series.begin(), current.series.end(),
+                                 [&](const BenchSeries& s) { return s.name == old.name; });
+        if (!found) missing++;
+    }
+
+    // Holm-Bonferroni over the latency family at a one-sided 2.5%, the slow
+    // side of the 95% interval: the k-th smallest p-value of m must be at
+    // most 0.025 / (m - k), and the first that is not ends the rejections
+    std::vector<Comparison*> family;
+    for (Comparison& row : rows) {
+        if (row.tested && inLatencyFamily(*row.series)) family.push_back(&row);
+    }
+    std::stable_sort(family.begin(), family.end(),
+                     [](const Comparison* a, const Comparison* b) { return a->pSlower < b->pSlower; });
+    std::vector<const Comparison*> holmRejected;
+    for (size_t k = 0; k < family.size(); ++k) {
+        if (family[k]->pSlower > 0.025 / (family.size() - k)) break;
+        holmRejected.push_back(family[k]);
+    }
+
+    int regressions = 0;
+    int slowerLatencies = 0;
+    for (const Comparison& row : rows) {
+        const char* verdict = "";
+        if (row.slower) {
+            bool gates = !inLatencyFamily(*row.series) ||
+                         std::find(holmRejected.begin(), holmRejected.end(), &row) != holmRejected.end();
+            if (gates) {
+                verdict = "变慢";
+                regressions++;
+            } else {
+                verdict = "变慢（校正后不显著）";
+                slowerLatencies++;
+            }
+        } else if (row.faster) {
+            verdict = "变快";
+        }
+        std::snprintf(line, sizeof(line), "  %-36s %12.3f %12.3f %9s %21s  %s", row.series->name.c_str(),
+                      row.baseline.mean, row.current.mean, formatPercent(row.change).c_str(),
+                      row.interval.c_str(), verdict);
+        out << line << std::endl;
+    }
+
+    // Allocation counts of profiling builds do not vary between runs of the
+    // same corpus and settings, so any increase is a regression
+    if (!baseline.stageAllocs.empty() && !current.stageAllocs.empty()) {
+        if (baseline.options.corpus != current.options.corpus ||
+            baseline.options.iterations != current.options.iterations ||
+            baseline.options.optionIndex != current.options.optionIndex ||
+            baseline.options.threads.empty() || current.options.threads.empty() ||
+            baseline.options.threads.front() != current.options.threads.front()) {
+            out << "  注意: 图片集、迭代次数、选项或首个线程数不同，不比较分配计数" << std::endl;
+        } else {
+            static const struct {
+                const char* name;
+                uint64_t AllocCounters::*field;
+            } fields[] = {{"allocations", &AllocCounters::allocations},
+                          {"bytes", &AllocCounters::bytes},
+                          {"copies", &AllocCounters::copies},
+                          {"copyBytes", &AllocCounters::copyBytes}};
+            for (const auto& stage : current.stageAllocs) {
+                AllocCounters before;
+                for (const auto& old : baseline.stageAllocs) {
+                    if (old.first == stage.first) before = old.second;
+                }
+                for (const auto& f : fields) {
+                    uint64_t b = before.*f.field, c = stage.second.*f.field;
+                    if (b == c) continue;
+                    std::string name = "allocs/" + stage.first + "/" + f.name;
+                    std::snprintf(line, sizeof(line), "  %-36s %12llu %12llu %9s %21s  %s", name.c_str(),
+                                  static_cast<unsigned long long>(b), static_cast<unsigned long long>(c),
+                                  b > 0 ? formatPercent((static_cast<double>(c) - b) / b).c_str() : "-", "",
+                                  c > b ? "增加" : "减少");
+                    out << line << std::endl;
+                    if (c > b) regressions++;
+                }
+            }
+        }
+    }
+
+    if (untested > 0) {
+        out << "  注意: " << untested << " 项样本不足2个，无法计算置信区间（需要 --iterations 2 以上）" << std::endl;
+    }
+    if (missing > 0) {
+        out << "  注意: 基线中有 " << missing << " 项在本次运行中没有结果" << std::endl;
+    }
+    if (slowerLatencies > 0) {
+        out << "  注意: " << slowerLatencies << " 张图片的延迟单独检验变慢，但经 " << family.size()
+            << " 张图片的Holm-Bonferroni校正后不显著，不计为回归" << std::endl;
+    }
+    if (regressions > 0) {
+        out << "发现 " << regressions << " 项回归（吞吐量与校正后的单图延迟：95%置信水平下显著变慢且幅度 >= "
+            << thresholdPercent << "%；分配计数：任何增加）" << std::endl;
+    } else {
+        out << "没有显著变慢（阈值 " << thresholdPercent << "%）" << std::endl;
+    }
+    return regressions;
+}
@@ -0,0 +1,222 @@
+#include "buffer_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+constexpr size_t kPageSize = 4096;
+constexpr size_t kHugePageSize = size_t(2) << 20;
+
+std::atomic<bool> gHugePages{false};
+std::atomic<size_t> gCacheLimit{size_t(512) << 20};
+std::atomic<uint64_t> gCacheHits{0};
+std::atomic<uint64_t> gCacheMisses{0};
+
+// Fresh page-aligned memory from the OS
+void* osAllocate(size_t bytes) {
+#ifdef _WIN32
+    return _aligned_malloc(bytes, kPageSize);
+#else
+    bool huge = gHugePages.load(std::memory_order_relaxed) && bytes >= kHugePageSize;
+    if (!huge) {
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    // Over-map and trim so the buffer starts on a huge page boundary
+    size_t span = bytes + kHugePageSize;
+    void* raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return nullptr;
+    uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (start + kHugePageSize - 1) & ~(kHugePageSize - 1);
+    if (aligned > start) {
+        munmap(raw, aligned - start);
+    }
+    size_t tail = (start + span) - (aligned + bytes);
+    if (tail > 0) {
+        munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(reinterpret_cast<void*>(aligned), bytes, MADV_HUGEPAGE);
+#endif
+    return reinterpret_cast<void*>(aligned);
+#endif
+}
+
+void osRelease(void* p, size_t bytes) {
+#ifdef _WIN32
+    (void)bytes;
+    _aligned_free(p);
+#else
+    munmap(p, bytes);
+#endif
+}
+
+int floorLog2(size_t v) {
+    int k = 0;
+    while (v >>= 1) ++k;
+    return k;
+}
+
+size_t pageRound(size_t bytes) {
+    return (bytes + kPageSize - 1) & ~(kPageSize - 1);
+}
+
+} // namespace
+
+PooledBuffer::~PooledBuffer() {
+    reset();
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept
+    : data_(other.data_), size_(other.size_), capacity_(other.capacity_) {
+    other.data_ = nullptr;
+    other.size_ = other.capacity_ = 0;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept {
+    if (this != &other) {
+        reset();
+        data_ = other.data_;
+        size_ = other.size_;
+        capacity_ = other.capacity_;
+        other.data_ = nullptr;
+        other.size_ = other.capacity_ = 0;
+    }
+    return *this;
+}
+
+void PooledBuffer::reset() {
+    if (data_) {
+        // Buffers are interchangeable, so they go to whichever thread frees them
+        BufferPool::local().release(data_, capacity_);
+        data_ = nullptr;
+        size_ = capacity_ = 0;
+    }
+}
+
+BufferPool::BufferPool() = default;
+
+BufferPool::~BufferPool() {
+    trim();
+}
+
+BufferPool& BufferPool::local() {
+    thread_local BufferPool pool;
+    return pool;
+}
+
+int BufferPool::classIndex(size_t bytes) {
+    if (bytes <= kMinBuffer) {
+        return 0;
+    }
+    int k = floorLog2(bytes - 1);
+    size_t step = size_t(1) << (k - 2);
+    int m = static_cast<int>((bytes + step - 1) / step);
+    int index = 1 + (k - 16) * 4 + (m - 5);
+    return index < kClassCount ? index : -1;
+}
+
+size_t BufferPool::classSize(int index) {
+    if (index == 0) {
+        return kMinBuffer;
+    }
+    int k = 16 + (index - 1) / 4;
+    size_t m = 5 + (index - 1) % 4;
+    return m << (k - 2);
+}
+
+size_t BufferPool::roundUp(size_t bytes) {
+    int index = classIndex(bytes);
+    return index < 0 ? pageRound(bytes) : classSize(index);
+}
+
+PooledBuffer BufferPool::acquire(size_t bytes) {
+    size_t capacity = roundUp(bytes);
+    return PooledBuffer(static_cast<uint8_t*>(allocate(bytes)), bytes, capacity);
+}
+
+void* BufferPool::allocate(size_t bytes) {
+    int index = classIndex(bytes);
+    lentBytes_ += roundUp(bytes);
+    peakLentBytes_ = std::max(peakLentBytes_, lentBytes_);
+    if (index >= 0 && !freeLists_[index].empty()) {
+        void* p = freeLists_[index].back();
+        freeLists_[index].pop_back();
+        cachedBytes_ -= classSize(index);
+        gCacheHits.fetch_add(1, std::memory_order_relaxed);
+        return p;
+    }
+
+    gCacheMisses.fetch_add(1, std::memory_order_relaxed);
+    void* p = osAllocate(roundUp(bytes));
+    if (!p) {
+        lentBytes_ -= roundUp(bytes);
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void BufferPool::release(void* p, size_t bytes) {
+    if (!p) return;
+    int index = classIndex(bytes);
+    size_t capacity = roundUp(bytes);
+    // Buffers may come back to a different thread's pool
+    lentBytes_ -= std::min(lentBytes_, capacity);
+    if (index < 0 || cachedBytes_ + capacity > gCacheLimit.load(std::memory_order_relaxed)) {
+        osRelease(p, capacity);
+        return;
+    }
+    freeLists_[index].push_back(p);
+    cachedBytes_ += capacity;
+}
+
+void BufferPool::trim() {
+    for (int i = 0; i < kClassCount; ++i) {
+        for (void* p : freeLists_[i]) {
+            osRelease(p, classSize(i));
+        }
+        freeLists_[i].clear();
+    }
+    cachedBytes_ = 0;
+}
+
+void BufferPool::resetPeak() {
+    peakLentBytes_ = lentBytes_;
+}
+
+void BufferPool::setHugePages(bool enabled) {
+    gHugePages.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t BufferPool::cacheHits() {
+    return gCacheHits.load(std::memory_order_relaxed);
+}
+
+uint64_t BufferPool::cacheMisses() {
+    return gCacheMisses.load(std::memory_order_relaxed);
+}
+
+void BufferPool::setCacheLimit(size_t bytes) {
+    gCacheLimit.store(bytes, std::memory_order_relaxed);
+}
+
+void* BufferPool::PoolResource::do_allocate(size_t bytes, size_t) {
+    // Pool buffers are page aligned, which covers any alignment pmr asks for
+    return pool_.allocate(bytes);
+}
+
+void BufferPool::PoolResource::do_deallocate(void* p, size_t bytes, size_t) {
+    BufferPool::local().release(p, bytes);
+}
+
+bool BufferPool::PoolResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return dynamic_cast<const PoolResource*>(&other) != nullptr;
+}
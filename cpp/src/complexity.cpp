@@ -0,0 +1,157 @@
+#include "complexity.h"
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+ComplexityLimits gLimits;
+
+size_t popcount(uint8_t byte) {
+    return std::bitset<8>(byte).count();
+}
+
+// Rows needed before counts are projected to the whole bitmap; a handful of
+// rows says little about the rest, so until then the raw counts are used
+constexpr int kMinProjectedRows = 32;
+
+// Scale a count from the rows seen so far to the whole bitmap
+size_t extrapolate(size_t count, int rows, int height) {
+    if (rows < std::min(height, std::max(kMinProjectedRows, height / 16)) || rows >= height) {
+        return count;
+    }
+    return static_cast<size_t>(static_cast<double>(count) * height / rows);
+}
+
+} // namespace
+
+void ComplexityGuard::configure(const ComplexityLimits& limits) {
+    gLimits = limits;
+}
+
+const ComplexityLimits& ComplexityGuard::limits() {
+    return gLimits;
+}
+
+bool ComplexityGuard::parseFallback(const char* text, ComplexityFallback& fallback) {
+    if (std::strcmp(text, "preview") == 0) {
+        fallback = ComplexityFallback::Preview;
+    } else if (std::strcmp(text, "raster") == 0) {
+        fallback = ComplexityFallback::Raster;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void ComplexityMeter::begin(int width, int height) {
+    width_ = width;
+    height_ = height;
+    rows_ = 0;
+    packedBytes_ = (static_cast<size_t>(width) + 7) / 8;
+    edges_ = 0;
+    components_ = 0;
+    previous_.assign(packedBytes_, 0);   // white above the first row
+    previousRuns_.clear();
+    parent_.clear();
+}
+
+int ComplexityMeter::find(int label) {
+    while (parent_[label] != label) {
+        parent_[label] = parent_[parent_[label]];
+        label = parent_[label];
+    }
+    return label;
+}
+
+void ComplexityMeter::addRow(const uint8_t* packed) {
+    // Vertical boundaries with the row above
+    for (size_t i = 0; i < packedBytes_; ++i) {
+        edges_ += popcount(packed[i] ^ previous_[i]);
+    }
+
+    // Black runs; whole white or black bytes are skipped without bit tests
+    runs_.clear();
+    bool inRun = false;
+    int start = 0;
+    for (size_t i = 0; i < packedBytes_; ++i) {
+        uint8_t byte = packed[i];
+        if ((byte == 0x00 && !inRun) || (byte == 0xFF && inRun)) {
+            continue;
+        }
+        for (int bit = 0; bit < 8; ++bit) {
+            bool black = (byte >> (7 - bit)) & 1;
+            int x = static_cast<int>(i * 8) + bit;
+            if (black && !inRun) {
+                inRun = true;
+                start = x;
+            } else if (!black && inRun) {
+                inRun = false;
+                runs_.push_back({start, x, -1});
+            }
+        }
+    }
+    if (inRun) {
+        runs_.push_back({start, width_, -1});
+    }
+    edges_ += 2 * runs_.size();   // left and right end of each run
+
+    // Join each run to the components of the runs it touches above; a run
+    // touching two different components merges them
+    size_t above = 0;
+    for (Run& run : runs_) {
+        while (above < previousRuns_.size() && previousRuns_[above].end <= run.start) {
+            ++above;
+        }
+        for (size_t k = above; k < previousRuns_.size() && previousRuns_[k].start < run.end; ++k) {
+            int component = find(previousRuns_[k].label);
+            if (run.label < 0) {
+                run.label = component;
+            } else {
+                int joined = find(run.label);
+                if (joined != component) {
+                    parent_[component] = joined;
+                    components_--;
+                }
+            }
+        }
+        if (run.label < 0) {
+            run.label = static_cast<int>(parent_.size());
+            parent_.push_back(run.label);
+            components_++;
+        }
+    }
+
+    // Renumber the surviving components 0..n-1 for the next row; components
+    // that did not reach this row are finished and forgotten
+    remap_.assign(parent_.size(), -1);
+    int labels = 0;
+    for (Run& run : runs_) {
+        int root = find(run.label);
+        if (remap_[root] < 0) {
+            remap_[root] = labels++;
+        }
+        run.label = remap_[root];
+    }
+    parent_.resize(labels);
+    std::iota(parent_.begin(), parent_.end(), 0);
+    previousRuns_.swap(runs_);
+    std::memcpy(previous_.data(), packed, packedBytes_);
+
+    if (++rows_ == height_) {
+        // Bottom boundary against white below the last row
+        for (size_t i = 0; i < packedBytes_; ++i) {
+            edges_ += popcount(packed[i]);
+        }
+    }
+}
+
+void ComplexityMeter::check(const ComplexityLimits& limits) const {
+    size_t edges = extrapolate(edges_, rows_, height_);
+    size_t components = extrapolate(components_, rows_, height_);
+    if ((limits.maxEdges > 0 && edges > limits.maxEdges) ||
+        (limits.maxComponents > 0 && components > limits.maxComponents)) {
+        throw ComplexityExceeded(edges, components);
+    }
+}
@@ -0,0 +1,307 @@
+#include "logger.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+struct Record {
+    LogLevel level = LogLevel::Info;
+    const char* event = "";
+    std::string message;
+    std::vector<std::pair<std::string, std::string>> fields;
+    std::chrono::system_clock::time_point time;
+    int thread = 0;
+};
+
+// Bounded multi-producer queue after Dmitry Vyukov: each slot carries a
+// sequence number that tells producers and the consumer whose turn it is
+class RecordRing {
+public:
+    explicit RecordRing(size_t capacity)
+        : slots_(new Slot[capacity]), mask_(capacity - 1) {
+        for (size_t i = 0; i < capacity; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(Record& record) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots_[pos & mask_];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.record = std::move(record);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;   // full
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Single consumer
+    bool pop(Record& record) {
+        Slot& slot = slots_[head_ & mask_];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != head_ + 1) {
+            return false;   // empty
+        }
+        record = std::move(slot.record);
+        slot.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+        ++head_;
+        return true;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) size_t head_ = 0;
+};
+
+const char* levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug: return "debug";
+        case LogLevel::Info: return "info";
+        case LogLevel::Warn: return "warn";
+        case LogLevel::Error: return "error";
+    }
+    return "info";
+}
+
+void appendJsonString(std::string& out, const std::string& value) {
+    out += '"';
+    for (unsigned char c : value) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += '"';
+}
+
+std::string formatTime(std::chrono::system_clock::time_point time) {
+    std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() % 1000;
+    std::tm utc{};
+#ifdef _WIN32
+    gmtime_s(&utc, &seconds);
+#else
+    gmtime_r(&seconds, &utc);
+#endif
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+                  utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday,
+                  utc.tm_hour, utc.tm_min, utc.tm_sec, static_cast<int>(millis));
+    return buffer;
+}
+
+int threadIndex() {
+    static std::atomic<int> next{0};
+    thread_local int index = next.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+class LogWriter {
+public:
+    static LogWriter& instance() {
+        static LogWriter writer;
+        return writer;
+    }
+
+    std::atomic<int> level{static_cast<int>(LogLevel::Info)};
+    std::atomic<int> format{static_cast<int>(LogFormat::Text)};
+    std::atomic<bool> stdoutReserved{false};
+
+    void push(Record record) {
+        while (!ring_.push(record)) {
+            wake();
+            std::this_thread::yield();
+        }
+        // Sequentially consistent with the consumer's sleeping_/pushed_ pair
+        pushed_.fetch_add(1);
+        if (sleeping_.load()) {
+            wake();
+        }
+    }
+
+    void flush() {
+        uint64_t target = pushed_.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> lock(mutex_);
+        wakeup_.notify_one();
+        drained_.wait(lock, [&] { return written_ >= target; });
+    }
+
+private:
+    LogWriter() : ring_(4096) {
+        thread_ = std::thread([this] { run(); });
+    }
+
+    // Drains what is left when the program exits
+    ~LogWriter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wakeup_.notify_one();
+        thread_.join();
+    }
+
+    void wake() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wakeup_.notify_one();
+    }
+
+    void run() {
+        Record record;
+        uint64_t written = 0;
+        for (;;) {
+            bool any = false;
+            while (ring_.pop(record)) {
+                write(record);
+                ++written;
+                any = true;
+            }
+            if (any) {
+                std::fflush(stdout);
+                std::fflush(stderr);
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            written_ = written;
+            drained_.notify_all();
+            if (stopping_ && pushed_.load(std::memory_order_acquire) == written) {
+                return;
+            }
+            // Producers only take the lock to wake us while we sleep
+            sleeping_.store(true);
+            if (pushed_.load() == written && !stopping_) {
+                wakeup_.wait_for(lock, std::chrono::milliseconds(20));
+            }
+            sleeping_.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    void write(const Record& record) {
+        bool json = static_cast<LogFormat>(format.load(std::memory_order_relaxed)) == LogFormat::Json;
+        if (json && record.event[0] == '\0') {
+            return;
+        }
+        bool toStdout = record.level <= LogLevel::Info && !stdoutReserved.load(std::memory_order_relaxed);
+        FILE* stream = toStdout ? stdout : stderr;
+        std::string line;
+        if (json) {
+            line = "{\"time\":\"" + formatTime(record.time) + "\",\"level\":\"" + levelName(record.level) +
+                   "\",\"thread\":" + std::to_string(record.thread) + ",\"event\":";
+            appendJsonString(line, record.event);
+            line += ",\"message\":";
+            // The human text keeps its indentation for the terminal only
+            size_t start = record.message.find_first_not_of(' ');
+            appendJsonString(line, start == std::string::npos ? std::string() : record.message.substr(start));
+            for (const auto& field : record.fields) {
+                line += ',';
+                appendJsonString(line, field.first);
+                line += ':';
+                appendJsonString(line, field.second);
+            }
+            line += "}\n";
+        } else {
+            line = record.message + "\n";
+        }
+        std::fwrite(line.data(), 1, line.size(), stream);
+    }
+
+    RecordRing ring_;
+    std::atomic<uint64_t> pushed_{0};
+    std::atomic<bool> sleeping_{false};
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::condition_variable drained_;
+    uint64_t written_ = 0;   // guarded by mutex_
+    bool stopping_ = false;  // guarded by mutex_
+    std::thread thread_;
+};
+
+} // namespace
+
+void Logger::setLevel(LogLevel level) {
+    LogWriter::instance().level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+void Logger::setFormat(LogFormat format) {
+    LogWriter::instance().format.store(static_cast<int>(format), std::memory_order_relaxed);
+}
+
+void Logger::setStdoutReserved(bool reserved) {
+    LogWriter::instance().stdoutReserved.store(reserved, std::memory_order_relaxed);
+}
+
+bool Logger::enabled(LogLevel level) {
+    return static_cast<int>(level) >= LogWriter::instance().level.load(std::memory_order_relaxed);
+}
+
+bool Logger::parseLevel(const std::string& text, LogLevel& level) {
+    static const std::pair<const char*, LogLevel> names[] = {
+        {"debug", LogLevel::Debug}, {"info", LogLevel::Info},
+        {"warn", LogLevel::Warn}, {"error", LogLevel::Error}};
+    for (const auto& name : names) {
+        if (text == name.first) {
+            level = name.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Logger::parseFormat(const std::string& text, LogFormat& format) {
+    if (text == "text") {
+        format = LogFormat::Text;
+    } else if (text == "json") {
+        format = LogFormat::Json;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void Logger::submit(LogLevel level, const char* event, std::string message,
+                    std::vector<std::pair<std::string, std::string>> fields) {
+    Record record;
+    record.level = level;
+    record.event = event;
+    record.message = std::move(message);
+    record.fields = std::move(fields);
+    record.time = std::chrono::system_clock::now();
+    record.thread = threadIndex();
+    LogWriter::instance().push(std::move(record));
+}
+
+void Logger::flush() {
+    LogWriter::instance().flush();
+}
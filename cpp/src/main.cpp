@@ -4,21 +4,117 @@
 #include <filesystem>
 #include <algorithm>
 #include <iomanip>
+#include <fstream>
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <unordered_map>
 #include "vectorizer.h"
+#include "animation.h"
+#include "bench.h"
+#include "soak.h"
+#include "buffer_pool.h"
+#include "complexity.h"
+#include "scratch_space.h"
+#include "batch_io.h"
+#include "tar_stream.h"
+#include "manifest.h"
+#include "trace_log.h"
+#include "alloc_profile.h"
+#include "metrics.h"
+#include "logger.h"
 
 namespace fs = std::filesystem;
 
-// Process a single PNG file and convert it to SVG
-bool processSingleFile(const fs::path& pngPath, bool autoSelect = true, 
-                       int optionIndex = 0, bool quiet = false) {
+// How directory mode handles inputs with identical contents
+enum class DedupMode {
+    Off,    // convert every copy
+    Copy,   // convert once, copy the SVG for the others
+    Link    // convert once, hard-link the SVG for the others
+};
+
+// Settings shared by the directory and archive batch modes
+struct BatchOptions {
+    bool autoSelect = true;
+    int optionIndex = 0;
+    int jobs = 1;                         // parallel conversions (archive mode, GIF frames)
+    bool sync = false;                    // fsync outputs before publishing
+    DedupMode dedup = DedupMode::Copy;    // identical inputs (directory mode)
+    int tileSize = 256;                   // tiled traces (watch mode, GIF frames)
+    AnimationOutput gifOutput = AnimationOutput::Smil;
+    ManifestWriter* manifest = nullptr;   // per-input results, when requested
+};
+
+// Record a finished input in the metrics and, if requested, the manifest
+void recordResult(const BatchOptions& batch, const ManifestEntry& entry) {
+    Metrics::fileDone(entry.error.empty(), entry.inputBytes, entry.stats.outputBytes, entry.wallMs);
+    if (batch.manifest) {
+        batch.manifest->write(entry);
+    }
+}
+
+// Pick one of the inspected options, automatically or by asking the user;
+// returns its index
+int selectOption(const std::vector<VectorizationOption>& options,
+                 bool autoSelect, int optionIndex) {
+    if (autoSelect) {
+        return std::max(0, std::min(optionIndex, static_cast<int>(options.size() - 1)));
+    }
     
+    // Interactive selection; progress logged so far goes out first
+    Logger::flush();
+    std::cout << "  可用选项:" << std::endl;
+    for (size_t i = 0; i < options.size(); ++i) {
+        std::cout << "    " << i << ": Step=" << options[i].step 
+                 << ", Colors=";
+        for (const auto& color : options[i].colors) {
+            std::cout << color << " ";
+        }
+        std::cout << std::endl;
+    }
+    
+    int choice;
+    while (true) {
+        std::cout << "  选择选项 (0-" << options.size() - 1 << "): ";
+        std::cin >> choice;
+        
+        if (std::cin.good() && choice >= 0 && choice < static_cast<int>(options.size())) {
+            return choice;
+        }
+        std::cout << "  请输入 0 到 " << options.size() - 1 
+                 << " 之间的数字" << std::endl;
+        std::cin.clear();
+        std::cin.ignore(10000, '\n');
+    }
+}
+
+// Read a whole input file; throws std::runtime_error if it cannot be read
+std::vector<uint8_t> readInput(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (!in && !in.eof()) {
+        throw std::runtime_error("Failed to read " + path.string());
+    }
+    return bytes;
+}
+
+// Process a single PNG file and convert it to SVG next to it. The PNG is
+// converted in memory and the SVG published atomically, so nothing is
+// written to the working directory.
+bool processSingleFile(const fs::path& pngPath, const BatchOptions& batch) {
     if (!fs::exists(pngPath)) {
-        std::cerr << "错误: 文件不存在 - " << pngPath << std::endl;
+        logError("input_missing").field("input", pngPath.string()) << "错误: 文件不存在 - " << pngPath;
         return false;
     }
     
     if (pngPath.extension() != ".png" && pngPath.extension() != ".PNG") {
-        std::cerr << "错误: 不是PNG文件 - " << pngPath << std::endl;
+        logError("input_not_png").field("input", pngPath.string()) << "错误: 不是PNG文件 - " << pngPath;
         return false;
     }
     
@@ -26,103 +122,130 @@ bool processSingleFile(const fs::path& pngPath, bool autoSelect = true,
     fs::path svgPath = pngPath;
     svgPath.replace_extension(".svg");
     
-    // Get image name without extension
-    std::string imageName = pngPath.stem().string();
-    
-    if (!quiet) {
-        std::cout << "处理: " << pngPath << std::endl;
-    }
+    logInfo("file_start").field("input", pngPath.string()) << "处理: " << pngPath;
     
     try {
-        // Create temporary working directory link
-        fs::path tempPng = "./" + imageName + ".png";
-        fs::path tempSvg = "./" + imageName + ".svg";
-        
-        // Copy file to working directory if needed
-        if (!fs::exists(tempPng) || !fs::equivalent(tempPng, pngPath)) {
-            fs::copy_file(pngPath, tempPng, fs::copy_options::overwrite_existing);
-        }
+        std::vector<uint8_t> bytes = readInput(pngPath);
+        Vectorizer vectorizer;
         
         // Get vectorization options
-        std::vector<VectorizationOption> options = inspectImage(imageName);
+        std::vector<VectorizationOption> options = vectorizer.inspectImage(bytes.data(), bytes.size());
         
         if (options.empty()) {
-            std::cerr << "警告: 无法获取矢量化选项 - " << pngPath << std::endl;
+            logWarn("no_options").field("input", pngPath.string()) << "警告: 无法获取矢量化选项 - " << pngPath;
             return false;
         }
         
-        if (!quiet) {
-            std::cout << "  找到 " << options.size() << " 个矢量化选项" << std::endl;
-        }
-        
-        // Select option
-        VectorizationOption selectedOption;
-        if (autoSelect) {
-            int idx = std::min(optionIndex, static_cast<int>(options.size() - 1));
-            selectedOption = options[idx];
-        } else {
-            // Interactive selection
-            std::cout << "  可用选项:" << std::endl;
-            for (size_t i = 0; i < options.size(); ++i) {
-                std::cout << "    " << i << ": Step=" << options[i].step 
-                         << ", Colors=";
-                for (const auto& color : options[i].colors) {
-                    std::cout << color << " ";
-                }
-                std::cout << std::endl;
-            }
-            
-            int choice;
-            while (true) {
-                std::cout << "  选择选项 (0-" << options.size() - 1 << "): ";
-                std::cin >> choice;
-                
-                if (std::cin.good() && choice >= 0 && choice < options.size()) {
-                    selectedOption = options[choice];
-                    break;
-                } else {
-                    std::cout << "  请输入 0 到 " << options.size() - 1 
-                             << " 之间的数字" << std::endl;
-                    std::cin.clear();
-                    std::cin.ignore(10000, '\n');
-                }
-            }
-        }
-        
-        // Process the image
-        parseImage(imageName, selectedOption.step, selectedOption.colors);
+        logInfo("options_found").field("count", options.size())
+            << "  找到 " << options.size() << " 个矢量化选项";
         
-        // Move the generated SVG to the target location
-        if (fs::exists(tempSvg)) {
-            fs::rename(tempSvg, svgPath);
-            if (!quiet) {
-                std::cout << "  ✓ 生成: " << svgPath << std::endl;
-            }
-        }
+        // Select option and process the image
+        VectorizationOption selectedOption = options[selectOption(options, batch.autoSelect, batch.optionIndex)];
+        std::string svg = vectorizer.convertImage(bytes.data(), bytes.size(), selectedOption.step,
+                                                  selectedOption.colors);
         
-        // Clean up temporary file if it was created
-        if (fs::exists(tempPng) && !fs::equivalent(tempPng, pngPath)) {
-            fs::remove(tempPng);
+        BatchIO io(1, batch.sync);
+        io.write(svgPath.string(), std::move(svg));
+        std::vector<std::string> errors = io.flush();
+        if (!errors.empty()) {
+            throw std::runtime_error(errors.front());
         }
-        
+        logInfo("file_done").field("output", svgPath.string()) << "  ✓ 生成: " << svgPath;
         return true;
         
     } catch (const std::exception& e) {
-        std::cerr << "错误处理 " << pngPath << ": " << e.what() << std::endl;
+        logError("file_failed").field("input", pngPath.string()).field("error", e.what())
+            << "错误处理 " << pngPath << ": " << e.what();
         return false;
     }
 }
 
+// Trace an animated GIF into the SVGs to write to `outputDir`, as (path,
+// SVG) pairs, and fill in its manifest entry
+std::vector<std::pair<std::string, std::string>> convertAnimation(const std::vector<uint8_t>& bytes,
+                                                                  const std::string& stem,
+                                                                  const fs::path& outputDir,
+                                                                  const BatchOptions& batch,
+                                                                  ManifestEntry& entry) {
+    TracedAnimation animation = traceAnimation(bytes.data(), bytes.size(), batch.optionIndex,
+                                               batch.jobs, batch.tileSize);
+    entry.optionIndex = animation.optionIndex;
+    entry.option = animation.option;
+    entry.stats = animation.stats;
+    
+    std::vector<std::pair<std::string, std::string>> outputs;
+    if (batch.gifOutput == AnimationOutput::Smil) {
+        outputs.emplace_back((outputDir / (stem + ".svg")).string(), animatedSvg(animation));
+    } else {
+        for (size_t i = 0; i < animation.frames.size(); ++i) {
+            outputs.emplace_back((outputDir / frameFileName(stem, i, animation.frames.size())).string(),
+                                 std::move(animation.frames[i]));
+        }
+    }
+    entry.output = outputs.front().first;
+    entry.stats.outputBytes = 0;
+    for (const auto& output : outputs) {
+        entry.stats.outputBytes += output.second.size();
+    }
+    logInfo("animation_traced").field("frames", animation.frames.size()).field("tiles", animation.tiles)
+        .field("retraced", animation.tilesTraced)
+        << "  " << animation.frames.size() << " 帧，共享调色板 " << animation.stats.palette.size()
+        << " 色，描摹 " << animation.tilesTraced << "/" << animation.tiles << " 个图块";
+    return outputs;
+}
+
+// Convert an animated GIF file; outputs go next to it
+bool processAnimationFile(const fs::path& gifPath, const BatchOptions& batch) {
+    logInfo("file_start").field("input", gifPath.string()) << "处理: " << gifPath;
+    ManifestEntry entry;
+    entry.input = gifPath.string();
+    auto start = std::chrono::steady_clock::now();
+    BatchIO io(32, batch.sync);
+    try {
+        std::vector<uint8_t> bytes = readInput(gifPath);
+        entry.inputBytes = bytes.size();
+        auto outputs = convertAnimation(bytes, gifPath.stem().string(), gifPath.parent_path(), batch, entry);
+        for (auto& output : outputs) {
+            io.write(output.first, std::move(output.second));
+        }
+        std::vector<std::string> errors = io.flush();
+        if (!errors.empty()) {
+            throw std::runtime_error(errors.front());
+        }
+        logInfo("file_done").field("output", entry.output)
+            << "  ✓ 生成: " << entry.output << (outputs.size() > 1 ? " 等 " + std::to_string(outputs.size()) + " 个文件" : "");
+    } catch (const std::exception& e) {
+        entry.error = e.what();
+        logError("file_failed").field("input", entry.input).field("error", entry.error)
+            << "错误处理 " << gifPath << ": " << e.what();
+    }
+    entry.wallMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    recordResult(batch, entry);
+    return entry.error.empty();
+}
+
+// A converted input later inputs may duplicate: its result and its bytes,
+// kept so a hash match is confirmed without reading the file again
+struct DedupOriginal {
+    ManifestEntry entry;
+    std::vector<uint8_t> bytes;
+};
+
+// Input bytes kept for deduplication; inputs converted after the budget is
+// spent are not matched against
+constexpr size_t kDedupKeepBytes = size_t(512) << 20;
+
 // Process all PNG files in a directory
-bool processDirectory(const fs::path& dirPath, bool autoSelect = true, int optionIndex = 0) {
+bool processDirectory(const fs::path& dirPath, const BatchOptions& batch) {
     
     if (!fs::exists(dirPath)) {
-        std::cerr << "错误: 目录不存在 - " << dirPath << std::endl;
+        logError("input_missing").field("input", dirPath.string()) << "错误: 目录不存在 - " << dirPath;
         return false;
     }
     
     if (!fs::is_directory(dirPath)) {
-        std::cerr << "错误: 不是目录 - " << dirPath << std::endl;
+        logError("input_not_directory").field("input", dirPath.string()) << "错误: 不是目录 - " << dirPath;
         return false;
     }
     
@@ -132,14 +255,14 @@ bool processDirectory(const fs::path& dirPath, bool autoSelect = true, int optio
         if (entry.is_regular_file()) {
             std::string ext = entry.path().extension().string();
             std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-            if (ext == ".png") {
+            if (ext == ".png" || ext == ".gif") {
                 pngFiles.push_back(entry.path());
             }
         }
     }
     
     if (pngFiles.empty()) {
-        std::cerr << "警告: 目录中没有PNG文件 - " << dirPath << std::endl;
+        logWarn("no_inputs").field("input", dirPath.string()) << "警告: 目录中没有PNG文件 - " << dirPath;
         return false;
     }
     
@@ -147,43 +270,545 @@ bool processDirectory(const fs::path& dirPath, bool autoSelect = true, int optio
     fs::path outputDir = dirPath / "svg_output";
     fs::create_directories(outputDir);
     
-    std::cout << "找到 " << pngFiles.size() << " 个PNG文件" << std::endl;
-    std::cout << "输出目录: " << outputDir << std::endl;
-    std::cout << std::string(50, '-') << std::endl;
+    logInfo("batch_start").field("inputs", pngFiles.size()).field("output", outputDir.string())
+        << "找到 " << pngFiles.size() << " 个PNG文件";
+    logInfo("") << "输出目录: " << outputDir;
+    logSeparator();
     
     int successCount = 0;
     int failCount = 0;
     
+    // Inputs are hashed as they are read; a later input with the contents
+    // of an earlier successful one reuses its result, and its SVG is copied
+    // or linked from the original's once all writes are done
+    std::unordered_multimap<uint64_t, DedupOriginal> converted;
+    size_t keptBytes = 0;
+    std::vector<OutputCopy> duplicates;
+    std::vector<std::string> originals;   // inputs reused at least once
+    double savedMs = 0;
+    
+    // Inputs are read ahead and outputs written behind on the I/O threads,
+    // so the loop below only decodes and traces
+    BatchIO io(32, batch.sync);
+    std::vector<std::string> paths;
+    for (const auto& pngFile : pngFiles) {
+        paths.push_back(pngFile.string());
+    }
+    io.prefetch(paths);
+    
     for (size_t i = 0; i < pngFiles.size(); ++i) {
-        std::cout << "[" << (i + 1) << "/" << pngFiles.size() << "] " 
-                 << pngFiles[i].filename() << std::endl;
+        logInfo("file_start").field("input", pngFiles[i].string())
+            << "[" << (i + 1) << "/" << pngFiles.size() << "] " << pngFiles[i].filename();
+        
+        FileData input;
+        {
+            TraceSpan span("wait input");
+            input = io.nextRead();
+        }
+        std::string stem = pngFiles[i].stem().string();
+        fs::path svgFile = stem + ".svg";
+        
+        TraceSpan span("convert");
+        Metrics::setQueueDepth(static_cast<int64_t>(pngFiles.size() - i - 1));
+        ManifestEntry entry;
+        entry.input = pngFiles[i].string();
+        entry.inputBytes = input.bytes.size();
+        auto start = std::chrono::steady_clock::now();
+        
+        bool animated = input.error.empty() && isGif(input.bytes.data(), input.bytes.size());
+        if (batch.dedup != DedupMode::Off && input.error.empty() && !animated) {
+            const ManifestEntry* original = nullptr;
+            auto range = converted.equal_range(input.hash);
+            for (auto it = range.first; it != range.second && !original; ++it) {
+                if (it->second.bytes == input.bytes) {
+                    original = &it->second.entry;
+                }
+            }
+            if (original) {
+                // Same image, same option: the original's facts hold, but
+                // none of its timings were spent on this input
+                entry.output = (outputDir / svgFile).string();
+                entry.optionIndex = original->optionIndex;
+                entry.option = original->option;
+                entry.stats = original->stats;
+                entry.stats.stageMs.clear();
+                entry.stats.stageAllocs.clear();
+                entry.stats.cpuMs = 0;
+                entry.stats.potraceCpuMs = 0;
+                entry.stats.peakBytes = 0;
+                entry.duplicateOf = original->input;
+                duplicates.push_back({original->output, entry.output});
+                if (std::find(originals.begin(), originals.end(), original->input) == originals.end()) {
+                    originals.push_back(original->input);
+                }
+                savedMs += original->wallMs;
+                logInfo("file_duplicate").field("output", entry.output).field("original", original->input)
+                    << "  = 与 " << fs::path(original->input).filename() << " 内容相同，复用其结果: svg_output/" << svgFile;
+                successCount++;
+                entry.wallMs = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+                recordResult(batch, entry);
+                continue;
+            }
+        }
         
-        // Process the file
-        bool success = processSingleFile(pngFiles[i], autoSelect, optionIndex, true);
+        Vectorizer vectorizer;
         
-        if (success) {
-            // Move SVG to output directory
-            fs::path svgFile = pngFiles[i];
-            svgFile.replace_extension(".svg");
+        try {
+            if (!input.error.empty()) {
+                throw std::runtime_error(input.error);
+            }
             
-            if (fs::exists(svgFile)) {
-                fs::path targetSvg = outputDir / svgFile.filename();
-                fs::rename(svgFile, targetSvg);
-                std::cout << "  ✓ 已保存到: svg_output/" << svgFile.filename() << std::endl;
+            if (animated) {
+                auto outputs = convertAnimation(input.bytes, stem, outputDir, batch, entry);
+                for (auto& output : outputs) {
+                    io.write(output.first, std::move(output.second));
+                }
+                logInfo("file_done").field("output", entry.output)
+                    << "  ✓ 已保存到: svg_output/" << fs::path(entry.output).filename()
+                    << (outputs.size() > 1 ? " 等 " + std::to_string(outputs.size()) + " 个文件" : "");
                 successCount++;
+                entry.wallMs = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+                recordResult(batch, entry);
+                continue;
             }
-        } else {
-            std::cout << "  ✗ 转换失败" << std::endl;
+            
+            std::vector<VectorizationOption> options =
+                vectorizer.inspectImage(input.bytes.data(), input.bytes.size());
+            if (options.empty()) {
+                throw std::runtime_error("无法获取矢量化选项");
+            }
+            
+            entry.optionIndex = selectOption(options, batch.autoSelect, batch.optionIndex);
+            entry.option = options[entry.optionIndex];
+            std::string svg = vectorizer.convertImage(input.bytes.data(), input.bytes.size(),
+                                                      entry.option.step, entry.option.colors);
+            
+            entry.output = (outputDir / svgFile).string();
+            io.write(entry.output, std::move(svg));
+            logInfo("file_done").field("output", entry.output) << "  ✓ 已保存到: svg_output/" << svgFile;
+            successCount++;
+        } catch (const std::exception& e) {
+            entry.error = e.what();
+            logError("file_failed").field("input", entry.input).field("error", entry.error)
+                << "错误处理 " << pngFiles[i] << ": " << e.what();
+            logInfo("") << "  ✗ 转换失败";
             failCount++;
         }
+        
+        entry.stats = vectorizer.stats();
+        entry.wallMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        recordResult(batch, entry);
+        if (batch.dedup != DedupMode::Off && entry.error.empty() && !animated &&
+            keptBytes + input.bytes.size() <= kDedupKeepBytes) {
+            keptBytes += input.bytes.size();
+            converted.emplace(input.hash, DedupOriginal{entry, std::move(input.bytes)});
+        }
+    }
+    
+    // Writes that fail after the file was reported count as failures
+    for (const auto& error : io.flush()) {
+        logError("write_failed").field("error", error) << "错误: " << error;
+        successCount--;
+        failCount++;
+    }
+    for (const auto& error : io.copyOutputs(duplicates, batch.dedup == DedupMode::Link)) {
+        logError("copy_failed").field("error", error) << "错误: " << error;
+        successCount--;
+        failCount++;
     }
     
-    std::cout << std::string(50, '-') << std::endl;
-    std::cout << "完成: 成功 " << successCount << " 个, 失败 " << failCount << " 个" << std::endl;
+    logSeparator();
+    logInfo("batch_done").field("ok", successCount).field("failed", failCount)
+        << "完成: 成功 " << successCount << " 个, 失败 " << failCount << " 个";
+    if (!duplicates.empty()) {
+        std::ostringstream saved;
+        saved << std::fixed << std::setprecision(2) << savedMs / 1000.0;
+        logInfo("batch_dedup").field("duplicates", duplicates.size()).field("originals", originals.size())
+            .field("savedMs", savedMs)
+            << "重复输入: " << duplicates.size() << " 个（" << originals.size() << " 个不同内容），"
+            << (batch.dedup == DedupMode::Link ? "已硬链接" : "已复制") << "输出，节省约 " << saved.str() << " 秒转换时间";
+    }
     
     return true;
 }
 
+// Set by SIGINT/SIGTERM to end watch mode after the current round
+volatile std::sig_atomic_t gStopWatching = 0;
+
+extern "C" void stopWatching(int) {
+    gStopWatching = 1;
+}
+
+// A watched PNG: the state it was last converted in, and the bitmap and
+// per-tile paths of that conversion
+struct WatchedFile {
+    fs::file_time_type modified;
+    uintmax_t size = 0;
+    TileCache tiles;
+};
+
+// Convert a PNG file, or every PNG of a directory, and then keep
+// converting whatever changes until interrupted. Outputs go where the
+// one-shot modes put them. Each file keeps the bitmap and traced tiles of
+// its last conversion, so an edit retraces only the tiles it touched.
+bool watchPath(const fs::path& path, const BatchOptions& batch, double intervalSeconds) {
+    bool directory = fs::is_directory(path);
+    fs::path outputDir = directory ? path / "svg_output" : path.parent_path();
+    fs::create_directories(outputDir);
+    
+    std::signal(SIGINT, stopWatching);
+    std::signal(SIGTERM, stopWatching);
+    logInfo("watch_start").field("input", path.string()).field("output", outputDir.string())
+        << "监视: " << path << "（Ctrl+C 结束）";
+    logInfo("") << "输出目录: " << outputDir;
+    logSeparator();
+    
+    std::unordered_map<std::string, WatchedFile> watched;
+    BatchIO io(32, batch.sync);
+    int successCount = 0;
+    int failCount = 0;
+    while (!gStopWatching) {
+        auto roundStart = std::chrono::steady_clock::now();
+        
+        // Files that appeared or changed since the last round; a file
+        // still being written is picked up again once it settles
+        std::vector<fs::path> pngFiles;
+        std::error_code ec;
+        if (directory) {
+            for (const auto& entry : fs::directory_iterator(path, ec)) {
+                std::string ext = entry.path().extension().string();
+                std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+                if (entry.is_regular_file(ec) && ext == ".png") {
+                    pngFiles.push_back(entry.path());
+                }
+            }
+            std::sort(pngFiles.begin(), pngFiles.end());
+        } else if (fs::exists(path, ec)) {
+            pngFiles.push_back(path);
+        }
+        
+        std::vector<std::string> present;
+        for (const auto& pngFile : pngFiles) {
+            std::string key = pngFile.string();
+            present.push_back(key);
+            auto modified = fs::last_write_time(pngFile, ec);
+            auto size = ec ? 0 : fs::file_size(pngFile, ec);
+            if (ec) continue;
+            auto found = watched.find(key);
+            if (found != watched.end() && found->second.modified == modified && found->second.size == size) {
+                continue;
+            }
+            WatchedFile& file = watched[key];
+            file.modified = modified;
+            file.size = size;
+            file.tiles.tileSize = batch.tileSize;
+            file.tiles.wholeFirst = true;
+            
+            TraceSpan span("convert");
+            ManifestEntry entry;
+            entry.input = key;
+            auto start = std::chrono::steady_clock::now();
+            Vectorizer vectorizer;
+            try {
+                std::ifstream in(pngFile, std::ios::binary);
+                std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+                if (!in && !in.eof()) {
+                    throw std::runtime_error("Failed to read " + key);
+                }
+                entry.inputBytes = bytes.size();
+                
+                std::vector<VectorizationOption> options = vectorizer.inspectImage(bytes.data(), bytes.size());
+                if (options.empty()) {
+                    throw std::runtime_error("无法获取矢量化选项");
+                }
+                entry.optionIndex = selectOption(options, true, batch.optionIndex);
+                entry.option = options[entry.optionIndex];
+                std::string svg = vectorizer.convertImage(bytes.data(), bytes.size(), entry.option.step,
+                                                          entry.option.colors, file.tiles);
+                
+                entry.output = (outputDir / (pngFile.stem().string() + ".svg")).string();
+                io.write(entry.output, std::move(svg));
+                size_t tiles = file.tiles.tiles.size();
+                logInfo("file_updated").field("output", entry.output).field("tiles", tiles)
+                    .field("retraced", file.tiles.tilesTraced)
+                    << "  ✓ " << pngFile.filename() << " → " << fs::path(entry.output).filename()
+                    << (file.tiles.tilesCurrent
+                        ? "（重新描摹 " + std::to_string(file.tiles.tilesTraced) + "/" + std::to_string(tiles) + " 个图块）"
+                        : std::string("（整张描摹）"));
+                successCount++;
+            } catch (const std::exception& e) {
+                entry.error = e.what();
+                file.tiles = TileCache{};
+                logError("file_failed").field("input", key).field("error", entry.error)
+                    << "错误处理 " << pngFile << ": " << e.what();
+                failCount++;
+            }
+            entry.stats = vectorizer.stats();
+            entry.wallMs = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+            recordResult(batch, entry);
+        }
+        for (const auto& error : io.flush()) {
+            logError("write_failed").field("error", error) << "错误: " << error;
+            successCount--;
+            failCount++;
+        }
+        
+        // Forget deleted files; their SVGs stay
+        for (auto it = watched.begin(); it != watched.end();) {
+            if (std::find(present.begin(), present.end(), it->first) == present.end()) {
+                it = watched.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        
+        // Sleep in short steps so an interrupt ends the wait promptly
+        auto next = roundStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(intervalSeconds));
+        while (!gStopWatching && std::chrono::steady_clock::now() < next) {
+            std::this_thread::sleep_until(std::min(next, std::chrono::steady_clock::now() +
+                                                         std::chrono::milliseconds(100)));
+        }
+    }
+    
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    logSeparator();
+    logInfo("watch_done").field("ok", successCount).field("failed", failCount)
+        << "监视结束: 转换成功 " << successCount << " 次, 失败 " << failCount << " 次";
+    return true;
+}
+
+// True for "-" (stdin) and *.tar paths, which are converted as archives
+bool isArchivePath(const std::string& path) {
+    if (path == "-") return true;
+    std::string ext = fs::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".tar";
+}
+
+// One PNG member of an archive on its way to the output archive
+struct ArchiveJob {
+    TarMember member;
+    std::string svg;
+    ManifestEntry entry;   // output is the SVG member name; error if it failed
+    bool done = false;
+};
+
+void convertMember(ArchiveJob& job, int optionIndex) {
+    TraceSpan span("convert");
+    auto start = std::chrono::steady_clock::now();
+    Vectorizer vectorizer;
+    job.entry.input = job.member.name;
+    job.entry.inputBytes = job.member.data.size();
+    try {
+        const std::vector<uint8_t>& png = job.member.data;
+        std::vector<VectorizationOption> options = vectorizer.inspectImage(png.data(), png.size());
+        if (options.empty()) {
+            throw std::runtime_error("无法获取矢量化选项");
+        }
+        job.entry.optionIndex = selectOption(options, true, optionIndex);
+        job.entry.option = options[job.entry.optionIndex];
+        job.svg = vectorizer.convertImage(png.data(), png.size(), job.entry.option.step,
+                                          job.entry.option.colors);
+        job.entry.output = fs::path(job.member.name).replace_extension(".svg").generic_string();
+    } catch (const std::exception& e) {
+        job.entry.error = e.what();
+    }
+    job.entry.stats = vectorizer.stats();
+    job.entry.wallMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    // The PNG is not needed once converted
+    std::vector<uint8_t>().swap(job.member.data);
+}
+
+// Convert every PNG member of a tar stream into an SVG member of the output
+// tar stream. Members are read and written in order on this thread while
+// `jobs` workers convert the ones in between; nothing touches the disk.
+bool processArchive(const std::string& inputPath, const std::string& outputPath,
+                    const BatchOptions& batch) {
+    int jobs = batch.jobs;
+    std::ifstream inputFile;
+    std::ofstream outputFile;
+    std::istream* in = &std::cin;
+    std::ostream* out = &std::cout;
+    
+    if (inputPath != "-") {
+        inputFile.open(inputPath, std::ios::binary);
+        if (!inputFile) {
+            logError("input_missing").field("input", inputPath) << "错误: 无法打开归档 - " << inputPath;
+            return false;
+        }
+        in = &inputFile;
+    }
+    // The archive is built under a temp name and renamed into place at the end
+    fs::path tempOutput;
+    if (outputPath != "-") {
+        fs::path target(outputPath);
+        tempOutput = target.parent_path() / ("." + target.filename().string() + ".tmp");
+        outputFile.open(tempOutput, std::ios::binary | std::ios::trunc);
+        if (!outputFile) {
+            logError("output_failed").field("output", outputPath) << "错误: 无法创建归档 - " << outputPath;
+            return false;
+        }
+        out = &outputFile;
+    }
+    
+    logInfo("batch_start").field("input", inputPath).field("output", outputPath).field("jobs", jobs)
+        << "归档输入: " << (inputPath == "-" ? "标准输入" : inputPath);
+    logInfo("") << "归档输出: " << (outputPath == "-" ? "标准输出" : outputPath);
+    logInfo("") << "并行任务: " << jobs;
+    logSeparator();
+    
+    TarReader reader(*in);
+    TarWriter writer(*out);
+    
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::unique_ptr<ArchiveJob>> window;  // in input order
+    size_t base = 0;      // index of window.front()
+    size_t claimed = 0;   // next job for a worker
+    bool readDone = false;
+    
+    std::vector<std::thread> workers;
+    for (int i = 0; i < jobs; ++i) {
+        workers.emplace_back([&, i] {
+            TraceLog::setThreadName("worker " + std::to_string(i + 1));
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                changed.wait(lock, [&] { return claimed < base + window.size() || readDone; });
+                if (claimed == base + window.size()) {
+                    return;
+                }
+                ArchiveJob* job = window[claimed - base].get();
+                ++claimed;
+                Metrics::setQueueDepth(static_cast<int64_t>(base + window.size() - claimed));
+                lock.unlock();
+                convertMember(*job, batch.optionIndex);
+                lock.lock();
+                job->done = true;
+                changed.notify_all();
+            }
+        });
+    }
+    
+    int successCount = 0;
+    int failCount = 0;
+    int skipCount = 0;
+    std::string error;
+    
+    // Write finished jobs from the front; block while `keep` or more are queued
+    auto drain = [&](std::unique_lock<std::mutex>& lock, size_t keep) {
+        while (!window.empty()) {
+            if (!window.front()->done) {
+                if (window.size() < keep) return;
+                changed.wait(lock);
+                continue;
+            }
+            std::unique_ptr<ArchiveJob> job = std::move(window.front());
+            window.pop_front();
+            ++base;
+            lock.unlock();
+            if (job->entry.error.empty()) {
+                TraceSpan span("tar write");
+                writer.add(job->entry.output, job->svg, job->member.mtime);
+                successCount++;
+            } else {
+                logError("file_failed").field("input", job->member.name).field("error", job->entry.error)
+                    << "  ✗ " << job->member.name << ": " << job->entry.error;
+                failCount++;
+            }
+            recordResult(batch, job->entry);
+            lock.lock();
+        }
+    };
+    
+    try {
+        size_t limit = static_cast<size_t>(jobs) * 4;
+        TarMember member;
+        auto readNext = [&] {
+            TraceSpan span("tar read");
+            return reader.next(member);
+        };
+        while (readNext()) {
+            std::string ext = fs::path(member.name).extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            if (ext != ".png") {
+                skipCount++;
+                continue;
+            }
+            auto job = std::make_unique<ArchiveJob>();
+            job->member = std::move(member);
+            member = TarMember();
+            
+            std::unique_lock<std::mutex> lock(mutex);
+            window.push_back(std::move(job));
+            Metrics::setQueueDepth(static_cast<int64_t>(base + window.size() - claimed));
+            changed.notify_all();
+            drain(lock, limit);
+        }
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    
+    try {
+        std::unique_lock<std::mutex> lock(mutex);
+        readDone = true;
+        changed.notify_all();
+        drain(lock, 0);
+    } catch (const std::exception& e) {
+        if (error.empty()) error = e.what();
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    
+    try {
+        writer.finish();
+        if (!tempOutput.empty()) {
+            outputFile.close();
+            if (!outputFile) {
+                throw std::runtime_error("Failed to write " + tempOutput.string());
+            }
+            if (error.empty()) {
+                if (batch.sync && !syncPath(tempOutput.string())) {
+                    throw std::runtime_error("Failed to sync " + tempOutput.string());
+                }
+                fs::rename(tempOutput, outputPath);
+                if (batch.sync) {
+                    fs::path dir = fs::path(outputPath).parent_path();
+                    syncPath(dir.empty() ? "." : dir.string());
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        if (error.empty()) error = e.what();
+    }
+    if (!tempOutput.empty()) {
+        std::error_code ec;
+        fs::remove(tempOutput, ec);
+    }
+    
+    logSeparator();
+    {
+        LogLine done = logInfo("batch_done");
+        done.field("ok", successCount).field("failed", failCount).field("skipped", skipCount)
+            << "完成: 成功 " << successCount << " 个, 失败 " << failCount << " 个";
+        if (skipCount > 0) {
+            done << ", 跳过非PNG成员 " << skipCount << " 个";
+        }
+    }
+    if (!error.empty()) {
+        logError("archive_failed").field("error", error) << "错误: " << error;
+        return false;
+    }
+    return true;
+}
+
 // Show usage information
 void showUsage() {
     std::cout << R"(
@@ -191,15 +816,56 @@ void showUsage() {
 ║               C++ Vectorizer - PNG转SVG工具                      ║
 ╚════════════════════════════════════════════════════════════════╝
 
-用法: png2svg <文件或目录> [选项]
+用法: png2svg <文件或目录或归档> [选项]
+      png2svg bench <目录> [选项]    内存中的端到端基准测试（bench --help 查看选项）
+      png2svg soak <目录> [选项]     长时间运行测试，检查内存与延迟漂移（soak --help 查看选项）
 
 参数:
-  <文件或目录>     PNG文件路径或包含PNG文件的目录
+  <文件或目录或归档>
+                  PNG或GIF动画文件路径、包含PNG/GIF文件的目录，或包含PNG文件的tar归档
+                  （- 表示从标准输入读取tar流）
 
 选项:
   --auto          自动选择第一个矢量化选项（默认交互式选择）
   --option N      与--auto配合使用，选择第N个选项（默认: 0）
   --inspect-only  仅显示可用选项，不进行转换
+  --huge-pages    图像缓冲区使用透明大页（Linux）
+  --max-resident MB
+                  解码后超过MB兆字节的图像使用外存模式（内存映射临时文件，分条处理）
+  --scratch-dir DIR
+                  外存模式临时文件目录（默认: 系统临时目录）
+  --output FILE   归档模式的输出tar（默认: <归档名>_svg.tar，标准输入时为 -，即标准输出）
+  --jobs N        归档模式的并行转换任务数、GIF动画的并行描摹线程数（默认: CPU核心数）
+  --fsync         目录/归档模式下输出发布前先落盘（按批fsync，较慢但断电安全）
+  --watch         转换后继续监视文件或目录，PNG新增或修改时自动重新转换（Ctrl+C 结束）；
+                  只重新描摹位图有变化的图块，总是自动选择选项
+  --watch-interval SEC
+                  监视模式的检查间隔秒数（默认: 1）
+  --tile-size N   监视模式与GIF动画的图块边长，单位像素（默认: 256）
+  --gif-output MODE
+                  GIF动画的输出: smil（默认，一个SMIL动画SVG）或 frames（每帧一个
+                  <名称>_0001.svg）
+  --dedup MODE    目录模式下内容相同的PNG只转换一次，其余输出: copy（默认，复制SVG）、
+                  link（硬链接，文件系统不支持时复制）或 off（每个都转换）
+  --trace-out FILE
+                  记录各线程的处理阶段，写出Chrome trace-event JSON（可用Perfetto查看）
+  --profile       结束时输出各阶段耗时统计；以 -DPNG2SVG_PROFILE=ON 构建时
+                  还统计堆分配次数/字节数与大块复制次数/字节数
+  --metrics FILE  运行期间每秒将Prometheus文本格式的指标写入FILE（吞吐量、各阶段
+                  延迟直方图、队列深度、缓冲池命中率、内存占用、失败数）
+  --log-level LEVEL
+                  日志级别: debug, info（默认）, warn, error
+  --log-format FORMAT
+                  日志格式: text（默认）或 json（每行一个JSON对象，含时间、级别、线程、事件与字段）
+  --manifest FILE 目录/归档模式下为每个输入写一行JSON结果（选项、调色板、尺寸、
+                  路径/节点数、输出字节数、复杂度、降级方式、各阶段耗时、CPU时间、
+                  峰值内存、错误）
+  --max-edges N   位图黑白边界超过N时降级（默认: 10000000，0为不限制）
+  --max-components N
+                  位图黑色连通区域超过N时降级（默认: 100000，0为不限制）
+  --complexity-fallback MODE
+                  超限图像的降级方式: preview（默认，缩小位图后描摹）或
+                  raster（将原图以<image>嵌入SVG）
   --help, -h      显示此帮助信息
 
 示例:
@@ -214,10 +880,21 @@ void showUsage() {
   
   # 查看文件的矢量化选项
   ./png2svg /path/to/image.png --inspect-only
+  
+  # 转换tar归档中的所有PNG，结果写入另一个tar
+  ./png2svg icons.tar --auto --jobs 8 --output icons_svg.tar
+  tar -c icons/ | ./png2svg - --auto > icons_svg.tar
+  
+  # 基准测试：比较1到8个线程的吞吐量与延迟
+  ./png2svg bench corpus --threads 8
 
 说明:
   • 单个文件: SVG将生成在PNG文件的同目录下
+  • GIF动画: 所有帧共用一个选项与调色板，分段并行描摹，每帧只重新描摹与上一帧
+    不同的图块；总是自动选择选项（--option 仍然有效）
   • 目录批量: SVG将保存到 svg_output 子目录中
+  • tar归档: 按原顺序写入输出tar，成员名扩展名改为 .svg，不解包到磁盘；
+    总是自动选择选项（--option 仍然有效）
   • 需要安装 potrace 工具
     )" << std::endl;
 }
@@ -229,12 +906,35 @@ int main(int argc, char* argv[]) {
         return 0;
     }
     
+    // Subcommands
+    if (std::string(argv[1]) == "bench") {
+        return benchCommand(argc - 1, argv + 1);
+    }
+    if (std::string(argv[1]) == "soak") {
+        return soakCommand(argc - 1, argv + 1);
+    }
+    
     // Parse command line arguments
     std::string inputPath;
     bool autoSelect = false;
     int optionIndex = 0;
     bool inspectOnly = false;
     bool showHelp = false;
+    size_t maxResidentMB = 0;
+    std::string scratchDir;
+    std::string outputPath;
+    int jobs = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    bool sync = false;
+    DedupMode dedup = DedupMode::Copy;
+    bool watch = false;
+    double watchInterval = 1;
+    int tileSize = 256;
+    AnimationOutput gifOutput = AnimationOutput::Smil;
+    std::string manifestPath;
+    std::string tracePath;
+    bool profile = false;
+    std::string metricsPath;
+    ComplexityLimits complexity;
     
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
@@ -247,7 +947,78 @@ int main(int argc, char* argv[]) {
             optionIndex = std::stoi(argv[++i]);
         } else if (arg == "--inspect-only") {
             inspectOnly = true;
-        } else if (inputPath.empty() && arg[0] != '-') {
+        } else if (arg == "--huge-pages") {
+            BufferPool::setHugePages(true);
+        } else if (arg == "--max-resident" && i + 1 < argc) {
+            maxResidentMB = std::stoul(argv[++i]);
+        } else if (arg == "--scratch-dir" && i + 1 < argc) {
+            scratchDir = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (arg == "--fsync") {
+            sync = true;
+        } else if (arg == "--watch") {
+            watch = true;
+        } else if (arg == "--watch-interval" && i + 1 < argc) {
+            watchInterval = std::max(0.05, std::stod(argv[++i]));
+        } else if (arg == "--tile-size" && i + 1 < argc) {
+            tileSize = std::max(8, std::stoi(argv[++i]));
+        } else if (arg == "--gif-output" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "smil") {
+                gifOutput = AnimationOutput::Smil;
+            } else if (mode == "frames") {
+                gifOutput = AnimationOutput::Frames;
+            } else {
+                std::cerr << "错误: 未知的GIF输出方式 - " << mode << std::endl;
+                return 1;
+            }
+        } else if (arg == "--dedup" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "off") {
+                dedup = DedupMode::Off;
+            } else if (mode == "copy") {
+                dedup = DedupMode::Copy;
+            } else if (mode == "link") {
+                dedup = DedupMode::Link;
+            } else {
+                std::cerr << "错误: 未知的去重方式 - " << mode << std::endl;
+                return 1;
+            }
+        } else if (arg == "--metrics" && i + 1 < argc) {
+            metricsPath = argv[++i];
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg == "--trace-out" && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (arg == "--manifest" && i + 1 < argc) {
+            manifestPath = argv[++i];
+        } else if (arg == "--log-level" && i + 1 < argc) {
+            LogLevel level;
+            if (!Logger::parseLevel(argv[++i], level)) {
+                std::cerr << "错误: 未知的日志级别 - " << argv[i] << std::endl;
+                return 1;
+            }
+            Logger::setLevel(level);
+        } else if (arg == "--log-format" && i + 1 < argc) {
+            LogFormat format;
+            if (!Logger::parseFormat(argv[++i], format)) {
+                std::cerr << "错误: 未知的日志格式 - " << argv[i] << std::endl;
+                return 1;
+            }
+            Logger::setFormat(format);
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            jobs = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--max-edges" && i + 1 < argc) {
+            complexity.maxEdges = std::stoull(argv[++i]);
+        } else if (arg == "--max-components" && i + 1 < argc) {
+            complexity.maxComponents = std::stoull(argv[++i]);
+        } else if (arg == "--complexity-fallback" && i + 1 < argc) {
+            if (!ComplexityGuard::parseFallback(argv[++i], complexity.fallback)) {
+                std::cerr << "错误: 未知的降级方式 - " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (inputPath.empty() && (arg[0] != '-' || arg == "-")) {
             inputPath = arg;
         }
     }
@@ -258,13 +1029,89 @@ int main(int argc, char* argv[]) {
         return 0;
     }
     
+    ScratchSpace::configure(maxResidentMB << 20, scratchDir);
+    ComplexityGuard::configure(complexity);
+    
+    // Progress goes to stderr when the archive itself goes to stdout
+    bool stdoutReserved = isArchivePath(inputPath) && !inspectOnly &&
+                          (outputPath == "-" || (outputPath.empty() && inputPath == "-"));
+    Logger::setStdoutReserved(stdoutReserved);
+    
+    // Reported when main returns, whichever mode ran
+    struct ExitReports {
+        std::string tracePath;
+        bool profile;
+        std::ostream& log;
+        ~ExitReports() {
+            try {
+                Metrics::stopExporter();
+            } catch (const std::exception& e) {
+                logError("metrics_failed").field("error", e.what()) << "错误: " << e.what();
+            }
+            if (!tracePath.empty()) {
+                try {
+                    TraceLog::write(tracePath);
+                } catch (const std::exception& e) {
+                    logError("trace_failed").field("error", e.what()) << "错误: " << e.what();
+                }
+            }
+            Logger::flush();
+            if (profile) {
+                AllocProfile::report(log);
+            }
+        }
+    } exitReports{tracePath, profile, stdoutReserved ? std::cerr : std::cout};
+    if (!tracePath.empty()) {
+        TraceLog::enable();
+    }
+    if (profile) {
+        AllocProfile::enable();
+    }
+    if (!metricsPath.empty()) {
+        Metrics::enable();
+        try {
+            Metrics::startExporter(metricsPath);
+        } catch (const std::exception& e) {
+            logError("metrics_failed").field("error", e.what()) << "错误: " << e.what();
+            return 1;
+        }
+    }
+    
+    BatchOptions batch;
+    batch.autoSelect = autoSelect;
+    batch.optionIndex = optionIndex;
+    batch.jobs = jobs;
+    batch.sync = sync;
+    batch.dedup = dedup;
+    batch.tileSize = tileSize;
+    batch.gifOutput = gifOutput;
+    std::unique_ptr<ManifestWriter> manifest;
+    if (!manifestPath.empty()) {
+        try {
+            manifest = std::make_unique<ManifestWriter>(manifestPath);
+        } catch (const std::exception& e) {
+            logError("manifest_failed").field("error", e.what()) << "错误: " << e.what();
+            return 1;
+        }
+        batch.manifest = manifest.get();
+    }
+    
+    // Archives are streamed, never extracted
+    if (isArchivePath(inputPath) && !inspectOnly) {
+        if (outputPath.empty()) {
+            outputPath = inputPath == "-" ? "-" :
+                (fs::path(inputPath).parent_path() / (fs::path(inputPath).stem().string() + "_svg.tar")).string();
+        }
+        return processArchive(inputPath, outputPath, batch) ? 0 : 1;
+    }
+    
     // Convert input to path
     fs::path path(inputPath);
     path = fs::absolute(path);
     
     // Check if input exists
     if (!fs::exists(path)) {
-        std::cerr << "错误: 路径不存在 - " << path << std::endl;
+        logError("input_missing").field("input", path.string()) << "错误: 路径不存在 - " << path;
         return 1;
     }
     
@@ -272,21 +1119,14 @@ int main(int argc, char* argv[]) {
     if (inspectOnly) {
         if (fs::is_regular_file(path)) {
             if (path.extension() != ".png" && path.extension() != ".PNG") {
-                std::cerr << "错误: 不是PNG文件 - " << path << std::endl;
+                logError("input_not_png").field("input", path.string()) << "错误: 不是PNG文件 - " << path;
                 return 1;
             }
             
-            // Get image name for inspect
-            std::string imageName = path.stem().string();
-            
-            // Copy to working directory temporarily
-            fs::path tempPng = "./" + imageName + ".png";
-            if (!fs::exists(tempPng) || !fs::equivalent(tempPng, path)) {
-                fs::copy_file(path, tempPng, fs::copy_options::overwrite_existing);
-            }
-            
             try {
-                std::vector<VectorizationOption> options = inspectImage(imageName);
+                std::vector<uint8_t> bytes = readInput(path);
+                Vectorizer vectorizer;
+                std::vector<VectorizationOption> options = vectorizer.inspectImage(bytes.data(), bytes.size());
                 
                 // Print options as JSON-like format
                 std::cout << "[\n";
@@ -304,33 +1144,33 @@ int main(int argc, char* argv[]) {
                     std::cout << "\n";
                 }
                 std::cout << "]" << std::endl;
-                
-                // Clean up
-                if (fs::exists(tempPng) && !fs::equivalent(tempPng, path)) {
-                    fs::remove(tempPng);
-                }
             } catch (const std::exception& e) {
-                std::cerr << "错误: " << e.what() << std::endl;
-                // Clean up
-                if (fs::exists(tempPng) && !fs::equivalent(tempPng, path)) {
-                    fs::remove(tempPng);
-                }
+                logError("inspect_failed").field("input", path.string()).field("error", e.what())
+                    << "错误: " << e.what();
                 return 1;
             }
         } else {
-            std::cerr << "错误: --inspect-only 只能用于单个文件" << std::endl;
+            logError("usage") << "错误: --inspect-only 只能用于单个文件";
             return 1;
         }
     } else {
         // Process file or directory
+        if (watch) {
+            return watchPath(path, batch, watchInterval) ? 0 : 1;
+        }
+        std::string ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (fs::is_regular_file(path) && ext == ".gif") {
+            return processAnimationFile(path, batch) ? 0 : 1;
+        }
         if (fs::is_regular_file(path)) {
-            bool success = processSingleFile(path, autoSelect, optionIndex);
+            bool success = processSingleFile(path, batch);
             return success ? 0 : 1;
         } else if (fs::is_directory(path)) {
-            bool success = processDirectory(path, autoSelect, optionIndex);
+            bool success = processDirectory(path, batch);
             return success ? 0 : 1;
         } else {
-            std::cerr << "错误: 无法识别的输入类型 - " << path << std::endl;
+            logError("input_unsupported").field("input", path.string()) << "错误: 无法识别的输入类型 - " << path;
             return 1;
         }
     }
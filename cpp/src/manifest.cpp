@@ -0,0 +1,134 @@
+#include "manifest.h"
+#include <cstdio>
+#include <stdexcept>
+
+namespace {
+
+void appendString(std::string& out, const std::string& value) {
+    out += '"';
+    for (unsigned char c : value) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += '"';
+}
+
+void appendNumber(std::string& out, double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.3f", value);
+    out += buffer;
+}
+
+void appendStrings(std::string& out, const std::vector<std::string>& values) {
+    out += '[';
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i > 0) out += ',';
+        appendString(out, values[i]);
+    }
+    out += ']';
+}
+
+} // namespace
+
+ManifestWriter::ManifestWriter(const std::string& path)
+    : out_(path, std::ios::binary | std::ios::trunc), path_(path) {
+    if (!out_) {
+        throw std::runtime_error("Failed to create manifest: " + path);
+    }
+}
+
+void ManifestWriter::write(const ManifestEntry& entry) {
+    const ConversionStats& stats = entry.stats;
+    std::string line = "{\"input\":";
+    appendString(line, entry.input);
+    line += ",\"output\":";
+    if (entry.output.empty()) line += "null"; else appendString(line, entry.output);
+    line += ",\"inputBytes\":" + std::to_string(entry.inputBytes);
+    line += ",\"status\":";
+    line += entry.error.empty() ? "\"ok\"" : "\"failed\"";
+
+    line += ",\"width\":" + std::to_string(stats.width);
+    line += ",\"height\":" + std::to_string(stats.height);
+    line += ",\"channels\":" + std::to_string(stats.channels);
+    line += ",\"palette\":";
+    appendStrings(line, stats.palette);
+
+    line += ",\"option\":";
+    if (entry.optionIndex < 0) {
+        line += "null";
+    } else {
+        line += "{\"index\":" + std::to_string(entry.optionIndex);
+        line += ",\"step\":" + std::to_string(entry.option.step);
+        line += ",\"colors\":";
+        appendStrings(line, entry.option.colors);
+        line += '}';
+    }
+
+    line += ",\"paths\":" + std::to_string(stats.pathCount);
+    line += ",\"nodes\":" + std::to_string(stats.nodeCount);
+    line += ",\"outputBytes\":" + std::to_string(stats.outputBytes);
+    line += ",\"edges\":" + std::to_string(stats.edges);
+    line += ",\"components\":" + std::to_string(stats.components);
+    line += ",\"downgrade\":";
+    if (stats.downgrade.empty()) {
+        line += "null";
+    } else {
+        appendString(line, stats.downgrade);
+    }
+    line += ",\"previewScale\":" + std::to_string(stats.previewScale);
+
+    line += ",\"stagesMs\":{";
+    for (size_t i = 0; i < stats.stageMs.size(); ++i) {
+        if (i > 0) line += ',';
+        appendString(line, stats.stageMs[i].first);
+        line += ':';
+        appendNumber(line, stats.stageMs[i].second);
+    }
+    line += "},\"wallMs\":";
+    appendNumber(line, entry.wallMs);
+    line += ",\"cpuMs\":";
+    appendNumber(line, stats.cpuMs);
+    line += ",\"potraceCpuMs\":";
+    appendNumber(line, stats.potraceCpuMs);
+    line += ",\"peakBytes\":" + std::to_string(stats.peakBytes);
+
+    // Only profiling builds count allocations and copies
+    if (!stats.stageAllocs.empty()) {
+        line += ",\"stageAllocs\":{";
+        for (size_t i = 0; i < stats.stageAllocs.size(); ++i) {
+            const AllocCounters& counters = stats.stageAllocs[i].second;
+            if (i > 0) line += ',';
+            appendString(line, stats.stageAllocs[i].first);
+            line += ":{\"allocations\":" + std::to_string(counters.allocations);
+            line += ",\"bytes\":" + std::to_string(counters.bytes);
+            line += ",\"copies\":" + std::to_string(counters.copies);
+            line += ",\"copyBytes\":" + std::to_string(counters.copyBytes) + "}";
+        }
+        line += '}';
+    }
+
+    line += ",\"duplicateOf\":";
+    if (entry.duplicateOf.empty()) line += "null"; else appendString(line, entry.duplicateOf);
+    line += ",\"error\":";
+    if (entry.error.empty()) line += "null"; else appendString(line, entry.error);
+    line += "}\n";
+
+    out_.write(line.data(), static_cast<std::streamsize>(line.size()));
+    out_.flush();
+    if (!out_) {
+        throw std::runtime_error("Failed to write manifest: " + path_);
+    }
+}
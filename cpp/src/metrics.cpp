@@ -0,0 +1,306 @@
+#include "metrics.h"
+#include "buffer_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+std::atomic<bool> Metrics::enabled_{false};
+
+namespace {
+
+std::string formatValue(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+    return buffer;
+}
+
+// "{a=\"1\"}", "{a=\"1\",le=\"0.5\"}" and so on; empty when there are no labels
+std::string labelSet(const std::string& labels, const std::string& extra = "") {
+    if (labels.empty() && extra.empty()) return "";
+    if (labels.empty()) return "{" + extra + "}";
+    if (extra.empty()) return "{" + labels + "}";
+    return "{" + labels + "," + extra + "}";
+}
+
+double residentBytes() {
+#if defined(__linux__)
+    long pages = 0, resident = 0;
+    if (FILE* f = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        std::fclose(f);
+    }
+    return static_cast<double>(resident) * sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+double peakResidentBytes() {
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<double>(usage.ru_maxrss);          // bytes
+#else
+    return static_cast<double>(usage.ru_maxrss) * 1024;   // kilobytes
+#endif
+#else
+    return 0;
+#endif
+}
+
+// Latency buckets from 100 µs to 60 s, in seconds
+const std::vector<double> kSecondsBuckets = {
+    0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+    0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60};
+
+// Stages timed by the vectorizer; others are not exported
+const char* const kStages[] = {"inspect", "bitmap", "potrace", "splice", "raster", "solid", "recolor", "optimize",
+                               "viewbox"};
+constexpr size_t kStageCount = sizeof(kStages) / sizeof(kStages[0]);
+
+// Filled once by enable(), read without locking afterwards
+struct PipelineMetrics {
+    Counter* filesOk = nullptr;
+    Counter* filesFailed = nullptr;
+    Counter* inputBytes = nullptr;
+    Counter* outputBytes = nullptr;
+    Histogram* fileSeconds = nullptr;
+    Histogram* stageSeconds[kStageCount] = {};
+    Gauge* queueDepth = nullptr;
+};
+
+PipelineMetrics gPipeline;
+
+struct Exporter {
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::string path;
+    int intervalMs = 1000;
+    std::thread thread;
+};
+
+Exporter gExporter;
+
+void writeAtomically(const std::string& path, const std::string& text) {
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out << text;
+        out.flush();
+        if (!out) {
+            throw std::runtime_error("Failed to write metrics: " + temp);
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp, path, ec);
+    if (ec) {
+        std::filesystem::remove(temp, ec);
+        throw std::runtime_error("Failed to write metrics: " + path);
+    }
+}
+
+} // namespace
+
+Histogram::Histogram(std::vector<double> bounds)
+    : bounds_(std::move(bounds)), buckets_(new std::atomic<uint64_t>[bounds_.size() + 1]) {
+    for (size_t i = 0; i <= bounds_.size(); ++i) {
+        buckets_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::observe(double value) {
+    size_t index = std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+    buckets_[index].fetch_add(1, std::memory_order_relaxed);
+    double sum = sum_.load(std::memory_order_relaxed);
+    while (!sum_.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)) {}
+}
+
+std::vector<uint64_t> Histogram::counts() const {
+    std::vector<uint64_t> counts(bounds_.size() + 1);
+    for (size_t i = 0; i < counts.size(); ++i) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+    return counts;
+}
+
+MetricsRegistry::Series& MetricsRegistry::add(const std::string& name, const std::string& help,
+                                              const std::string& type, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    series_.emplace_back();
+    Series& series = series_.back();
+    series.name = name;
+    series.help = help;
+    series.type = type;
+    series.labels = labels;
+    return series;
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help,
+                                  const std::string& labels) {
+    auto counter = std::make_unique<Counter>();
+    Counter& ref = *counter;
+    add(name, help, "counter", labels).counter = std::move(counter);
+    return ref;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help,
+                              const std::string& labels) {
+    auto gauge = std::make_unique<Gauge>();
+    Gauge& ref = *gauge;
+    add(name, help, "gauge", labels).gauge = std::move(gauge);
+    return ref;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                      const std::vector<double>& bounds, const std::string& labels) {
+    auto histogram = std::make_unique<Histogram>(bounds);
+    Histogram& ref = *histogram;
+    add(name, help, "histogram", labels).histogram = std::move(histogram);
+    return ref;
+}
+
+void MetricsRegistry::sampled(const std::string& name, const std::string& help, const std::string& type,
+                              std::function<double()> sample, const std::string& labels) {
+    add(name, help, type, labels).sample = std::move(sample);
+}
+
+std::string MetricsRegistry::render() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string out;
+    const std::string* family = nullptr;
+    for (const Series& s : series_) {
+        if (!family || *family != s.name) {
+            family = &s.name;
+            out += "# HELP " + s.name + " " + s.help + "\n";
+            out += "# TYPE " + s.name + " " + s.type + "\n";
+        }
+        if (s.counter) {
+            out += s.name + labelSet(s.labels) + " " + std::to_string(s.counter->value()) + "\n";
+        } else if (s.gauge) {
+            out += s.name + labelSet(s.labels) + " " + std::to_string(s.gauge->value()) + "\n";
+        } else if (s.sample) {
+            out += s.name + labelSet(s.labels) + " " + formatValue(s.sample()) + "\n";
+        } else if (s.histogram) {
+            // Count and +Inf are derived from the same bucket snapshot so
+            // the exposition stays self-consistent under concurrent updates
+            std::vector<uint64_t> counts = s.histogram->counts();
+            const std::vector<double>& bounds = s.histogram->bounds();
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < counts.size(); ++i) {
+                cumulative += counts[i];
+                std::string le = i < bounds.size() ? formatValue(bounds[i]) : "+Inf";
+                out += s.name + "_bucket" + labelSet(s.labels, "le=\"" + le + "\"") + " " +
+                       std::to_string(cumulative) + "\n";
+            }
+            out += s.name + "_sum" + labelSet(s.labels) + " " + formatValue(s.histogram->sum()) + "\n";
+            out += s.name + "_count" + labelSet(s.labels) + " " + std::to_string(cumulative) + "\n";
+        }
+    }
+    return out;
+}
+
+MetricsRegistry& Metrics::registry() {
+    static MetricsRegistry instance;
+    return instance;
+}
+
+void Metrics::enable() {
+    if (enabled()) {
+        return;
+    }
+    MetricsRegistry& r = registry();
+    const char* filesHelp = "Inputs converted, by outcome";
+    gPipeline.filesOk = &r.counter("png2svg_files_total", filesHelp, "status=\"ok\"");
+    gPipeline.filesFailed = &r.counter("png2svg_files_total", filesHelp, "status=\"failed\"");
+    gPipeline.inputBytes = &r.counter("png2svg_input_bytes_total", "PNG bytes read");
+    gPipeline.outputBytes = &r.counter("png2svg_output_bytes_total", "SVG bytes produced");
+    gPipeline.fileSeconds = &r.histogram("png2svg_file_duration_seconds",
+                                         "Wall time to inspect and convert one input", kSecondsBuckets);
+    for (size_t i = 0; i < kStageCount; ++i) {
+        gPipeline.stageSeconds[i] = &r.histogram("png2svg_stage_duration_seconds",
+                                                 "Wall time of one pipeline stage", kSecondsBuckets,
+                                                 std::string("stage=\"") + kStages[i] + "\"");
+    }
+    gPipeline.queueDepth = &r.gauge("png2svg_queue_depth", "Inputs waiting for a converter");
+    r.sampled("png2svg_buffer_pool_requests_total", "Image buffer requests, by pool outcome", "counter",
+              [] { return static_cast<double>(BufferPool::cacheHits()); }, "result=\"hit\"");
+    r.sampled("png2svg_buffer_pool_requests_total", "Image buffer requests, by pool outcome", "counter",
+              [] { return static_cast<double>(BufferPool::cacheMisses()); }, "result=\"miss\"");
+    r.sampled("png2svg_resident_memory_bytes", "Resident set size", "gauge", residentBytes);
+    r.sampled("png2svg_peak_resident_memory_bytes", "Largest resident set size so far", "gauge",
+              peakResidentBytes);
+    enabled_.store(true, std::memory_order_release);
+}
+
+void Metrics::observeStage(const char* stage, double ms) {
+    if (!enabled()) {
+        return;
+    }
+    for (size_t i = 0; i < kStageCount; ++i) {
+        if (std::strcmp(stage, kStages[i]) == 0) {
+            gPipeline.stageSeconds[i]->observe(ms / 1000.0);
+            return;
+        }
+    }
+}
+
+void Metrics::fileDone(bool ok, size_t inputBytes, size_t outputBytes, double ms) {
+    if (!enabled()) {
+        return;
+    }
+    (ok ? gPipeline.filesOk : gPipeline.filesFailed)->inc();
+    gPipeline.inputBytes->inc(inputBytes);
+    gPipeline.outputBytes->inc(outputBytes);
+    gPipeline.fileSeconds->observe(ms / 1000.0);
+}
+
+void Metrics::setQueueDepth(int64_t depth) {
+    if (enabled()) {
+        gPipeline.queueDepth->set(depth);
+    }
+}
+
+void Metrics::startExporter(const std::string& path, int intervalMs) {
+    writeAtomically(path, registry().render());
+    gExporter.path = path;
+    gExporter.intervalMs = std::max(10, intervalMs);
+    gExporter.thread = std::thread([] {
+        std::unique_lock<std::mutex> lock(gExporter.mutex);
+        while (!gExporter.wake.wait_for(lock, std::chrono::milliseconds(gExporter.intervalMs),
+                                        [] { return gExporter.stopping; })) {
+            lock.unlock();
+            try {
+                writeAtomically(gExporter.path, registry().render());
+            } catch (const std::exception&) {
+                // Keep going; the next interval or the final write may succeed
+            }
+            lock.lock();
+        }
+    });
+}
+
+void Metrics::stopExporter() {
+    if (!gExporter.thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(gExporter.mutex);
+        gExporter.stopping = true;
+    }
+    gExporter.wake.notify_all();
+    gExporter.thread.join();
+    writeAtomically(gExporter.path, registry().render());
+}
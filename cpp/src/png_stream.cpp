@@ -0,0 +1,1028 @@
+#include "png_stream.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PNG_STREAM_SSE2 1
+#include <emmintrin.h>
+#else
+#define PNG_STREAM_SSE2 0
+#endif
+
+namespace {
+
+constexpr uint8_t kPngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+// Same dimension limit stb_image applies
+constexpr uint32_t kMaxDimension = 1u << 24;
+
+constexpr uint32_t chunkType(char a, char b, char c, char d) {
+    return (uint32_t(uint8_t(a)) << 24) | (uint32_t(uint8_t(b)) << 16) |
+           (uint32_t(uint8_t(c)) << 8) | uint32_t(uint8_t(d));
+}
+
+uint32_t readBe32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+[[noreturn]] void corrupt(const char* what) {
+    throw std::runtime_error(std::string("Corrupt PNG: ") + what);
+}
+
+// Source of raw file bytes
+class ByteInput {
+public:
+    virtual ~ByteInput() = default;
+    virtual size_t read(uint8_t* dst, size_t n) = 0;
+
+    bool readExact(uint8_t* dst, size_t n) { return read(dst, n) == n; }
+
+    bool skip(size_t n) {
+        uint8_t scratch[4096];
+        while (n > 0) {
+            size_t step = std::min(n, sizeof(scratch));
+            if (read(scratch, step) != step) return false;
+            n -= step;
+        }
+        return true;
+    }
+};
+
+class FileInput : public ByteInput {
+public:
+    explicit FileInput(std::FILE* file) : file_(file) {}
+    ~FileInput() override { std::fclose(file_); }
+    size_t read(uint8_t* dst, size_t n) override { return std::fread(dst, 1, n, file_); }
+private:
+    std::FILE* file_;
+};
+
+class MemoryInput : public ByteInput {
+public:
+    MemoryInput(const uint8_t* data, size_t size) : data_(data), left_(size) {}
+    size_t read(uint8_t* dst, size_t n) override {
+        n = std::min(n, left_);
+        std::memcpy(dst, data_, n);
+        data_ += n;
+        left_ -= n;
+        return n;
+    }
+private:
+    const uint8_t* data_;
+    size_t left_;
+};
+
+// Everything before the first IDAT that decoding needs
+struct PngHeader {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    int depth = 0;
+    int colorType = 0;
+    int rawChannels = 0;       // samples per pixel in the filtered stream
+    int outChannels = 0;       // channels delivered to the sink
+    bool hasTransparency = false;
+    uint16_t transparent[3] = {0, 0, 0};
+    std::array<uint8_t, 256 * 4> palette{};
+    uint32_t paletteSize = 0;
+    uint32_t firstIdatLength = 0;
+
+    size_t rawRowBytes() const {
+        return (static_cast<size_t>(width) * rawChannels * depth + 7) / 8;
+    }
+    int filterStride() const {
+        return std::max(1, rawChannels * depth / 8);
+    }
+};
+
+// Reads chunks up to the first IDAT. Returns false for anything this decoder
+// leaves to stb_image (not a PNG, interlaced, CgBI, unknown critical chunk,
+// malformed header).
+bool readHeader(ByteInput& in, PngHeader& header) {
+    uint8_t buf[13];
+    if (!in.readExact(buf, 8) || std::memcmp(buf, kPngSignature, 8) != 0) {
+        return false;
+    }
+
+    bool seenHeader = false;
+    for (;;) {
+        if (!in.readExact(buf, 8)) return false;
+        uint32_t length = readBe32(buf);
+        uint32_t type = readBe32(buf + 4);
+
+        if (type == chunkType('I', 'H', 'D', 'R')) {
+            if (seenHeader || length != 13 || !in.readExact(buf, 13)) return false;
+            seenHeader = true;
+            header.width = readBe32(buf);
+            header.height = readBe32(buf + 4);
+            header.depth = buf[8];
+            header.colorType = buf[9];
+            int interlace = buf[12];
+            if (buf[10] != 0 || buf[11] != 0 || interlace != 0) return false;
+            if (header.width == 0 || header.height == 0 ||
+                header.width > kMaxDimension || header.height > kMaxDimension) return false;
+            switch (header.colorType) {
+                case 0: header.rawChannels = 1; break;
+                case 2: header.rawChannels = 3; break;
+                case 3: header.rawChannels = 1; break;
+                case 4: header.rawChannels = 2; break;
+                case 6: header.rawChannels = 4; break;
+                default: return false;
+            }
+            int d = header.depth;
+            bool depthOk = (d == 8 || d == 16) ||
+                           ((d == 1 || d == 2 || d == 4) && (header.colorType == 0 || header.colorType == 3));
+            if (!depthOk || (header.colorType == 3 && d == 16)) return false;
+        } else if (type == chunkType('P', 'L', 'T', 'E')) {
+            if (!seenHeader || length > 256 * 3 || length % 3 != 0) return false;
+            header.paletteSize = length / 3;
+            for (uint32_t i = 0; i < header.paletteSize; ++i) {
+                if (!in.readExact(buf, 3)) return false;
+                header.palette[i * 4 + 0] = buf[0];
+                header.palette[i * 4 + 1] = buf[1];
+                header.palette[i * 4 + 2] = buf[2];
+                header.palette[i * 4 + 3] = 255;
+            }
+        } else if (type == chunkType('t', 'R', 'N', 'S')) {
+            if (!seenHeader) return false;
+            if (header.colorType == 3) {
+                if (header.paletteSize == 0 || length > header.paletteSize) return false;
+                for (uint32_t i = 0; i < length; ++i) {
+                    if (!in.readExact(buf, 1)) return false;
+                    header.palette[i * 4 + 3] = buf[0];
+                }
+                header.hasTransparency = true;
+            } else {
+                if (header.colorType != 0 && header.colorType != 2) return false;
+                if (length != static_cast<uint32_t>(header.rawChannels) * 2) return false;
+                for (int k = 0; k < header.rawChannels; ++k) {
+                    if (!in.readExact(buf, 2)) return false;
+                    header.transparent[k] = static_cast<uint16_t>((buf[0] << 8) | buf[1]);
+                }
+                header.hasTransparency = true;
+            }
+        } else if (type == chunkType('I', 'D', 'A', 'T')) {
+            if (!seenHeader || (header.colorType == 3 && header.paletteSize == 0)) return false;
+            header.firstIdatLength = length;
+            break;
+        } else if (type == chunkType('C', 'g', 'B', 'I') || type == chunkType('I', 'E', 'N', 'D') ||
+                   (type & (1u << 29)) == 0) {
+            // Apple's variant, missing image data, or a critical chunk we do not know
+            return false;
+        } else {
+            if (!seenHeader || !in.skip(length)) return false;
+        }
+
+        // CRC
+        if (type != chunkType('I', 'D', 'A', 'T') && !in.readExact(buf, 4)) return false;
+    }
+
+    if (header.colorType == 3) {
+        header.outChannels = header.hasTransparency ? 4 : 3;
+    } else {
+        header.outChannels = header.rawChannels + (header.hasTransparency ? 1 : 0);
+    }
+    return true;
+}
+
+// Concatenated payload of consecutive IDAT chunks
+class IdatStream {
+public:
+    IdatStream(ByteInput& in, uint32_t firstLength) : in_(in), remaining_(firstLength) {}
+
+    size_t read(uint8_t* dst, size_t n) {
+        size_t total = 0;
+        while (n > 0 && !done_) {
+            if (remaining_ == 0) {
+                uint8_t buf[12];
+                // CRC of the previous chunk, then the next chunk header
+                if (!in_.readExact(buf, 12) || readBe32(buf + 8) != chunkType('I', 'D', 'A', 'T')) {
+                    done_ = true;
+                    break;
+                }
+                remaining_ = readBe32(buf + 4);
+                continue;
+            }
+            size_t step = std::min<size_t>(n, remaining_);
+            size_t got = in_.read(dst, step);
+            total += got;
+            dst += got;
+            n -= got;
+            remaining_ -= static_cast<uint32_t>(got);
+            if (got < step) {
+                done_ = true;
+            }
+        }
+        return total;
+    }
+
+private:
+    ByteInput& in_;
+    uint32_t remaining_;
+    bool done_ = false;
+};
+
+#if PNG_STREAM_SSE2
+
+// SSE2 unfiltering for 3- and 4-byte pixels (8-bit RGB and RGBA). Sub, Avg
+// and Paeth depend on the pixel to the left, so rows are walked one pixel
+// at a time with all channels of a pixel in one register.
+
+// Pixels move through general registers; going through memory with a
+// 3-byte memcpy stalls on store forwarding
+template <int Bpp>
+__m128i loadPixel(const uint8_t* p) {
+    if constexpr (Bpp == 4) {
+        int v;
+        std::memcpy(&v, p, 4);
+        return _mm_cvtsi32_si128(v);
+    } else {
+        return _mm_cvtsi32_si128(p[0] | (p[1] << 8) | (p[2] << 16));
+    }
+}
+
+template <int Bpp>
+void storePixel(uint8_t* p, __m128i v) {
+    int x = _mm_cvtsi128_si32(v);
+    if constexpr (Bpp == 4) {
+        std::memcpy(p, &x, 4);
+    } else {
+        p[0] = static_cast<uint8_t>(x);
+        p[1] = static_cast<uint8_t>(x >> 8);
+        p[2] = static_cast<uint8_t>(x >> 16);
+    }
+}
+
+template <int Bpp>
+void unfilterSubSse2(uint8_t* cur, size_t n) {
+    __m128i a = _mm_setzero_si128();
+    for (size_t i = 0; i < n; i += Bpp) {
+        a = _mm_add_epi8(a, loadPixel<Bpp>(cur + i));
+        storePixel<Bpp>(cur + i, a);
+    }
+}
+
+template <int Bpp>
+void unfilterAvgSse2(uint8_t* cur, const uint8_t* prior, size_t n) {
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i a = _mm_setzero_si128();
+    for (size_t i = 0; i < n; i += Bpp) {
+        __m128i b = loadPixel<Bpp>(prior + i);
+        // _mm_avg_epu8 rounds up; PNG wants (a + b) >> 1
+        __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+        a = _mm_add_epi8(loadPixel<Bpp>(cur + i), avg);
+        storePixel<Bpp>(cur + i, a);
+    }
+}
+
+inline __m128i abs16(__m128i x) {
+    return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+inline __m128i select16(__m128i mask, __m128i yes, __m128i no) {
+    return _mm_or_si128(_mm_and_si128(mask, yes), _mm_andnot_si128(mask, no));
+}
+
+template <int Bpp>
+void unfilterPaethSse2(uint8_t* cur, const uint8_t* prior, size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    // Channels widened to 16 bits: a = left, b = above, c = above-left
+    __m128i a = zero, c = zero;
+    for (size_t i = 0; i < n; i += Bpp) {
+        __m128i b = _mm_unpacklo_epi8(loadPixel<Bpp>(prior + i), zero);
+        __m128i x = _mm_unpacklo_epi8(loadPixel<Bpp>(cur + i), zero);
+
+        __m128i pa = _mm_sub_epi16(b, c);
+        __m128i pb = _mm_sub_epi16(a, c);
+        __m128i pc = abs16(_mm_add_epi16(pa, pb));
+        pa = abs16(pa);
+        pb = abs16(pb);
+        __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+        // Ties favor a, then b, then c
+        __m128i pred = select16(_mm_cmpeq_epi16(smallest, pb), b, c);
+        pred = select16(_mm_cmpeq_epi16(smallest, pa), a, pred);
+
+        a = _mm_and_si128(_mm_add_epi16(x, pred), _mm_set1_epi16(0xff));
+        c = b;
+        storePixel<Bpp>(cur + i, _mm_packus_epi16(a, a));
+    }
+}
+
+// Returns false when the row must take the scalar path
+bool unfilterSse2(uint8_t filter, uint8_t* cur, const uint8_t* prior, size_t n, size_t bpp) {
+    if (bpp != 3 && bpp != 4) return false;
+    switch (filter) {
+        case 1:
+            bpp == 3 ? unfilterSubSse2<3>(cur, n) : unfilterSubSse2<4>(cur, n);
+            return true;
+        case 3:
+            bpp == 3 ? unfilterAvgSse2<3>(cur, prior, n) : unfilterAvgSse2<4>(cur, prior, n);
+            return true;
+        case 4:
+            bpp == 3 ? unfilterPaethSse2<3>(cur, prior, n) : unfilterPaethSse2<4>(cur, prior, n);
+            return true;
+        default:
+            return false;
+    }
+}
+
+#endif
+
+// Turns the inflated byte stream into unfiltered scanlines and hands them to
+// the sink in chunks, expanded to the channel layout stb_image produces.
+// When that layout is the raw one (8-bit gray, gray+alpha, RGB, RGBA without
+// tRNS) rows are unfiltered in place in the chunk buffer, with no copy.
+class ScanlineAssembler {
+public:
+    ScanlineAssembler(const PngHeader& header, RowSink& sink, int chunkRows)
+        : header_(header), sink_(sink),
+          rowBytes_(header.rawRowBytes()),
+          outRowBytes_(static_cast<size_t>(header.width) * header.outChannels),
+          chunkRows_(static_cast<int>(std::min<uint32_t>(std::max(1, chunkRows), header.height))),
+          direct_(header.depth == 8 && header.colorType != 3 && !header.hasTransparency),
+          current_(direct_ ? 0 : rowBytes_), previous_(rowBytes_, 0),
+          unpacked_(header.colorType == 3 && header.depth < 8 ? header.width : 0),
+          chunk_(outRowBytes_ * chunkRows_) {
+        sink_.begin(static_cast<int>(header.width), static_cast<int>(header.height), header.outChannels);
+    }
+
+    void feed(const uint8_t* data, size_t n) {
+        while (n > 0 && row_ < header_.height) {
+            if (!haveFilter_) {
+                filter_ = *data++;
+                --n;
+                haveFilter_ = true;
+                continue;
+            }
+            uint8_t* target = rowTarget();
+            size_t take = std::min(n, rowBytes_ - filled_);
+            std::memcpy(target + filled_, data, take);
+            filled_ += take;
+            data += take;
+            n -= take;
+            if (filled_ == rowBytes_) {
+                finishRow(target);
+                filled_ = 0;
+                haveFilter_ = false;
+            }
+        }
+    }
+
+    void finish() {
+        if (row_ < header_.height) {
+            corrupt("not enough image data");
+        }
+        sink_.end();
+    }
+
+private:
+    uint8_t* chunkRow(int i) {
+        return chunk_.data() + static_cast<size_t>(i) * outRowBytes_;
+    }
+
+    uint8_t* rowTarget() {
+        return direct_ ? chunkRow(chunkFill_) : current_.data();
+    }
+
+    void finishRow(uint8_t* row) {
+        const uint8_t* prior = (direct_ && chunkFill_ > 0) ? chunkRow(chunkFill_ - 1) : previous_.data();
+        unfilter(filter_, row, prior);
+        if (!direct_) {
+            expand(row, chunkRow(chunkFill_));
+            current_.swap(previous_);
+        }
+        ++row_;
+        if (++chunkFill_ == chunkRows_ || row_ == header_.height) {
+            sink_.rows(static_cast<int>(row_) - chunkFill_, chunkFill_, chunk_.data(), outRowBytes_);
+            if (direct_) {
+                // The next chunk's first row is unfiltered against this one
+                std::memcpy(previous_.data(), chunkRow(chunkFill_ - 1), rowBytes_);
+            }
+            chunkFill_ = 0;
+        }
+    }
+
+    void unfilter(uint8_t filter, uint8_t* cur, const uint8_t* prior) {
+        const size_t n = rowBytes_;
+        const size_t bpp = header_.filterStride();
+#if PNG_STREAM_SSE2
+        if (unfilterSse2(filter, cur, prior, n, bpp)) {
+            return;
+        }
+#endif
+        switch (filter) {
+            case 0:
+                break;
+            case 1:
+                for (size_t i = bpp; i < n; ++i) cur[i] = static_cast<uint8_t>(cur[i] + cur[i - bpp]);
+                break;
+            case 2:
+                for (size_t i = 0; i < n; ++i) cur[i] = static_cast<uint8_t>(cur[i] + prior[i]);
+                break;
+            case 3:
+                if (bpp == 1) {
+                    unfilterAvgGray(cur, prior, n);
+                    break;
+                }
+                for (size_t i = 0; i < bpp && i < n; ++i) cur[i] = static_cast<uint8_t>(cur[i] + (prior[i] >> 1));
+                for (size_t i = bpp; i < n; ++i) {
+                    cur[i] = static_cast<uint8_t>(cur[i] + ((cur[i - bpp] + prior[i]) >> 1));
+                }
+                break;
+            case 4:
+                if (bpp == 1) {
+                    unfilterPaethGray(cur, prior, n);
+                    break;
+                }
+                for (size_t i = 0; i < bpp && i < n; ++i) cur[i] = static_cast<uint8_t>(cur[i] + prior[i]);
+                for (size_t i = bpp; i < n; ++i) {
+                    int a = cur[i - bpp], b = prior[i], c = prior[i - bpp];
+                    int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+                    int pred = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                    cur[i] = static_cast<uint8_t>(cur[i] + pred);
+                }
+                break;
+            default:
+                corrupt("invalid filter");
+        }
+    }
+
+    // One-byte pixels keep the left neighbour in a register; indexing
+    // cur[i - 1] reloads it on every step because cur may alias prior
+    static void unfilterAvgGray(uint8_t* cur, const uint8_t* prior, size_t n) {
+        int a = 0;
+        for (size_t i = 0; i < n; ++i) {
+            a = static_cast<uint8_t>(cur[i] + ((a + prior[i]) >> 1));
+            cur[i] = static_cast<uint8_t>(a);
+        }
+    }
+
+    static void unfilterPaethGray(uint8_t* cur, const uint8_t* prior, size_t n) {
+        int a = 0, c = 0;
+        for (size_t i = 0; i < n; ++i) {
+            int b = prior[i];
+            int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+            int pred = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+            a = static_cast<uint8_t>(cur[i] + pred);
+            cur[i] = static_cast<uint8_t>(a);
+            c = b;
+        }
+    }
+
+    // Scale factors stb_image applies to low bit depth gray samples
+    static int depthScale(int depth) {
+        switch (depth) {
+            case 1: return 0xff;
+            case 2: return 0x55;
+            case 4: return 0x11;
+            default: return 1;
+        }
+    }
+
+    void expand(const uint8_t* raw, uint8_t* out) {
+        const uint32_t width = header_.width;
+        const int depth = header_.depth;
+        const int inCh = header_.rawChannels;
+        const int outCh = header_.outChannels;
+
+        if (header_.colorType == 3) {
+            if (depth < 8) {
+                unpack(raw, unpacked_.data(), width, depth);
+                raw = unpacked_.data();
+            }
+            // Fixed-size copies; a per-pixel memcpy of outCh bytes does not
+            // inline and costs more than the inflate itself on palette icons
+            const uint8_t* palette = header_.palette.data();
+            if (outCh == 4) {
+                for (uint32_t x = 0; x < width; ++x) {
+                    std::memcpy(out + static_cast<size_t>(x) * 4, palette + raw[x] * 4, 4);
+                }
+            } else {
+                for (uint32_t x = 0; x < width; ++x) {
+                    std::memcpy(out + static_cast<size_t>(x) * 3, palette + raw[x] * 4, 3);
+                }
+            }
+            return;
+        }
+
+        if (depth < 8) {
+            // Gray only
+            const int scale = depthScale(depth);
+            const int key = (header_.transparent[0] & 255) * scale;
+            for (uint32_t x = 0; x < width; ++x) {
+                int v = sample(raw, x, depth) * scale;
+                out[x * outCh] = static_cast<uint8_t>(v);
+                if (header_.hasTransparency) out[x * outCh + 1] = (v == (key & 255)) ? 0 : 255;
+            }
+            return;
+        }
+
+        if (depth == 8) {
+            if (!header_.hasTransparency) {
+                std::memcpy(out, raw, static_cast<size_t>(width) * inCh);
+                return;
+            }
+            for (uint32_t x = 0; x < width; ++x) {
+                const uint8_t* p = raw + static_cast<size_t>(x) * inCh;
+                uint8_t* q = out + static_cast<size_t>(x) * outCh;
+                bool match = true;
+                for (int c = 0; c < inCh; ++c) {
+                    q[c] = p[c];
+                    match = match && p[c] == (header_.transparent[c] & 255);
+                }
+                q[inCh] = match ? 0 : 255;
+            }
+            return;
+        }
+
+        // 16-bit: keep the high byte, compare transparency at full precision
+        for (uint32_t x = 0; x < width; ++x) {
+            const uint8_t* p = raw + static_cast<size_t>(x) * inCh * 2;
+            uint8_t* q = out + static_cast<size_t>(x) * outCh;
+            for (int c = 0; c < inCh; ++c) {
+                q[c] = p[c * 2];
+            }
+            if (header_.hasTransparency) {
+                bool match = true;
+                for (int c = 0; c < inCh; ++c) {
+                    match = match && ((p[c * 2] << 8) | p[c * 2 + 1]) == header_.transparent[c];
+                }
+                q[inCh] = match ? 0 : 255;
+            }
+        }
+    }
+
+    // Spread a row packed at `depth` bits (depth < 8) to one byte per sample
+    static void unpack(const uint8_t* raw, uint8_t* out, uint32_t width, int depth) {
+        const int perByte = 8 / depth;
+        const int mask = (1 << depth) - 1;
+        uint32_t x = 0;
+        for (; x + perByte <= width; ++raw) {
+            const int b = *raw;
+            for (int shift = 8 - depth; shift >= 0; shift -= depth) out[x++] = static_cast<uint8_t>((b >> shift) & mask);
+        }
+        for (int shift = 8 - depth; x < width; shift -= depth) out[x++] = static_cast<uint8_t>((*raw >> shift) & mask);
+    }
+
+    // Sample x of a row packed at `depth` bits (depth <= 8)
+    static int sample(const uint8_t* raw, uint32_t x, int depth) {
+        if (depth == 8) return raw[x];
+        uint32_t bit = x * depth;
+        int shift = 8 - depth - static_cast<int>(bit & 7);
+        return (raw[bit >> 3] >> shift) & ((1 << depth) - 1);
+    }
+
+    const PngHeader& header_;
+    RowSink& sink_;
+    const size_t rowBytes_;
+    const size_t outRowBytes_;
+    const int chunkRows_;
+    const bool direct_;
+    std::vector<uint8_t> current_;
+    std::vector<uint8_t> previous_;
+    std::vector<uint8_t> unpacked_;
+    std::vector<uint8_t> chunk_;
+    uint8_t filter_ = 0;
+    bool haveFilter_ = false;
+    size_t filled_ = 0;
+    uint32_t row_ = 0;
+    int chunkFill_ = 0;
+};
+
+// Canonical Huffman decoding table with a direct lookup for short codes.
+// Literal/length tables also resolve two consecutive literals per lookup
+// when both codes fit in the lookup bits, which covers most of the literal
+// runs in filtered image data.
+struct Huffman {
+    static constexpr int kFastBits = 11;
+    static constexpr int kFastMask = (1 << kFastBits) - 1;
+
+    // Lookup entry layout; a count of 0 means the code is longer than the
+    // table's index bits
+    static constexpr int kCountShift = 17;
+    static constexpr int kLengthShift = 19;
+
+    static uint32_t symbol(uint32_t entry) { return entry & 511; }
+    static uint32_t second(uint32_t entry) { return (entry >> 9) & 255; }
+    static uint32_t count(uint32_t entry) { return (entry >> kCountShift) & 3; }
+    static int length(uint32_t entry) { return static_cast<int>(entry >> kLengthShift); }
+
+    // The lookup indexes min(kFastBits, longest code) bits, so tables with
+    // short codes (code lengths, small distance alphabets) build fast
+    uint32_t fast[1 << kFastBits];
+    uint32_t mask = kFastMask;
+    int fastBits = kFastBits;
+    uint16_t firstCode[16];
+    uint16_t firstSymbol[16];
+    uint32_t maxCode[17];              // exclusive, left-aligned to 16 bits
+    uint8_t size[288];
+    uint16_t value[288];
+
+    static int reverse(int v, int bits) {
+        int r = 0;
+        for (int i = 0; i < bits; ++i) {
+            r = (r << 1) | (v & 1);
+            v >>= 1;
+        }
+        return r;
+    }
+
+    void build(const uint8_t* lengths, int count, bool pairs = false) {
+        int sizes[17] = {0};
+        int nextCode[16];
+        for (int i = 0; i < count; ++i) ++sizes[lengths[i]];
+        sizes[0] = 0;
+        int longest = 1;
+        for (int i = 1; i < 16; ++i) {
+            if (sizes[i]) longest = i;
+        }
+        fastBits = std::min(longest, kFastBits);
+        mask = (1u << fastBits) - 1;
+        std::memset(fast, 0, sizeof(uint32_t) << fastBits);
+        for (int i = 1; i < 16; ++i) {
+            if (sizes[i] > (1 << i)) corrupt("bad code lengths");
+        }
+        int code = 0, k = 0;
+        for (int i = 1; i < 16; ++i) {
+            nextCode[i] = code;
+            firstCode[i] = static_cast<uint16_t>(code);
+            firstSymbol[i] = static_cast<uint16_t>(k);
+            code += sizes[i];
+            if (sizes[i] && code - 1 >= (1 << i)) corrupt("bad code lengths");
+            maxCode[i] = static_cast<uint32_t>(code) << (16 - i);
+            code <<= 1;
+            k += sizes[i];
+        }
+        maxCode[16] = 0x10000;
+        for (int i = 0; i < count; ++i) {
+            int s = lengths[i];
+            if (!s) continue;
+            int c = nextCode[s] - firstCode[s] + firstSymbol[s];
+            size[c] = static_cast<uint8_t>(s);
+            value[c] = static_cast<uint16_t>(i);
+            if (s <= fastBits) {
+                uint32_t entry = (uint32_t(s) << kLengthShift) | (1u << kCountShift) | uint32_t(i);
+                for (int j = reverse(nextCode[s], s); j < (1 << fastBits); j += 1 << s) {
+                    fast[j] = entry;
+                }
+            }
+            ++nextCode[s];
+        }
+        if (pairs) {
+            buildPairs();
+        }
+    }
+
+private:
+    // Merge each literal with the literal whose code follows it in the
+    // remaining lookup bits. Walking down means fast[j >> s1], a lower index,
+    // still holds its single-symbol entry when it is read.
+    void buildPairs() {
+        for (int j = (1 << fastBits) - 1; j >= 0; --j) {
+            uint32_t first = fast[j];
+            if (!count(first) || symbol(first) >= 256) continue;
+            int s1 = length(first);
+            uint32_t next = fast[j >> s1];
+            if (!count(next) || symbol(next) >= 256 || length(next) > fastBits - s1) continue;
+            fast[j] = (uint32_t(s1 + length(next)) << kLengthShift) | (2u << kCountShift) |
+                      (symbol(next) << 9) | symbol(first);
+        }
+    }
+};
+
+// Fixed Huffman codes of block type 1, built once
+struct FixedTables {
+    Huffman literal;
+    Huffman distance;
+
+    FixedTables() {
+        uint8_t lengths[288 + 32];
+        std::memset(lengths, 8, 144);
+        std::memset(lengths + 144, 9, 112);
+        std::memset(lengths + 256, 7, 24);
+        std::memset(lengths + 280, 8, 8);
+        std::memset(lengths + 288, 5, 32);
+        literal.build(lengths, 288, true);
+        distance.build(lengths + 288, 32);
+    }
+
+    static const FixedTables& get() {
+        static const FixedTables tables;
+        return tables;
+    }
+};
+
+uint64_t loadLe64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v |= uint64_t(p[i]) << (8 * i);
+    return v;
+}
+
+// Streaming zlib/DEFLATE decoder writing into a sliding window
+template <typename Consumer>
+class Inflater {
+public:
+    // `expectedBytes` is the inflated size the image needs; small images get
+    // a window buffer sized to fit instead of the full one
+    Inflater(IdatStream& source, Consumer& consumer, size_t expectedBytes)
+        : source_(source), consumer_(consumer),
+          capacity_(std::min(kBuffer, expectedBytes + kWindow + kMaxMatch)),
+          input_(new uint8_t[kInput]), out_(new uint8_t[capacity_ + kSlack]) {}
+
+    void run() {
+        int cmf = static_cast<int>(bits(8));
+        int flg = static_cast<int>(bits(8));
+        if ((cmf & 15) != 8 || ((cmf << 8) | flg) % 31 != 0 || (flg & 32)) {
+            corrupt("bad zlib header");
+        }
+
+        bool final = false;
+        while (!final) {
+            final = bits(1) != 0;
+            int type = static_cast<int>(bits(2));
+            if (type == 0) {
+                storedBlock();
+            } else if (type == 1) {
+                const FixedTables& fixed = FixedTables::get();
+                compressedBlock(fixed.literal, fixed.distance);
+            } else if (type == 2) {
+                readDynamicTables();
+                compressedBlock(literal_, distance_);
+            } else {
+                corrupt("bad block type");
+            }
+        }
+        flush();
+    }
+
+private:
+    static constexpr size_t kInput = 32768;
+    static constexpr size_t kWindow = 32768;
+    static constexpr size_t kBuffer = kWindow * 4;
+    static constexpr size_t kMaxMatch = 258;
+    // Match copies move 8 bytes at a time and may run this far past the end
+    static constexpr size_t kSlack = 16;
+
+    bool fillInput() {
+        inLen_ = source_.read(input_.get(), kInput);
+        inPos_ = 0;
+        return inLen_ > 0;
+    }
+
+    void refill() {
+        if (inLen_ - inPos_ >= 8) {
+            // Whole-word refill; bytes past the counted bits are the ones
+            // the next refill would load anyway
+            bitBuffer_ |= loadLe64(input_.get() + inPos_) << bitCount_;
+            inPos_ += (63 - bitCount_) >> 3;
+            bitCount_ |= 56;
+            return;
+        }
+        while (bitCount_ <= 56) {
+            if (inPos_ == inLen_ && !fillInput()) {
+                // Past the end: feed zeros, which a valid stream never consumes
+                if (++padding_ > 8) corrupt("truncated image data");
+                bitCount_ += 8;
+                continue;
+            }
+            bitBuffer_ |= static_cast<uint64_t>(input_[inPos_++]) << bitCount_;
+            bitCount_ += 8;
+        }
+    }
+
+    uint32_t bits(int n) {
+        if (bitCount_ < n) refill();
+        uint32_t v = static_cast<uint32_t>(bitBuffer_ & ((uint64_t(1) << n) - 1));
+        bitBuffer_ >>= n;
+        bitCount_ -= n;
+        return v;
+    }
+
+    void consume(int n) {
+        bitBuffer_ >>= n;
+        bitCount_ -= n;
+    }
+
+    int decode(const Huffman& h) {
+        if (bitCount_ < 16) refill();
+        uint32_t entry = h.fast[bitBuffer_ & h.mask];
+        if (Huffman::count(entry)) {
+            consume(Huffman::length(entry));
+            return static_cast<int>(Huffman::symbol(entry));
+        }
+        return decodeSlow(h);
+    }
+
+    // Codes longer than the lookup table; needs 16 bits in the buffer
+    int decodeSlow(const Huffman& h) {
+        int k = Huffman::reverse(static_cast<int>(bitBuffer_ & 0xffff), 16);
+        int s = h.fastBits + 1;
+        while (s < 16 && static_cast<uint32_t>(k) >= h.maxCode[s]) ++s;
+        if (s >= 16) corrupt("bad huffman code");
+        int b = (k >> (16 - s)) - h.firstCode[s] + h.firstSymbol[s];
+        if (b >= 288 || h.size[b] != s) corrupt("bad huffman code");
+        consume(s);
+        return h.value[b];
+    }
+
+    void readDynamicTables() {
+        static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+        int hlit = static_cast<int>(bits(5)) + 257;
+        int hdist = static_cast<int>(bits(5)) + 1;
+        // The fields reach 288 and 32, but RFC 1951 allows only 286 and 30
+        if (hlit > 286 || hdist > 30) corrupt("bad code lengths");
+        int hclen = static_cast<int>(bits(4)) + 4;
+
+        uint8_t codeLengths[19] = {0};
+        for (int i = 0; i < hclen; ++i) codeLengths[order[i]] = static_cast<uint8_t>(bits(3));
+        lengthCode_.build(codeLengths, 19);
+
+        uint8_t lengths[286 + 32];
+        int n = 0;
+        while (n < hlit + hdist) {
+            int c = decode(lengthCode_);
+            if (c < 16) {
+                lengths[n++] = static_cast<uint8_t>(c);
+                continue;
+            }
+            int repeat;
+            uint8_t fill = 0;
+            if (c == 16) {
+                if (n == 0) corrupt("bad code lengths");
+                repeat = 3 + static_cast<int>(bits(2));
+                fill = lengths[n - 1];
+            } else if (c == 17) {
+                repeat = 3 + static_cast<int>(bits(3));
+            } else {
+                repeat = 11 + static_cast<int>(bits(7));
+            }
+            if (n + repeat > hlit + hdist) corrupt("bad code lengths");
+            std::memset(lengths + n, fill, repeat);
+            n += repeat;
+        }
+        literal_.build(lengths, hlit, true);
+        distance_.build(lengths + hlit, hdist);
+    }
+
+    void storedBlock() {
+        // Drop to a byte boundary
+        bits(bitCount_ & 7);
+        uint32_t len = bits(16);
+        uint32_t nlen = bits(16);
+        if ((len ^ 0xffff) != nlen) corrupt("bad stored block");
+
+        // Whole bytes still in the bit buffer come first
+        while (len > 0 && bitCount_ >= 8) {
+            if (pos_ >= capacity_) flush();
+            out_[pos_++] = static_cast<uint8_t>(bits(8));
+            --len;
+        }
+        if (len == 0) {
+            return;
+        }
+
+        // The rest is copied straight from the input
+        bitBuffer_ = 0;
+        while (len > 0) {
+            if (inPos_ == inLen_ && !fillInput()) corrupt("truncated image data");
+            if (pos_ >= capacity_) flush();
+            size_t n = std::min({static_cast<size_t>(len), inLen_ - inPos_, capacity_ - pos_});
+            std::memcpy(out_.get() + pos_, input_.get() + inPos_, n);
+            pos_ += n;
+            inPos_ += n;
+            len -= static_cast<uint32_t>(n);
+        }
+    }
+
+    void compressedBlock(const Huffman& literal, const Huffman& distance) {
+        static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                                35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const uint16_t distBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                              193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                              6145, 8193, 12289, 16385, 24577};
+        static const uint8_t distExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                              7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        for (;;) {
+            if (pos_ + kMaxMatch > capacity_) flush();
+            if (bitCount_ < 16) refill();
+
+            int symbol;
+            uint32_t entry = literal.fast[bitBuffer_ & literal.mask];
+            if (Huffman::count(entry)) {
+                consume(Huffman::length(entry));
+                symbol = static_cast<int>(Huffman::symbol(entry));
+                if (symbol < 256) {
+                    out_[pos_++] = static_cast<uint8_t>(symbol);
+                    if (Huffman::count(entry) == 2) {
+                        out_[pos_++] = static_cast<uint8_t>(Huffman::second(entry));
+                    }
+                    continue;
+                }
+            } else {
+                symbol = decodeSlow(literal);
+                if (symbol < 256) {
+                    out_[pos_++] = static_cast<uint8_t>(symbol);
+                    continue;
+                }
+            }
+            if (symbol == 256) {
+                return;
+            }
+            symbol -= 257;
+            if (symbol >= 29) corrupt("bad length code");
+            size_t length = lengthBase[symbol] + bits(lengthExtra[symbol]);
+            int d = decode(distance);
+            if (d >= 30) corrupt("bad distance code");
+            size_t dist = distBase[d] + bits(distExtra[d]);
+            if (dist > produced_ + (pos_ - flushed_)) corrupt("bad distance");
+
+            uint8_t* dst = out_.get() + pos_;
+            const uint8_t* src = dst - dist;
+            if (dist >= 8) {
+                // Non-overlapping 8-byte steps; may write into the slack
+                for (size_t i = 0; i < length; i += 8) std::memcpy(dst + i, src + i, 8);
+            } else if (dist == 1) {
+                std::memset(dst, *src, length);
+            } else {
+                for (size_t i = 0; i < length; ++i) dst[i] = src[i];
+            }
+            pos_ += length;
+        }
+    }
+
+    // Hand new output to the consumer and slide the window
+    void flush() {
+        if (pos_ > flushed_) {
+            consumer_.feed(out_.get() + flushed_, pos_ - flushed_);
+            produced_ += pos_ - flushed_;
+        }
+        if (pos_ > kWindow) {
+            std::memmove(out_.get(), out_.get() + pos_ - kWindow, kWindow);
+            pos_ = kWindow;
+        }
+        flushed_ = pos_;
+    }
+
+    IdatStream& source_;
+    Consumer& consumer_;
+    const size_t capacity_;
+
+    std::unique_ptr<uint8_t[]> input_;
+    size_t inPos_ = 0;
+    size_t inLen_ = 0;
+    int padding_ = 0;
+    uint64_t bitBuffer_ = 0;
+    int bitCount_ = 0;
+
+    std::unique_ptr<uint8_t[]> out_;
+    size_t pos_ = 0;
+    size_t flushed_ = 0;
+    size_t produced_ = 0;
+
+    Huffman literal_;
+    Huffman distance_;
+    Huffman lengthCode_;
+};
+
+bool decodeStream(ByteInput& in, RowSink& sink, int chunkRows) {
+    PngHeader header;
+    if (!readHeader(in, header)) {
+        return false;
+    }
+
+    IdatStream idat(in, header.firstIdatLength);
+    ScanlineAssembler assembler(header, sink, chunkRows);
+    size_t expectedBytes = (header.rawRowBytes() + 1) * header.height;
+    auto inflater = std::make_unique<Inflater<ScanlineAssembler>>(idat, assembler, expectedBytes);
+    inflater->run();
+    assembler.finish();
+    return true;
+}
+
+} // namespace
+
+PngStreamDecoder::PngStreamDecoder(int chunkRows)
+    : chunkRows_(chunkRows) {
+}
+
+bool PngStreamDecoder::decode(const std::string& path, RowSink& sink) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    FileInput input(file);
+    return decodeStream(input, sink, chunkRows_);
+}
+
+bool PngStreamDecoder::decode(const uint8_t* data, size_t size, RowSink& sink) {
+    MemoryInput input(data, size);
+    return decodeStream(input, sink, chunkRows_);
+}
@@ -0,0 +1,311 @@
+#include "potrace_process.h"
+#include "arena.h"
+#include <cstdlib>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#else
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+// pipe2() creates both ends close-on-exec atomically; elsewhere the flag is
+// set after pipe() returns
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+#define POTRACE_PIPE2 1
+#else
+#define POTRACE_PIPE2 0
+#endif
+#endif
+
+namespace {
+
+#ifdef _WIN32
+constexpr char kPathSeparator = ';';
+constexpr const char* kExecutable = "potrace.exe";
+#else
+constexpr char kPathSeparator = ':';
+constexpr const char* kExecutable = "potrace";
+#endif
+
+bool isExecutable(const std::string& path) {
+#ifdef _WIN32
+    std::error_code ec;
+    return std::filesystem::is_regular_file(path, ec);
+#else
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(path.c_str(), X_OK) == 0;
+#endif
+}
+
+// Same lookup the shell's `which` does, without starting a shell
+bool findOnPath() {
+    const char* env = std::getenv("PATH");
+    std::string path = env ? env : "/usr/bin:/bin";
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t end = path.find(kPathSeparator, start);
+        if (end == std::string::npos) end = path.size();
+        std::string dir = path.substr(start, end - start);
+        if (dir.empty()) dir = ".";
+        if (isExecutable(dir + "/" + kExecutable)) {
+            return true;
+        }
+        start = end + 1;
+    }
+    return false;
+}
+
+#ifndef _WIN32
+
+void closeFd(int& fd) {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+// Pipe with both ends close-on-exec, so only the dup2'd copies reach a child
+bool closeOnExecPipe(int fds[2]) {
+#if POTRACE_PIPE2
+    return pipe2(fds, O_CLOEXEC) == 0;
+#else
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#endif
+}
+
+// Blocks SIGPIPE on this thread while writing to potrace, so a dying child
+// shows up as EPIPE instead of killing the converter. A SIGPIPE raised in
+// the meantime is consumed before the mask is restored.
+class SigpipeGuard {
+public:
+    SigpipeGuard() {
+        sigemptyset(&set_);
+        sigaddset(&set_, SIGPIPE);
+        sigset_t pending;
+        sigpending(&pending);
+        wasPending_ = sigismember(&pending, SIGPIPE) == 1;
+        pthread_sigmask(SIG_BLOCK, &set_, &previous_);
+    }
+
+    ~SigpipeGuard() {
+        if (!wasPending_) {
+            sigset_t pending;
+            sigpending(&pending);
+            if (sigismember(&pending, SIGPIPE) == 1) {
+#ifdef __APPLE__
+                int sig;
+                sigwait(&set_, &sig);
+#else
+                timespec zero{0, 0};
+                sigtimedwait(&set_, nullptr, &zero);
+#endif
+            }
+        }
+        pthread_sigmask(SIG_SETMASK, &previous_, nullptr);
+    }
+
+private:
+    sigset_t set_;
+    sigset_t previous_;
+    bool wasPending_ = false;
+};
+
+#endif
+
+} // namespace
+
+bool PotraceProcess::available() {
+    static std::once_flag once;
+    static bool found = false;
+    std::call_once(once, [] { found = findOnPath(); });
+    return found;
+}
+
+#ifndef _WIN32
+
+PotraceProcess::PotraceProcess()
+    : output_(JobArena::current()) {
+#if !POTRACE_PIPE2
+    // Without pipe2() the pipes become close-on-exec only after pipe()
+    // returns; serialize with other spawns so no concurrent potrace inherits
+    // our write end and keeps its reader from ever seeing EOF
+    static std::mutex spawnMutex;
+    std::lock_guard<std::mutex> lock(spawnMutex);
+#endif
+
+    int in[2], out[2];
+    if (!closeOnExecPipe(in)) {
+        throw std::runtime_error("Failed to create pipe for potrace");
+    }
+    if (!closeOnExecPipe(out)) {
+        close(in[0]);
+        close(in[1]);
+        throw std::runtime_error("Failed to create pipe for potrace");
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+
+    const char* argv[] = {"potrace", "-", "-s", "-o", "-", "--opttolerance", "0.5", nullptr};
+    pid_t pid;
+    int rc = posix_spawnp(&pid, "potrace", &actions, nullptr, const_cast<char* const*>(argv), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(in[0]);
+    close(out[1]);
+    if (rc != 0) {
+        close(in[1]);
+        close(out[0]);
+        throw std::runtime_error(std::string("Failed to start potrace: ") + std::strerror(rc));
+    }
+
+    pid_ = pid;
+    stdin_ = in[1];
+    stdout_ = out[0];
+    fcntl(stdin_, F_SETFL, fcntl(stdin_, F_GETFL) | O_NONBLOCK);
+    fcntl(stdout_, F_SETFL, fcntl(stdout_, F_GETFL) | O_NONBLOCK);
+}
+
+PotraceProcess::~PotraceProcess() {
+    closeFd(stdin_);
+    closeFd(stdout_);
+    if (pid_ > 0) {
+        kill(pid_, SIGKILL);
+        while (waitpid(pid_, nullptr, 0) < 0 && errno == EINTR) {}
+    }
+}
+
+void PotraceProcess::readAvailable() {
+    char buffer[64 * 1024];
+    while (stdout_ >= 0) {
+        ssize_t n = read(stdout_, buffer, sizeof(buffer));
+        if (n > 0) {
+            output_.append(buffer, static_cast<size_t>(n));
+        } else if (n == 0) {
+            closeFd(stdout_);
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;
+        } else {
+            throw std::runtime_error("Failed to read potrace output");
+        }
+    }
+}
+
+void PotraceProcess::write(const void* data, size_t size) {
+    SigpipeGuard guard;
+    const char* p = static_cast<const char*>(data);
+    while (size > 0 && !broken_) {
+        pollfd fds[2] = {{stdin_, POLLOUT, 0}, {stdout_, POLLIN, 0}};
+        // Keep draining stdout so potrace never blocks on a full pipe
+        int count = stdout_ >= 0 ? 2 : 1;
+        if (poll(fds, count, -1) < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("poll failed while feeding potrace");
+        }
+        if (count == 2 && (fds[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+            readAvailable();
+        }
+        if (fds[0].revents & (POLLOUT | POLLERR | POLLHUP)) {
+            ssize_t n = ::write(stdin_, p, size);
+            if (n > 0) {
+                p += n;
+                size -= static_cast<size_t>(n);
+            } else if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+                // potrace exited early; finish() reports it
+                broken_ = true;
+            }
+        }
+    }
+}
+
+std::pmr::string PotraceProcess::finish() {
+    closeFd(stdin_);
+    while (stdout_ >= 0) {
+        pollfd fd = {stdout_, POLLIN, 0};
+        if (poll(&fd, 1, -1) < 0 && errno != EINTR) {
+            throw std::runtime_error("poll failed while reading potrace output");
+        }
+        readAvailable();
+    }
+
+    int status = 0;
+    struct rusage usage;
+    while (wait4(pid_, &status, 0, &usage) < 0) {
+        if (errno != EINTR) {
+            throw std::runtime_error("Failed to wait for potrace");
+        }
+    }
+    pid_ = -1;
+    cpuMs_ = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+             (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+    if (broken_ || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw std::runtime_error("Potrace failed");
+    }
+    return std::move(output_);
+}
+
+#else
+
+// No posix_spawn here: the bitmap is collected in memory and potrace runs
+// through the shell on uniquely named temporary files
+PotraceProcess::PotraceProcess()
+    : output_(JobArena::current()) {}
+
+PotraceProcess::~PotraceProcess() = default;
+
+void PotraceProcess::write(const void* data, size_t size) {
+    input_.append(static_cast<const char*>(data), size);
+}
+
+std::pmr::string PotraceProcess::finish() {
+    static std::atomic<unsigned> counter{0};
+    namespace fs = std::filesystem;
+    std::string stem = "png2svg-" + std::to_string(counter++) + "-" +
+                       std::to_string(reinterpret_cast<uintptr_t>(this));
+    fs::path inputPath = fs::temp_directory_path() / (stem + ".pbm");
+    fs::path outputPath = fs::temp_directory_path() / (stem + ".svg");
+
+    std::ofstream(inputPath, std::ios::binary).write(input_.data(), input_.size());
+    std::string command = "potrace \"" + inputPath.string() + "\" -s -o \"" +
+                          outputPath.string() + "\" --opttolerance 0.5";
+    int result = std::system(command.c_str());
+    if (result == 0) {
+        std::ifstream in(outputPath, std::ios::binary);
+        output_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    std::error_code ec;
+    fs::remove(inputPath, ec);
+    fs::remove(outputPath, ec);
+    if (result != 0) {
+        throw std::runtime_error("Potrace failed");
+    }
+    return std::move(output_);
+}
+
+#endif
@@ -0,0 +1,165 @@
+#include "scratch_space.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstdlib>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t kPageSize = 4096;
+
+std::atomic<size_t> gResidentLimit{0};
+std::mutex gDirectoryMutex;
+std::string gDirectory;
+
+thread_local bool tActive = false;
+
+// Live scratch mappings (start -> length), so the advice calls never touch
+// anonymous memory, where MADV_DONTNEED would discard data
+std::mutex gMappingsMutex;
+std::map<uintptr_t, size_t> gMappings;
+
+bool isMapped(const void* p, size_t bytes) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(p);
+    std::lock_guard<std::mutex> lock(gMappingsMutex);
+    auto it = gMappings.upper_bound(address);
+    if (it == gMappings.begin()) return false;
+    --it;
+    return address + bytes <= it->first + it->second;
+}
+
+size_t pageRound(size_t bytes) {
+    return (bytes + kPageSize - 1) & ~(kPageSize - 1);
+}
+
+// Largest page-aligned range inside [p, p + bytes)
+bool innerPages(const void* p, size_t bytes, void*& start, size_t& length) {
+    uintptr_t first = (reinterpret_cast<uintptr_t>(p) + kPageSize - 1) & ~(kPageSize - 1);
+    uintptr_t last = (reinterpret_cast<uintptr_t>(p) + bytes) & ~(kPageSize - 1);
+    if (last <= first) return false;
+    start = reinterpret_cast<void*>(first);
+    length = last - first;
+    return true;
+}
+
+std::string scratchDirectory() {
+    std::lock_guard<std::mutex> lock(gDirectoryMutex);
+    return gDirectory.empty() ? fs::temp_directory_path().string() : gDirectory;
+}
+
+} // namespace
+
+void ScratchSpace::configure(size_t residentLimit, const std::string& directory) {
+    gResidentLimit.store(residentLimit, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(gDirectoryMutex);
+    gDirectory = directory;
+}
+
+size_t ScratchSpace::residentLimit() {
+    return gResidentLimit.load(std::memory_order_relaxed);
+}
+
+bool ScratchSpace::exceedsLimit(size_t bytes) {
+    size_t limit = residentLimit();
+    return limit > 0 && bytes > limit;
+}
+
+int ScratchSpace::stripRows(size_t rowBytes) {
+    size_t limit = residentLimit();
+    if (limit == 0 || rowBytes == 0) {
+        return 1 << 30;
+    }
+    return static_cast<int>(std::clamp<size_t>(limit / rowBytes, 1, 1 << 30));
+}
+
+bool ScratchSpace::active() {
+    return tActive;
+}
+
+#ifndef _WIN32
+
+void* ScratchSpace::map(size_t bytes) {
+    std::string pattern = (fs::path(scratchDirectory()) / "png2svg-scratch-XXXXXX").string();
+    std::vector<char> name(pattern.begin(), pattern.end());
+    name.push_back('\0');
+
+    int fd = mkstemp(name.data());
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create scratch file in " + scratchDirectory());
+    }
+    // The mapping keeps the file alive; nothing is left behind on exit
+    unlink(name.data());
+
+    size_t length = pageRound(bytes);
+    if (ftruncate(fd, static_cast<off_t>(length)) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to size scratch file (disk full?)");
+    }
+    void* p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        throw std::runtime_error("Failed to map scratch file");
+    }
+    std::lock_guard<std::mutex> lock(gMappingsMutex);
+    gMappings[reinterpret_cast<uintptr_t>(p)] = length;
+    return p;
+}
+
+void ScratchSpace::unmap(void* p, size_t bytes) {
+    if (!p) return;
+    {
+        std::lock_guard<std::mutex> lock(gMappingsMutex);
+        gMappings.erase(reinterpret_cast<uintptr_t>(p));
+    }
+    munmap(p, pageRound(bytes));
+}
+
+void ScratchSpace::adviseSequential(const void* p, size_t bytes) {
+    void* start;
+    size_t length;
+    if (isMapped(p, bytes) && innerPages(p, bytes, start, length)) {
+        madvise(start, length, MADV_SEQUENTIAL);
+    }
+}
+
+void ScratchSpace::dropResident(const void* p, size_t bytes) {
+    void* start;
+    size_t length;
+    if (isMapped(p, bytes) && innerPages(p, bytes, start, length)) {
+        // Shared file pages stay in the scratch file; only the mapping is dropped
+        madvise(start, length, MADV_DONTNEED);
+    }
+}
+
+#else
+
+void* ScratchSpace::map(size_t) {
+    throw std::runtime_error("Out-of-core mode is not supported on this platform");
+}
+
+void ScratchSpace::unmap(void*, size_t) {}
+void ScratchSpace::adviseSequential(const void*, size_t) {}
+void ScratchSpace::dropResident(const void*, size_t) {}
+
+#endif
+
+ScratchScope::ScratchScope(bool enable)
+    : previous_(tActive) {
+    tActive = tActive || enable;
+}
+
+ScratchScope::~ScratchScope() {
+    tActive = previous_;
+}
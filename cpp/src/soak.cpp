@@ -0,0 +1,459 @@
+#include "soak.h"
+#include "bench.h"
+#include "buffer_pool.h"
+#include "complexity.h"
+#include "logger.h"
+#include "metrics.h"
+#include "scratch_space.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Value of a "Key:   123 kB" line of /proc/self/status, or -1
+double procStatus(const char* key) {
+#if defined(__linux__)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    size_t length = std::char_traits<char>::length(key);
+    while (std::getline(status, line)) {
+        if (line.compare(0, length, key) == 0 && line.size() > length && line[length] == ':') {
+            return std::stod(line.substr(length + 1));
+        }
+    }
+#else
+    (void)key;
+#endif
+    return -1;
+}
+
+double residentBytes() {
+    double kb = procStatus("VmRSS");
+    return kb < 0 ? 0 : kb * 1024;
+}
+
+int threadCount() {
+    return static_cast<int>(procStatus("Threads"));
+}
+
+int openFds() {
+    for (const char* dir : {"/proc/self/fd", "/dev/fd"}) {
+        std::error_code error;
+        fs::directory_iterator it(dir, error);
+        if (error) {
+            continue;
+        }
+        int count = 0;
+        for (; it != fs::directory_iterator(); it.increment(error)) {
+            ++count;
+        }
+        return count;
+    }
+    return -1;
+}
+
+// Nearest rank, q in [0, 1]; sorts `values`
+double percentile(std::vector<double>& values, double q) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(std::ceil(q * values.size()));
+    return values[std::min(values.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+// Latency buckets 5% apart from 50 us to about 17 minutes. A sample keeps
+// only the counts, so memory does not grow with the conversions of an
+// interval, and a percentile read back is within half a bucket.
+const std::vector<double>& latencyBounds() {
+    static const std::vector<double> bounds = [] {
+        std::vector<double> b;
+        for (double ms = 0.05; ms < 1e6; ms *= 1.05) b.push_back(ms);
+        return b;
+    }();
+    return bounds;
+}
+
+// Nearest rank over bucketed latencies, q in [0, 1]; a bucket reads as the
+// geometric middle of its bounds
+double percentile(const std::vector<uint64_t>& counts, double q) {
+    uint64_t total = 0;
+    for (uint64_t count : counts) total += count;
+    if (total == 0) {
+        return 0;
+    }
+    const std::vector<double>& bounds = latencyBounds();
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * total)));
+    size_t i = 0;
+    for (uint64_t seen = 0; i + 1 < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) break;
+    }
+    if (i == 0) return bounds.front();
+    if (i >= bounds.size()) return bounds.back();
+    return std::sqrt(bounds[i - 1] * bounds[i]);
+}
+
+template <typename Field>
+double median(const std::vector<SoakSample>& samples, size_t begin, size_t end, Field field) {
+    std::vector<double> values;
+    for (size_t i = begin; i < end; ++i) {
+        values.push_back(static_cast<double>(field(samples[i])));
+    }
+    return percentile(values, 0.5);
+}
+
+std::string formatMB(double bytes) {
+    char text[32];
+    if (bytes <= 0) {
+        std::snprintf(text, sizeof(text), "-");
+    } else {
+        std::snprintf(text, sizeof(text), "%.1f MB", bytes / (1024.0 * 1024));
+    }
+    return text;
+}
+
+// "90", "90s", "15m", "8h", "2d" in seconds
+double parseDuration(const std::string& text) {
+    size_t used = 0;
+    double value = std::stod(text, &used);
+    std::string unit = text.substr(used);
+    if (unit.empty() || unit == "s") return value;
+    if (unit == "m") return value * 60;
+    if (unit == "h") return value * 3600;
+    if (unit == "d") return value * 86400;
+    throw std::invalid_argument("未知的时间单位: " + text);
+}
+
+void showSoakUsage() {
+    std::cout << R"(
+用法: png2svg soak <目录> [选项]
+
+长时间运行测试：在内存中循环转换目录里的PNG（每轮起点后移一张），按固定间隔
+采样吞吐量、延迟、常驻内存、打开的文件描述符与线程数。结束时比较预热后前1/4与
+后1/4的样本，内存、延迟、描述符或线程数的增长超过上限时以状态码1退出。
+
+选项:
+  --duration T    运行时长，如 90s、30m、8h、2d（默认: 1h）
+  --interval T    采样间隔（默认: 10s）
+  --warmup PCT    判断漂移时忽略开头PCT%的样本（默认: 10）
+  --threads N     转换线程数（默认: 1）
+  --option N      使用第N个矢量化选项（默认: 0）
+  --samples FILE  把每个样本写入CSV文件（逐行刷新）
+  --max-rss-growth PCT
+                  常驻内存增长上限（默认: 10）
+  --max-latency-growth PCT
+                  延迟中位数增长上限（默认: 25）
+  --max-fd-growth N
+                  打开的文件描述符增长上限（默认: 4）
+  --max-thread-growth N
+                  线程数增长上限（默认: 0）
+  --huge-pages, --max-resident MB, --max-edges N, --max-components N,
+  --complexity-fallback MODE, --log-level LEVEL, --log-format FORMAT
+                  同转换命令
+  --help, -h      显示此帮助信息
+)" << std::endl;
+}
+
+} // namespace
+
+std::vector<SoakSample> runSoak(const SoakOptions& options, std::ostream& out) {
+    std::vector<CorpusImage> images = loadCorpus(options.corpus);
+    std::ofstream csv;
+    if (!options.samplesPath.empty()) {
+        csv.open(options.samplesPath);
+        if (!csv) {
+            throw std::runtime_error("无法写入: " + options.samplesPath);
+        }
+        csv << "elapsed_s,conversions,failures,images_per_s,p50_ms,p99_ms,rss_bytes,open_fds,threads\n";
+    }
+
+    // Finished conversions of the current interval, handed over at each sample
+    std::mutex mutex;
+    auto latencies = std::make_unique<Histogram>(latencyBounds());
+    size_t failures = 0;
+
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        while (!stop.load(std::memory_order_relaxed)) {
+            size_t i = next.fetch_add(1, std::memory_order_relaxed);
+            const CorpusImage& image = images[(i + i / images.size()) % images.size()];
+            Conversion result;
+            convertCorpusImage(image, options.optionIndex, result);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (result.ok) {
+                latencies->observe(result.ms);
+            } else {
+                failures++;
+            }
+        }
+    };
+
+    out << "长时间运行: " << images.size() << " 张图片, " << options.threads << " 线程, "
+        << options.durationSeconds << " 秒, 每 " << options.intervalSeconds << " 秒采样" << std::endl;
+    char line[160];
+    std::snprintf(line, sizeof(line), "%9s %9s %9s %9s %11s %6s %8s %9s", "elapsed", "images/s", "p50 ms",
+                  "p99 ms", "RSS", "fds", "threads", "failures");
+    out << line << std::endl;
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < options.threads; ++t) {
+        workers.emplace_back(work);
+    }
+
+    std::vector<SoakSample> samples;
+    for (int k = 1;; ++k) {
+        double due = std::min(k * options.intervalSeconds, options.durationSeconds);
+        std::this_thread::sleep_until(
+            start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(due)));
+        SoakSample sample;
+        auto interval = std::make_unique<Histogram>(latencyBounds());
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            interval.swap(latencies);
+            sample.failures = failures;
+            failures = 0;
+        }
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        double previous = samples.empty() ? 0 : samples.back().elapsedSeconds;
+        sample.elapsedSeconds = elapsed;
+        sample.latencyCounts = interval->counts();
+        for (uint64_t count : sample.latencyCounts) sample.conversions += count;
+        sample.imagesPerSecond = elapsed > previous ? sample.conversions / (elapsed - previous) : 0;
+        sample.latencyP50Ms = percentile(sample.latencyCounts, 0.5);
+        sample.latencyP99Ms = percentile(sample.latencyCounts, 0.99);
+        sample.residentBytes = residentBytes();
+        sample.openFds = openFds();
+        sample.threads = threadCount();
+
+        std::snprintf(line, sizeof(line), "%8.1fs %9.2f %9.1f %9.1f %11s %6d %8d %9zu", sample.elapsedSeconds,
+                      sample.imagesPerSecond, sample.latencyP50Ms, sample.latencyP99Ms,
+                      formatMB(sample.residentBytes).c_str(), sample.openFds, sample.threads, sample.failures);
+        out << line << std::endl;
+        if (csv) {
+            csv << sample.elapsedSeconds << ',' << sample.conversions << ',' << sample.failures << ','
+                << sample.imagesPerSecond << ',' << sample.latencyP50Ms << ',' << sample.latencyP99Ms << ','
+                << static_cast<uint64_t>(sample.residentBytes) << ',' << sample.openFds << ','
+                << sample.threads << std::endl;
+        }
+        samples.push_back(std::move(sample));
+        if (due >= options.durationSeconds) {
+            break;
+        }
+    }
+
+    // Conversions still running are not counted in any sample
+    stop = true;
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return samples;
+}
+
+std::vector<SoakCheck> evaluateSoak(const SoakOptions& options, const std::vector<SoakSample>& samples) {
+    size_t begin = static_cast<size_t>(std::ceil(options.warmupFraction * samples.size()));
+    if (samples.size() < begin + 4) {
+        return {};
+    }
+    size_t quarter = (samples.size() - begin) / 4;
+    size_t firstEnd = begin + quarter;
+    size_t lastBegin = samples.size() - quarter;
+
+    std::vector<SoakCheck> checks;
+    auto relative = [&](const char* name, double first, double last, double limit) {
+        if (first <= 0) return;
+        SoakCheck check;
+        check.name = name;
+        check.first = first;
+        check.last = last;
+        check.change = (last - first) / first * 100;
+        check.limit = limit;
+        check.failed = check.change > limit;
+        checks.push_back(check);
+    };
+    auto absolute = [&](const char* name, double first, double last, double limit) {
+        if (first < 0 || last < 0) return;
+        SoakCheck check;
+        check.name = name;
+        check.first = first;
+        check.last = last;
+        check.change = last - first;
+        check.limit = limit;
+        check.percent = false;
+        check.failed = check.change > limit;
+        checks.push_back(check);
+    };
+
+    relative("rss", median(samples, begin, firstEnd, [](const SoakSample& s) { return s.residentBytes; }),
+             median(samples, lastBegin, samples.size(), [](const SoakSample& s) { return s.residentBytes; }),
+             options.maxRssGrowthPercent);
+
+    // Latency over every conversion of each quarter, so the image mix of a
+    // single interval does not decide it
+    auto pooled = [&](size_t from, size_t to) {
+        std::vector<uint64_t> all(latencyBounds().size() + 1);
+        for (size_t i = from; i < to; ++i) {
+            for (size_t b = 0; b < samples[i].latencyCounts.size() && b < all.size(); ++b) {
+                all[b] += samples[i].latencyCounts[b];
+            }
+        }
+        return percentile(all, 0.5);
+    };
+    relative("latency p50", pooled(begin, firstEnd), pooled(lastBegin, samples.size()),
+             options.maxLatencyGrowthPercent);
+
+    absolute("open fds", median(samples, begin, firstEnd, [](const SoakSample& s) { return s.openFds; }),
+             median(samples, lastBegin, samples.size(), [](const SoakSample& s) { return s.openFds; }),
+             options.maxFdGrowth);
+    auto maxThreads = [&](size_t from, size_t to) {
+        int most = -1;
+        for (size_t i = from; i < to; ++i) most = std::max(most, samples[i].threads);
+        return static_cast<double>(most);
+    };
+    absolute("threads", maxThreads(begin, firstEnd), maxThreads(lastBegin, samples.size()),
+             options.maxThreadGrowth);
+    return checks;
+}
+
+int soakCommand(int argc, char* argv[]) {
+    SoakOptions options;
+    size_t maxResidentMB = 0;
+    ComplexityLimits complexity;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                showSoakUsage();
+                return 0;
+            } else if (arg == "--duration" && i + 1 < argc) {
+                options.durationSeconds = std::max(1.0, parseDuration(argv[++i]));
+            } else if (arg == "--interval" && i + 1 < argc) {
+                options.intervalSeconds = std::max(0.1, parseDuration(argv[++i]));
+            } else if (arg == "--warmup" && i + 1 < argc) {
+                options.warmupFraction = std::min(90.0, std::max(0.0, std::stod(argv[++i]))) / 100;
+            } else if (arg == "--threads" && i + 1 < argc) {
+                options.threads = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--option" && i + 1 < argc) {
+                options.optionIndex = std::stoi(argv[++i]);
+            } else if (arg == "--samples" && i + 1 < argc) {
+                options.samplesPath = argv[++i];
+            } else if (arg == "--max-rss-growth" && i + 1 < argc) {
+                options.maxRssGrowthPercent = std::stod(argv[++i]);
+            } else if (arg == "--max-latency-growth" && i + 1 < argc) {
+                options.maxLatencyGrowthPercent = std::stod(argv[++i]);
+            } else if (arg == "--max-fd-growth" && i + 1 < argc) {
+                options.maxFdGrowth = std::stoi(argv[++i]);
+            } else if (arg == "--max-thread-growth" && i + 1 < argc) {
+                options.maxThreadGrowth = std::stoi(argv[++i]);
+            } else if (arg == "--huge-pages") {
+                BufferPool::setHugePages(true);
+            } else if (arg == "--max-resident" && i + 1 < argc) {
+                maxResidentMB = std::stoul(argv[++i]);
+            } else if (arg == "--max-edges" && i + 1 < argc) {
+                complexity.maxEdges = std::stoull(argv[++i]);
+            } else if (arg == "--max-components" && i + 1 < argc) {
+                complexity.maxComponents = std::stoull(argv[++i]);
+            } else if (arg == "--complexity-fallback" && i + 1 < argc) {
+                if (!ComplexityGuard::parseFallback(argv[++i], complexity.fallback)) {
+                    std::cerr << "错误: 未知的降级方式 - " << argv[i] << std::endl;
+                    return 1;
+                }
+            } else if (arg == "--log-level" && i + 1 < argc) {
+                LogLevel level;
+                if (!Logger::parseLevel(argv[++i], level)) {
+                    std::cerr << "错误: 未知的日志级别 - " << argv[i] << std::endl;
+                    return 1;
+                }
+                Logger::setLevel(level);
+            } else if (arg == "--log-format" && i + 1 < argc) {
+                LogFormat format;
+                if (!Logger::parseFormat(argv[++i], format)) {
+                    std::cerr << "错误: 未知的日志格式 - " << argv[i] << std::endl;
+                    return 1;
+                }
+                Logger::setFormat(format);
+            } else if (options.corpus.empty() && arg[0] != '-') {
+                options.corpus = arg;
+            } else {
+                std::cerr << "错误: 未知的参数 - " << arg << std::endl;
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "错误: 参数无效 - " << e.what() << std::endl;
+        return 1;
+    }
+    if (options.corpus.empty()) {
+        showSoakUsage();
+        return 1;
+    }
+    ScratchSpace::configure(maxResidentMB << 20);
+    ComplexityGuard::configure(complexity);
+
+    std::vector<SoakSample> samples;
+    try {
+        samples = runSoak(options, std::cout);
+    } catch (const std::exception& e) {
+        logError("soak_failed").field("error", e.what()) << "错误: " << e.what();
+        Logger::flush();
+        return 1;
+    }
+
+    size_t conversions = 0, failures = 0;
+    for (const SoakSample& sample : samples) {
+        conversions += sample.conversions;
+        failures += sample.failures;
+    }
+    std::cout << std::endl << "共转换 " << conversions << " 次, 失败 " << failures << " 次" << std::endl;
+
+    std::vector<SoakCheck> checks = evaluateSoak(options, samples);
+    if (checks.empty()) {
+        std::cout << "样本太少，无法判断漂移（预热后至少需要4个样本；加长 --duration 或缩短 --interval）"
+                  << std::endl;
+        Logger::flush();
+        return 0;
+    }
+
+    std::cout << std::endl << "漂移检查 (预热后前1/4 对比 后1/4):" << std::endl;
+    char line[160];
+    std::snprintf(line, sizeof(line), "  %-12s %12s %12s %10s %10s  %s", "check", "first", "last", "change",
+                  "limit", "result");
+    std::cout << line << std::endl;
+    int failed = 0;
+    for (const SoakCheck& check : checks) {
+        std::string first, last;
+        if (check.name == "rss") {
+            first = formatMB(check.first);
+            last = formatMB(check.last);
+        } else {
+            char value[32];
+            std::snprintf(value, sizeof(value), "%.1f", check.first);
+            first = value;
+            std::snprintf(value, sizeof(value), "%.1f", check.last);
+            last = value;
+        }
+        std::snprintf(line, sizeof(line), "  %-12s %12s %12s %+9.1f%s %9.1f%s  %s", check.name.c_str(),
+                      first.c_str(), last.c_str(), check.change, check.percent ? "%" : " ", check.limit,
+                      check.percent ? "%" : " ", check.failed ? "失败" : "通过");
+        std::cout << line << std::endl;
+        failed += check.failed;
+    }
+    Logger::flush();
+    return failed > 0 ? 1 : 0;
+}
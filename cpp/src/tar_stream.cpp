@@ -0,0 +1,287 @@
+#include "tar_stream.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t kBlock = 512;
+
+// Header field offsets and lengths (POSIX ustar)
+constexpr size_t kNameOffset = 0, kNameLength = 100;
+constexpr size_t kModeOffset = 100;
+constexpr size_t kUidOffset = 108;
+constexpr size_t kGidOffset = 116;
+constexpr size_t kSizeOffset = 124, kSizeLength = 12;
+constexpr size_t kMtimeOffset = 136, kMtimeLength = 12;
+constexpr size_t kChecksumOffset = 148, kChecksumLength = 8;
+constexpr size_t kTypeOffset = 156;
+constexpr size_t kMagicOffset = 257;
+constexpr size_t kPrefixOffset = 345, kPrefixLength = 155;
+
+size_t padding(uint64_t size) {
+    return static_cast<size_t>((kBlock - size % kBlock) % kBlock);
+}
+
+std::string field(const char* block, size_t offset, size_t length) {
+    const char* begin = block + offset;
+    return std::string(begin, std::find(begin, begin + length, '\0'));
+}
+
+// Octal with optional space/NUL padding, or GNU base-256 for large values
+uint64_t parseNumber(const char* block, size_t offset, size_t length) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(block + offset);
+    uint64_t value = 0;
+    if (p[0] & 0x80) {
+        value = p[0] & 0x7f;
+        for (size_t i = 1; i < length; ++i) {
+            value = (value << 8) | p[i];
+        }
+        return value;
+    }
+    size_t i = 0;
+    while (i < length && (p[i] == ' ' || p[i] == '\0')) ++i;
+    for (; i < length && p[i] >= '0' && p[i] <= '7'; ++i) {
+        value = (value << 3) | static_cast<uint64_t>(p[i] - '0');
+    }
+    return value;
+}
+
+bool checksumValid(const char* block) {
+    uint64_t expected = parseNumber(block, kChecksumOffset, kChecksumLength);
+    // Historic tars summed signed chars; accept either
+    int64_t unsignedSum = 0, signedSum = 0;
+    for (size_t i = 0; i < kBlock; ++i) {
+        bool inField = i >= kChecksumOffset && i < kChecksumOffset + kChecksumLength;
+        unsignedSum += inField ? ' ' : static_cast<unsigned char>(block[i]);
+        signedSum += inField ? ' ' : static_cast<signed char>(block[i]);
+    }
+    return static_cast<int64_t>(expected) == unsignedSum || static_cast<int64_t>(expected) == signedSum;
+}
+
+bool isZeroBlock(const char* block) {
+    return std::all_of(block, block + kBlock, [](char c) { return c == '\0'; });
+}
+
+void writeOctal(char* block, size_t offset, size_t length, uint64_t value) {
+    // length - 1 digits followed by NUL
+    for (size_t i = length - 1; i-- > 0;) {
+        block[offset + i] = static_cast<char>('0' + (value & 7));
+        value >>= 3;
+    }
+    block[offset + length - 1] = '\0';
+    if (value != 0) {
+        throw std::runtime_error("Tar field overflow");
+    }
+}
+
+// Split a name into ustar prefix and name fields; false if it cannot fit
+bool splitName(const std::string& name, std::string& prefix, std::string& base) {
+    if (name.size() <= kNameLength) {
+        prefix.clear();
+        base = name;
+        return !name.empty();
+    }
+    // The last '/' that keeps the prefix short enough leaves the shortest name
+    size_t slash = name.rfind('/', kPrefixLength);
+    if (slash == std::string::npos || slash == 0 || name.size() - slash - 1 > kNameLength ||
+        slash + 1 == name.size()) {
+        return false;
+    }
+    prefix = name.substr(0, slash);
+    base = name.substr(slash + 1);
+    return true;
+}
+
+// Apply "len key=value\n" records from a pax extended header
+void applyPax(const std::vector<uint8_t>& data, std::string& path, uint64_t& size, bool& hasSize) {
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t space = pos;
+        while (space < data.size() && data[space] != ' ') ++space;
+        size_t length = 0;
+        for (size_t i = pos; i < space; ++i) {
+            if (data[i] < '0' || data[i] > '9') throw std::runtime_error("Corrupt tar: bad pax record");
+            length = length * 10 + (data[i] - '0');
+        }
+        if (length == 0 || pos + length > data.size() || space >= pos + length) {
+            throw std::runtime_error("Corrupt tar: bad pax record");
+        }
+        std::string record(data.begin() + space + 1, data.begin() + pos + length - 1);
+        size_t eq = record.find('=');
+        if (eq != std::string::npos) {
+            std::string key = record.substr(0, eq);
+            if (key == "path") {
+                path = record.substr(eq + 1);
+            } else if (key == "size") {
+                size = std::stoull(record.substr(eq + 1));
+                hasSize = true;
+            }
+        }
+        pos += length;
+    }
+}
+
+} // namespace
+
+bool TarReader::readBlock(char* block) {
+    in_.read(block, kBlock);
+    if (in_.gcount() == 0 && in_.eof()) {
+        return false;
+    }
+    if (in_.gcount() != static_cast<std::streamsize>(kBlock)) {
+        throw std::runtime_error("Corrupt tar: truncated header");
+    }
+    return true;
+}
+
+void TarReader::readData(uint64_t size, std::vector<uint8_t>& data) {
+    data.resize(size);
+    in_.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(size));
+    if (static_cast<uint64_t>(in_.gcount()) != size) {
+        throw std::runtime_error("Corrupt tar: truncated member");
+    }
+    skipData(padding(size));
+}
+
+void TarReader::skipData(uint64_t size) {
+    char buffer[64 * kBlock];
+    while (size > 0) {
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(size, sizeof(buffer)));
+        in_.read(buffer, static_cast<std::streamsize>(chunk));
+        if (static_cast<size_t>(in_.gcount()) != chunk) {
+            throw std::runtime_error("Corrupt tar: truncated member");
+        }
+        size -= chunk;
+    }
+}
+
+bool TarReader::next(TarMember& member) {
+    std::string longName;
+    std::string paxPath;
+    uint64_t paxSize = 0;
+    bool paxHasSize = false;
+    char block[kBlock];
+
+    while (!ended_) {
+        if (!readBlock(block) || isZeroBlock(block)) {
+            // One zero block is enough; some writers omit the second
+            ended_ = true;
+            break;
+        }
+        if (!checksumValid(block)) {
+            throw std::runtime_error("Corrupt tar: bad header checksum");
+        }
+
+        char type = block[kTypeOffset];
+        uint64_t size = parseNumber(block, kSizeOffset, kSizeLength);
+
+        if (type == 'L' || type == 'x') {
+            std::vector<uint8_t> data;
+            readData(size, data);
+            if (type == 'L') {
+                longName.assign(data.begin(), std::find(data.begin(), data.end(), '\0'));
+            } else {
+                applyPax(data, paxPath, paxSize, paxHasSize);
+            }
+            continue;
+        }
+
+        if (paxHasSize) {
+            size = paxSize;
+        }
+        if (type != '0' && type != '\0' && type != '7') {
+            // Directories, links, global pax headers and the like
+            skipData(size + padding(size));
+            longName.clear();
+            paxPath.clear();
+            paxHasSize = false;
+            continue;
+        }
+
+        std::string name;
+        if (!paxPath.empty()) {
+            name = paxPath;
+        } else if (!longName.empty()) {
+            name = longName;
+        } else {
+            name = field(block, kNameOffset, kNameLength);
+            std::string prefix = field(block, kPrefixOffset, kPrefixLength);
+            if (std::memcmp(block + kMagicOffset, "ustar", 5) == 0 && !prefix.empty()) {
+                name = prefix + "/" + name;
+            }
+        }
+
+        member.name = std::move(name);
+        member.mtime = static_cast<int64_t>(parseNumber(block, kMtimeOffset, kMtimeLength));
+        readData(size, member.data);
+        return true;
+    }
+    return false;
+}
+
+void TarWriter::writePadded(const char* data, size_t size) {
+    static const char zeros[kBlock] = {};
+    out_.write(data, static_cast<std::streamsize>(size));
+    out_.write(zeros, static_cast<std::streamsize>(padding(size)));
+}
+
+void TarWriter::writeHeader(const std::string& name, uint64_t size, int64_t mtime, char type) {
+    char block[kBlock] = {};
+
+    std::string prefix, base;
+    if (!splitName(name, prefix, base)) {
+        throw std::runtime_error("Tar member name does not fit: " + name);
+    }
+
+    std::memcpy(block + kNameOffset, base.data(), base.size());
+    std::memcpy(block + kPrefixOffset, prefix.data(), prefix.size());
+    writeOctal(block, kModeOffset, 8, 0644);
+    writeOctal(block, kUidOffset, 8, 0);
+    writeOctal(block, kGidOffset, 8, 0);
+    writeOctal(block, kSizeOffset, kSizeLength, size);
+    writeOctal(block, kMtimeOffset, kMtimeLength, static_cast<uint64_t>(std::max<int64_t>(mtime, 0)));
+    block[kTypeOffset] = type;
+    std::memcpy(block + kMagicOffset, "ustar\0" "00", 8);
+
+    std::memset(block + kChecksumOffset, ' ', kChecksumLength);
+    unsigned sum = 0;
+    for (size_t i = 0; i < kBlock; ++i) {
+        sum += static_cast<unsigned char>(block[i]);
+    }
+    writeOctal(block, kChecksumOffset, 7, sum);
+    block[kChecksumOffset + 7] = ' ';
+
+    out_.write(block, kBlock);
+}
+
+void TarWriter::add(const std::string& name, const std::string& data, int64_t mtime) {
+    std::string prefix, base;
+    if (!splitName(name, prefix, base)) {
+        // "<len> path=<name>\n", where <len> counts its own digits
+        std::string body = " path=" + name + "\n";
+        size_t length = body.size() + 1;
+        while (std::to_string(length).size() + body.size() != length) {
+            length = std::to_string(length).size() + body.size();
+        }
+        std::string record = std::to_string(length) + body;
+        writeHeader("PaxHeaders/member", record.size(), mtime, 'x');
+        writePadded(record.data(), record.size());
+        // The ustar name is only a fallback for readers without pax support
+        std::string fallback = name.substr(name.size() - std::min(name.size(), kNameLength));
+        fallback.erase(0, fallback.find_first_not_of('/'));
+        writeHeader(fallback.empty() ? "member" : fallback, data.size(), mtime, '0');
+    } else {
+        writeHeader(name, data.size(), mtime, '0');
+    }
+    writePadded(data.data(), data.size());
+}
+
+void TarWriter::finish() {
+    static const char zeros[2 * kBlock] = {};
+    out_.write(zeros, sizeof(zeros));
+    out_.flush();
+    if (!out_) {
+        throw std::runtime_error("Failed to write tar archive");
+    }
+}
@@ -0,0 +1,159 @@
+#include "trace_log.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+std::atomic<bool> TraceLog::enabled_{false};
+
+namespace {
+
+struct Span {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+// Spans of one thread. Only the owning thread writes; `count` is published
+// with release so an exporter sees complete spans.
+struct ThreadRing {
+    std::unique_ptr<Span[]> spans;
+    size_t capacity = 0;
+    std::atomic<uint64_t> count{0};
+    int tid = 0;
+    std::string name;   // guarded by Registry::mutex
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+    std::vector<ThreadRing*> idle;   // rings of exited threads, taken before making new ones
+    size_t capacity = 0;
+    uint64_t origin = 0;
+};
+
+// Leaked so threads still running at exit can keep recording
+Registry& registry() {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+// The calling thread's ring, handed back for reuse when the thread exits.
+// Its spans stay in it, so short-lived threads (one set per GIF) end up
+// sharing a few rings instead of each leaving one behind.
+struct LocalRing {
+    ThreadRing* ring = nullptr;
+
+    ~LocalRing() {
+        if (ring) {
+            Registry& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            reg.idle.push_back(ring);
+        }
+    }
+};
+
+thread_local LocalRing localRing;
+
+// The calling thread's ring: an idle one, or a new one registered on first use
+ThreadRing& ring() {
+    if (!localRing.ring) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        if (!reg.idle.empty()) {
+            localRing.ring = reg.idle.back();
+            reg.idle.pop_back();
+        } else {
+            auto created = std::make_unique<ThreadRing>();
+            created->capacity = reg.capacity;
+            created->spans.reset(new Span[reg.capacity]);
+            created->tid = static_cast<int>(reg.rings.size()) + 1;
+            created->name = created->tid == 1 ? "main" : "thread " + std::to_string(created->tid);
+            localRing.ring = created.get();
+            reg.rings.push_back(std::move(created));
+        }
+    }
+    return *localRing.ring;
+}
+
+std::string escape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) out += c;
+    }
+    return out;
+}
+
+} // namespace
+
+void TraceLog::enable(size_t spansPerThread) {
+    Registry& reg = registry();
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        if (reg.capacity == 0) {
+            reg.capacity = std::max<size_t>(1, spansPerThread);
+            reg.origin = now();
+        }
+    }
+    enabled_.store(true, std::memory_order_relaxed);
+    // The enabling thread is listed first
+    ring();
+}
+
+void TraceLog::record(const char* name, uint64_t startNs, uint64_t endNs) {
+    if (!enabled()) {
+        return;
+    }
+    ThreadRing& r = ring();
+    uint64_t n = r.count.load(std::memory_order_relaxed);
+    r.spans[n % r.capacity] = Span{name, startNs, endNs};
+    r.count.store(n + 1, std::memory_order_release);
+}
+
+void TraceLog::setThreadName(const std::string& name) {
+    if (!enabled()) {
+        return;
+    }
+    ThreadRing& r = ring();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    r.name = name;
+}
+
+void TraceLog::write(const std::string& path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Failed to create trace file: " + path);
+    }
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    bool first = true;
+    for (const auto& r : reg.rings) {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << r->tid
+            << ",\"args\":{\"name\":\"" << escape(r->name) << "\"}}";
+
+        uint64_t count = r->count.load(std::memory_order_acquire);
+        uint64_t begin = count > r->capacity ? count - r->capacity : 0;
+        for (uint64_t i = begin; i < count; ++i) {
+            const Span& span = r->spans[i % r->capacity];
+            // Spans recorded before enable() have no place on the timeline
+            if (span.start < reg.origin) continue;
+            out << ",\n{\"name\":\"" << span.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << r->tid
+                << ",\"ts\":" << (span.start - reg.origin) / 1000.0
+                << ",\"dur\":" << (span.end - span.start) / 1000.0 << "}";
+        }
+    }
+    out << "\n]}\n";
+    out.flush();
+    if (!out) {
+        throw std::runtime_error("Failed to write trace file: " + path);
+    }
+}
@@ -1,5 +1,14 @@
 #include "vectorizer.h"
-#include <iostream>
+#include "arena.h"
+#include "buffer_pool.h"
+#include "complexity.h"
+#include "logger.h"
+#include "metrics.h"
+#include "pixel_pipeline.h"
+#include "png_stream.h"
+#include "potrace_process.h"
+#include "scratch_space.h"
+#include "trace_log.h"
 #include <fstream>
 #include <sstream>
 #include <regex>
@@ -8,12 +17,25 @@
 #include <filesystem>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <memory>
 #include <stdexcept>
 #include <array>
 #include <random>
 #include <set>
 #include <map>
+#include <iterator>
+#include <chrono>
+#include <cctype>
+#include <ctime>
+
+// Route all stb allocations into the per-job arena
+#define STBI_MALLOC(sz)                    arenaMalloc(sz)
+#define STBI_REALLOC_SIZED(p, oldsz, newsz) arenaRealloc(p, oldsz, newsz)
+#define STBI_FREE(p)                       arenaFree(p)
+#define STBIW_MALLOC(sz)                    arenaMalloc(sz)
+#define STBIW_REALLOC_SIZED(p, oldsz, newsz) arenaRealloc(p, oldsz, newsz)
+#define STBIW_FREE(p)                       arenaFree(p)
 
 // For image processing, we'll use stb_image
 #define STB_IMAGE_IMPLEMENTATION
@@ -33,6 +55,649 @@ struct StbiDeleter {
 // Alias for smart pointer with stbi images
 using StbiImagePtr = std::unique_ptr<unsigned char[], StbiDeleter>;
 
+namespace {
+
+// Image as decoded by stb_image, used in place without a PixelData copy
+struct DecodedImage {
+    StbiImagePtr pixels;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+
+    size_t rowBytes() const { return static_cast<size_t>(width) * channels; }
+};
+
+DecodedImage decodeImage(const ImageSource& source, const std::string& error) {
+    DecodedImage image;
+    if (source.inMemory()) {
+        image.pixels.reset(stbi_load_from_memory(source.data, static_cast<int>(source.size),
+                                                 &image.width, &image.height, &image.channels, 0));
+    } else {
+        image.pixels.reset(stbi_load(source.path.c_str(), &image.width, &image.height, &image.channels, 0));
+    }
+    if (!image.pixels) {
+        throw std::runtime_error(error);
+    }
+    return image;
+}
+
+// Size of the decoded pixels, read from the header only (0 if unknown)
+size_t decodedSize(const ImageSource& source) {
+    if (source.decoded()) {
+        return 0;   // already resident
+    }
+    int width, height, channels;
+    int ok = source.inMemory()
+        ? stbi_info_from_memory(source.data, static_cast<int>(source.size), &width, &height, &channels)
+        : stbi_info(source.path.c_str(), &width, &height, &channels);
+    if (!ok) {
+        return 0;
+    }
+    return static_cast<size_t>(width) * height * channels;
+}
+
+// Rows handed to the stages per call
+constexpr int kChunkRows = 32;
+
+// Decode `source` into `sink` row chunk by row chunk. PNGs go through the
+// streaming decoder, so the full image is never materialized; anything it
+// leaves out (interlaced, CgBI, other formats) is decoded by stb_image and
+// replayed in strips, each dropped once consumed when running out of core.
+void decodeRows(const ImageSource& source, RowSink& sink, const std::string& error) {
+    if (source.decoded()) {
+        size_t rowBytes = static_cast<size_t>(source.width) * source.channels;
+        sink.begin(source.width, source.height, source.channels);
+        for (int y = 0; y < source.height; y += kChunkRows) {
+            sink.rows(y, std::min(kChunkRows, source.height - y),
+                      source.pixels + static_cast<size_t>(y) * rowBytes, rowBytes);
+        }
+        sink.end();
+        return;
+    }
+    
+    PngStreamDecoder decoder(kChunkRows);
+    bool streamed = source.inMemory() ? decoder.decode(source.data, source.size, sink)
+                                      : decoder.decode(source.path, sink);
+    if (streamed) {
+        return;
+    }
+    
+    DecodedImage image = decodeImage(source, error);
+    size_t rowBytes = image.rowBytes();
+    int stripRows = std::min(kChunkRows, ScratchSpace::stripRows(rowBytes));
+    const uint8_t* pixels = image.pixels.get();
+    ScratchSpace::adviseSequential(pixels, rowBytes * image.height);
+    
+    sink.begin(image.width, image.height, image.channels);
+    for (int y = 0; y < image.height; y += stripRows) {
+        int rows = std::min(stripRows, image.height - y);
+        const uint8_t* strip = pixels + static_cast<size_t>(y) * rowBytes;
+        sink.rows(y, rows, strip, rowBytes);
+        ScratchSpace::dropResident(strip, rows * rowBytes);
+    }
+    sink.end();
+}
+
+// Converts incoming rows to gray (posterized when `table` is set),
+// thresholds them to a 1-bit PBM and streams that into potrace, so only one
+// chunk of rows exists at a time and potrace reads 1/8 of the gray bytes.
+// With `scale` > 1 each scale x scale block is averaged into one pixel
+// first, for preview traces of overly complex images. A meter, when given,
+// sees every packed row and stops the decode once a complexity cap is hit.
+class BitmapSink : public RowSink {
+public:
+    BitmapSink(PotraceProcess& potrace, const PosterizeTable* table, int scale = 1,
+               ComplexityMeter* meter = nullptr)
+        : potrace_(potrace), table_(table), scale_(scale), meter_(meter) {}
+    
+    void begin(int width, int height, int channels) override {
+        width_ = width;
+        height_ = height;
+        channels_ = channels;
+        outWidth_ = (width_ + scale_ - 1) / scale_;
+        int outHeight = (height + scale_ - 1) / scale_;
+        packedBytes_ = (outWidth_ + 7) / 8;
+        std::string header = "P4\n" + std::to_string(outWidth_) + " " + std::to_string(outHeight) + "\n";
+        potrace_.write(header.data(), header.size());
+        if (meter_) {
+            meter_->begin(static_cast<int>(outWidth_), outHeight);
+        }
+        if (scale_ > 1) {
+            sums_.assign(outWidth_, 0);
+            blockRows_ = 0;
+        }
+    }
+    
+    void rows(int y, int count, const uint8_t* data, size_t stride) override {
+        size_t packed = static_cast<size_t>(count) * packedBytes_;
+        if (buffer_.size() < width_ + packed) {
+            buffer_ = BufferPool::local().acquire(width_ + packed);
+        }
+        uint8_t* gray = buffer_.data();
+        uint8_t* bits = buffer_.data() + width_;
+        size_t out = 0;
+        dispatchLayout(channels_, [&](auto layout) {
+            using Layout = decltype(layout);
+            for (int i = 0; i < count; ++i) {
+                const uint8_t* src = data + i * stride;
+                if (table_) {
+                    convertToPosterizedGray<Layout>(src, gray, width_, *table_);
+                } else {
+                    convertToGray<Layout>(src, gray, width_);
+                }
+                if (scale_ > 1 && !reduceRow(gray, y + i + 1 == height_)) {
+                    continue;
+                }
+                uint8_t* row = bits + out++ * packedBytes_;
+                packBitmapRow(gray, row, outWidth_);
+                if (meter_) {
+                    meter_->addRow(row);
+                    meter_->check(ComplexityGuard::limits());
+                }
+            }
+        });
+        potrace_.write(bits, out * packedBytes_);
+    }
+    
+    void end() override {}
+    
+    int width() const { return static_cast<int>(width_); }
+    int height() const { return height_; }
+    int channels() const { return channels_; }
+    
+private:
+    // Add a gray row to the current block; once the block is complete,
+    // write its averages to the front of `gray` and return true
+    bool reduceRow(uint8_t* gray, bool lastRow) {
+        for (size_t x = 0; x < width_; ++x) {
+            sums_[x / scale_] += gray[x];
+        }
+        if (++blockRows_ < scale_ && !lastRow) {
+            return false;
+        }
+        for (size_t ox = 0; ox < outWidth_; ++ox) {
+            size_t columns = std::min<size_t>(scale_, width_ - ox * scale_);
+            gray[ox] = static_cast<uint8_t>(sums_[ox] / (columns * blockRows_));
+            sums_[ox] = 0;
+        }
+        blockRows_ = 0;
+        return true;
+    }
+    
+    PotraceProcess& potrace_;
+    const PosterizeTable* table_;
+    int scale_;
+    ComplexityMeter* meter_;
+    PooledBuffer buffer_;
+    std::vector<uint32_t> sums_;
+    int blockRows_ = 0;
+    size_t width_ = 0;
+    size_t outWidth_ = 0;
+    size_t packedBytes_ = 0;
+    int height_ = 0;
+    int channels_ = 0;
+};
+
+// Converts incoming rows to gray (posterized when `table` is set) and keeps
+// the whole thresholded image as packed PBM rows, for tiled traces. A meter,
+// when given, stops the decode once a complexity cap is hit.
+class PackedBitmapSink : public RowSink {
+public:
+    PackedBitmapSink(std::vector<uint8_t>& bits, const PosterizeTable* table,
+                     ComplexityMeter* meter = nullptr)
+        : bits_(bits), table_(table), meter_(meter) {}
+    
+    void begin(int width, int height, int channels) override {
+        width_ = width;
+        height_ = height;
+        channels_ = channels;
+        packedBytes_ = (width_ + 7) / 8;
+        bits_.assign(packedBytes_ * height, 0);
+        gray_ = BufferPool::local().acquire(width_);
+        if (meter_) {
+            meter_->begin(static_cast<int>(width_), height_);
+        }
+    }
+    
+    void rows(int y, int count, const uint8_t* data, size_t stride) override {
+        dispatchLayout(channels_, [&](auto layout) {
+            using Layout = decltype(layout);
+            for (int i = 0; i < count; ++i) {
+                const uint8_t* src = data + i * stride;
+                if (table_) {
+                    convertToPosterizedGray<Layout>(src, gray_.data(), width_, *table_);
+                } else {
+                    convertToGray<Layout>(src, gray_.data(), width_);
+                }
+                uint8_t* row = bits_.data() + static_cast<size_t>(y + i) * packedBytes_;
+                packBitmapRow(gray_.data(), row, width_);
+                if (meter_) {
+                    meter_->addRow(row);
+                    meter_->check(ComplexityGuard::limits());
+                }
+            }
+        });
+    }
+    
+    int width() const { return static_cast<int>(width_); }
+    int height() const { return height_; }
+    int channels() const { return channels_; }
+    
+private:
+    std::vector<uint8_t>& bits_;
+    const PosterizeTable* table_;
+    ComplexityMeter* meter_;
+    PooledBuffer gray_;
+    size_t width_ = 0;
+    size_t packedBytes_ = 0;
+    int height_ = 0;
+    int channels_ = 0;
+};
+
+// Builds the sampled color histogram used for palette extraction from the
+// rows as they arrive; rows between samples are skipped without conversion.
+class ColorHistogramSink : public RowSink {
+public:
+    ColorHistogramSink() : counts_(JobArena::current()) {}
+    
+    void begin(int width, int height, int channels) override {
+        width_ = width;
+        height_ = height;
+        channels_ = channels;
+        sampleStep_ = std::max(1, std::min(width, height) / 100);
+    }
+    
+    void rows(int y, int count, const uint8_t* data, size_t stride) override {
+        dispatchLayout(channels_, [&](auto layout) {
+            using Layout = decltype(layout);
+            // First sampled row in this chunk
+            int i = (sampleStep_ - y % sampleStep_) % sampleStep_;
+            for (; i < count; i += sampleStep_) {
+                forEachSampledColor<Layout>(data + i * stride, width_, 1, sampleStep_,
+                                            [&](uint32_t color) { counts_[color]++; });
+            }
+        });
+    }
+    
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int channels() const { return channels_; }
+    
+    // Most frequent colors as hex strings, at most `numColors`
+    std::vector<std::string> topColors(int numColors) const {
+        std::pmr::vector<std::pair<uint32_t, int>> sorted(counts_.begin(), counts_.end(),
+                                                          JobArena::current());
+        // Ties go to the lower color, so the palette never depends on the
+        // sort implementation
+        std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+        
+        std::vector<std::string> colors;
+        for (int i = 0; i < numColors && i < static_cast<int>(sorted.size()); ++i) {
+            uint32_t c = sorted[i].first;
+            colors.push_back(Vectorizer::rgbToHex((c >> 16) & 0xff, (c >> 8) & 0xff, c & 0xff));
+        }
+        return colors;
+    }
+    
+private:
+    // Keys are packed 0xRRGGBB values, which sort the same way as their hex strings
+    std::pmr::map<uint32_t, int> counts_;
+    int width_ = 0;
+    int height_ = 0;
+    int channels_ = 0;
+    int sampleStep_ = 1;
+};
+
+// Value of a single hex digit, or -1
+int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Replace every occurrence of `from` in one linear pass
+void replaceAll(std::pmr::string& text, std::string_view from, std::string_view to) {
+    size_t pos = text.find(from.data(), 0, from.size());
+    if (pos == std::pmr::string::npos) {
+        return;
+    }
+    std::pmr::string out(text.get_allocator());
+    out.reserve(text.size());
+    size_t last = 0;
+    while (pos != std::pmr::string::npos) {
+        out.append(text, last, pos - last);
+        out.append(to.data(), to.size());
+        last = pos + from.size();
+        pos = text.find(from.data(), last, from.size());
+    }
+    out.append(text, last, std::pmr::string::npos);
+    text.swap(out);
+}
+
+// std::regex_replace into an arena string
+std::pmr::string regexReplace(std::string_view text, const std::regex& pattern, const char* format) {
+    std::pmr::string out(JobArena::current());
+    out.reserve(text.size());
+    std::regex_replace(std::back_inserter(out), text.data(), text.data() + text.size(),
+                       pattern, format);
+    AllocProfile::countCopy(out.size());
+    return out;
+}
+
+// CPU time consumed by the calling thread
+double threadCpuMs() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+#else
+    return std::clock() * 1000.0 / CLOCKS_PER_SEC;
+#endif
+}
+
+// Times consecutive pipeline stages into ConversionStats::stageMs
+class StageClock {
+public:
+    explicit StageClock(ConversionStats& stats)
+        : stats_(stats), last_(Clock::now()), lastCounters_(AllocProfile::current()) {}
+    
+    // Also records the stage as a span when tracing is on, and charges it
+    // the allocations and copies made since the previous lap
+    void lap(const char* stage) {
+        Clock::time_point now = Clock::now();
+        double ms = std::chrono::duration<double, std::milli>(now - last_).count();
+        stats_.stageMs.emplace_back(stage, ms);
+        AllocCounters counters;
+        if (AllocProfile::kCounting) {
+            AllocCounters current = AllocProfile::current();
+            counters = current - lastCounters_;
+            lastCounters_ = current;
+            stats_.stageAllocs.emplace_back(stage, counters);
+        }
+        AllocProfile::addStage(stage, ms, counters);
+        Metrics::observeStage(stage, ms);
+        if (TraceLog::enabled()) {
+            TraceLog::record(stage, nanoseconds(last_), nanoseconds(now));
+        }
+        last_ = now;
+    }
+    
+private:
+    using Clock = std::chrono::steady_clock;
+    
+    static uint64_t nanoseconds(Clock::time_point t) {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count());
+    }
+    
+    ConversionStats& stats_;
+    Clock::time_point last_;
+    AllocCounters lastCounters_;
+};
+
+// Adds the CPU time and working set of one call to the stats. The working
+// set is the pooled buffers held at the peak plus the job arena in use.
+class CallMeter {
+public:
+    explicit CallMeter(ConversionStats& stats)
+        : stats_(stats), cpuStart_(threadCpuMs()), lentStart_(BufferPool::local().lentBytes()) {
+        BufferPool::local().resetPeak();
+    }
+    
+    ~CallMeter() {
+        stats_.cpuMs += threadCpuMs() - cpuStart_;
+        size_t pooled = BufferPool::local().peakLentBytes();
+        pooled -= std::min(pooled, lentStart_);
+        stats_.peakBytes = std::max(stats_.peakBytes, pooled + JobArena::local().bytesInUse());
+    }
+    
+private:
+    ConversionStats& stats_;
+    double cpuStart_;
+    size_t lentStart_;
+};
+
+bool isPathNumberStart(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.';
+}
+
+// Segments drawn by one path's d attribute: each command consumes its
+// arguments in groups (potrace repeats `c` and `l` implicitly), and a
+// moveto's extra coordinate pairs are linetos
+size_t countSegments(std::string_view d) {
+    size_t segments = 0;
+    char command = 0;
+    size_t numbers = 0;
+    auto finish = [&] {
+        int args = 0;
+        switch (command | 0x20) {
+            case 'm': case 'l': case 't': args = 2; break;
+            case 'c': args = 6; break;
+            case 's': case 'q': args = 4; break;
+            case 'h': case 'v': args = 1; break;
+            case 'a': args = 7; break;
+            default: break;
+        }
+        if (args > 0) {
+            size_t groups = numbers / args;
+            segments += (command | 0x20) == 'm' ? (groups > 0 ? groups - 1 : 0) : groups;
+        }
+    };
+    size_t i = 0;
+    while (i < d.size()) {
+        char c = d[i];
+        if (std::isalpha(static_cast<unsigned char>(c)) && c != 'e' && c != 'E') {
+            finish();
+            command = c;
+            numbers = 0;
+            ++i;
+        } else if (isPathNumberStart(c)) {
+            // One number: sign, digits, fraction, exponent
+            ++numbers;
+            if (c == '-' || c == '+') ++i;
+            bool dot = false;
+            while (i < d.size() && (std::isdigit(static_cast<unsigned char>(d[i])) || (d[i] == '.' && !dot))) {
+                dot = dot || d[i] == '.';
+                ++i;
+            }
+            if (i < d.size() && (d[i] == 'e' || d[i] == 'E')) {
+                ++i;
+                if (i < d.size() && (d[i] == '-' || d[i] == '+')) ++i;
+                while (i < d.size() && std::isdigit(static_cast<unsigned char>(d[i]))) ++i;
+            }
+        } else {
+            ++i;
+        }
+    }
+    finish();
+    return segments;
+}
+
+// Count the <path> elements of an SVG and the segments they draw
+void countPaths(std::string_view svg, size_t& paths, size_t& nodes) {
+    paths = 0;
+    nodes = 0;
+    size_t pos = 0;
+    while ((pos = svg.find("<path", pos)) != std::string_view::npos) {
+        ++paths;
+        size_t end = svg.find('>', pos);
+        size_t d = svg.find(" d=\"", pos);
+        if (d == std::string_view::npos || d > end) {
+            pos = end;
+            continue;
+        }
+        d += 4;
+        size_t close = svg.find('"', d);
+        if (close == std::string_view::npos) break;
+        nodes += countSegments(svg.substr(d, close - d));
+        pos = close;
+    }
+}
+
+// Smallest side of a preview bitmap; anything coarser is rasterized
+constexpr int kMinPreviewSide = 32;
+
+// Preview tries before giving up and rasterizing
+constexpr int kMaxPreviewTries = 4;
+
+// Reduction for the next preview trace of a bitmap that broke a cap at
+// `scale`. Boundary length shrinks about linearly with the scale and the
+// number of regions quadratically, so aim for both to fit; always at least
+// halve, in case the estimate from a partial bitmap was optimistic.
+int nextPreviewScale(int scale, const ComplexityExceeded& exceeded, const ComplexityLimits& limits) {
+    double ratio = 1;
+    if (limits.maxEdges > 0) {
+        ratio = std::max(ratio, static_cast<double>(exceeded.edges) / limits.maxEdges);
+    }
+    if (limits.maxComponents > 0) {
+        ratio = std::max(ratio, std::sqrt(static_cast<double>(exceeded.components) / limits.maxComponents));
+    }
+    return scale * std::max(2, static_cast<int>(std::ceil(ratio)));
+}
+
+// Multiply the width and height of the root <svg> tag by the reduction of
+// each side, keeping their units, so a trace of a bitmap reduced by `scale`
+// displays at the original size. A viewBox is added first if potrace did
+// not write one.
+void scaleSvgSize(std::pmr::string& svg, int scale, int width, int height) {
+    size_t tag = svg.find("<svg");
+    if (tag == std::pmr::string::npos) return;
+    size_t tagEnd = svg.find('>', tag);
+    if (tagEnd == std::pmr::string::npos) return;
+    
+    auto attribute = [&](const char* name, size_t& begin, size_t& end) {
+        std::string key = std::string(" ") + name + "=\"";
+        size_t pos = svg.find(key.data(), tag, key.size());
+        if (pos == std::pmr::string::npos || pos > tagEnd) return false;
+        begin = pos + key.size();
+        end = svg.find('"', begin);
+        return end != std::pmr::string::npos && end < tagEnd;
+    };
+    
+    size_t widthBegin, widthEnd, heightBegin, heightEnd, viewBegin, viewEnd;
+    if (!attribute("width", widthBegin, widthEnd) || !attribute("height", heightBegin, heightEnd)) {
+        return;
+    }
+    double svgWidth = std::strtod(svg.c_str() + widthBegin, nullptr);
+    double svgHeight = std::strtod(svg.c_str() + heightBegin, nullptr);
+    char number[64];
+    if (!attribute("viewBox", viewBegin, viewEnd)) {
+        std::snprintf(number, sizeof(number), " viewBox=\"0 0 %g %g\"", svgWidth, svgHeight);
+        svg.insert(tagEnd, number);
+    }
+    
+    // Height first, so the width offsets stay valid
+    auto rewrite = [&](size_t begin, size_t end, double value, int side) {
+        size_t unit = begin;
+        while (unit < end && (std::isdigit(static_cast<unsigned char>(svg[unit])) || svg[unit] == '.')) {
+            ++unit;
+        }
+        int reduced = (side + scale - 1) / scale;
+        std::snprintf(number, sizeof(number), "%f", value * side / reduced);
+        svg.replace(begin, unit - begin, number);
+    };
+    if (heightBegin > widthBegin) {
+        rewrite(heightBegin, heightEnd, svgHeight, height);
+        rewrite(widthBegin, widthEnd, svgWidth, width);
+    } else {
+        rewrite(widthBegin, widthEnd, svgWidth, width);
+        rewrite(heightBegin, heightEnd, svgHeight, height);
+    }
+}
+
+// The drawing of a potrace SVG for one tile, without its <svg> root and
+// metadata, moved to the tile's place in the image
+std::string spliceableTile(std::string_view svg, int x, int y) {
+    size_t begin = svg.find("<svg");
+    begin = begin == std::string_view::npos ? 0 : svg.find('>', begin) + 1;
+    size_t end = svg.rfind("</svg>");
+    if (begin == 0 || end == std::string_view::npos || end < begin) {
+        return std::string();
+    }
+    std::string_view body = svg.substr(begin, end - begin);
+    size_t metadata = body.find("<metadata");
+    size_t metadataEnd = body.find("</metadata>");
+    std::string tile = "<g transform=\"translate(" + std::to_string(x) + "," + std::to_string(y) + ")\">";
+    if (metadata != std::string_view::npos && metadataEnd != std::string_view::npos) {
+        tile += body.substr(0, metadata);
+        tile += body.substr(metadataEnd + 11);
+    } else {
+        tile += body;
+    }
+    tile += "</g>\n";
+    return tile;
+}
+
+// MIME type of an encoded image, from its signature
+const char* imageMimeType(const uint8_t* data, size_t size) {
+    if (size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF) return "image/jpeg";
+    if (size >= 4 && std::memcmp(data, "GIF8", 4) == 0) return "image/gif";
+    if (size >= 2 && data[0] == 'B' && data[1] == 'M') return "image/bmp";
+    return "image/png";
+}
+
+// SVG showing the original encoded image as an embedded bitmap, the
+// fallback for images no trace can represent in bounded time. Decoded
+// pixels (GIF frames) are encoded as a PNG first.
+std::pmr::string rasterSvg(const ImageSource& image, int width, int height) {
+    std::pmr::vector<uint8_t> file(JobArena::current());
+    const uint8_t* data = image.data;
+    size_t size = image.size;
+    if (image.decoded()) {
+        int length = 0;
+        unsigned char* png = stbi_write_png_to_mem(image.pixels, image.width * image.channels, image.width,
+                                                   image.height, image.channels, &length);
+        if (!png) {
+            throw std::runtime_error("Failed to encode image");
+        }
+        file.assign(png, png + length);
+        STBIW_FREE(png);
+        data = file.data();
+        size = file.size();
+    } else if (!image.inMemory()) {
+        std::ifstream in(image.path, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("Failed to load image: " + image.path);
+        }
+        file.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data = file.data();
+        size = file.size();
+    }
+    
+    static const char kDigits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string w = std::to_string(width);
+    std::string h = std::to_string(height);
+    std::pmr::string svg(JobArena::current());
+    svg.reserve(size / 3 * 4 + 256);
+    svg += "<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" viewBox=\"0 0 ";
+    svg += w + " " + h + "\"><image width=\"" + w + "\" height=\"" + h + "\" xlink:href=\"data:";
+    svg += imageMimeType(data, size);
+    svg += ";base64,";
+    size_t i = 0;
+    for (; i + 2 < size; i += 3) {
+        uint32_t v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        svg += kDigits[v >> 18];
+        svg += kDigits[(v >> 12) & 63];
+        svg += kDigits[(v >> 6) & 63];
+        svg += kDigits[v & 63];
+    }
+    if (i < size) {
+        uint32_t v = data[i] << 16;
+        if (i + 1 < size) v |= data[i + 1] << 8;
+        svg += kDigits[v >> 18];
+        svg += kDigits[(v >> 12) & 63];
+        svg += i + 1 < size ? kDigits[(v >> 6) & 63] : '=';
+        svg += '=';
+    }
+    svg += "\"/></svg>";
+    return svg;
+}
+
+} // namespace
+
 Vectorizer::Vectorizer() {
     // Constructor
 }
@@ -42,26 +707,37 @@ Vectorizer::~Vectorizer() {
 }
 
 std::tuple<int, int, int> Vectorizer::hexToRgb(const std::string& hexColor) {
-    std::string hex = hexColor;
+    // Parse in place; no substrings are allocated
+    std::string_view hex(hexColor);
     
     // Remove '#' if present
-    if (hex[0] == '#') {
-        hex = hex.substr(1);
+    if (!hex.empty() && hex[0] == '#') {
+        hex.remove_prefix(1);
     }
     
-    // Handle 3-character hex codes
+    int digits[6];
     if (hex.length() == 3) {
-        std::string expanded;
-        for (char c : hex) {
-            expanded += c;
-            expanded += c;
+        // Handle 3-character hex codes
+        for (int i = 0; i < 3; ++i) {
+            digits[2 * i] = digits[2 * i + 1] = hexDigit(hex[i]);
         }
-        hex = expanded;
+    } else if (hex.length() >= 6) {
+        for (int i = 0; i < 6; ++i) {
+            digits[i] = hexDigit(hex[i]);
+        }
+    } else {
+        throw std::invalid_argument("Invalid hex color: " + hexColor);
     }
     
-    int r = std::stoi(hex.substr(0, 2), nullptr, 16);
-    int g = std::stoi(hex.substr(2, 2), nullptr, 16);
-    int b = std::stoi(hex.substr(4, 2), nullptr, 16);
+    for (int d : digits) {
+        if (d < 0) {
+            throw std::invalid_argument("Invalid hex color: " + hexColor);
+        }
+    }
+    
+    int r = digits[0] * 16 + digits[1];
+    int g = digits[2] * 16 + digits[3];
+    int b = digits[4] * 16 + digits[5];
     
     return std::make_tuple(r, g, b);
 }
@@ -89,20 +765,26 @@ float Vectorizer::combineOpacity(float a, float b) {
 }
 
 std::string Vectorizer::getSolid(const std::string& svgContent, bool stroke) {
-    std::string result = svgContent;
+    ArenaScope scope;
+    std::pmr::string result = solidPass(svgContent, stroke);
+    AllocProfile::countCopy(result.size());
+    return std::string(result.begin(), result.end());
+}
+
+std::pmr::string Vectorizer::solidPass(std::string_view svgContent, bool stroke) {
+    static const std::regex blackFillPattern("fill=\"black\"");
+    static const std::regex opacityPattern("fill-opacity=\"([\\d\\.]+)\"");
+    static const std::regex strokeNonePattern(" stroke=\"none\"");
+    std::pmr::memory_resource* arena = JobArena::current();
     
     // Remove fill="black" attributes
-    result = std::regex_replace(result, std::regex("fill=\"black\""), "");
+    std::pmr::string result = regexReplace(svgContent, blackFillPattern, "");
     
     // Find all fill-opacity attributes
-    std::regex opacityPattern("fill-opacity=\"([\\d\\.]+)\"");
-    std::smatch matches;
-    std::set<float> uniqueOpacities;
-    
-    std::string temp = result;
-    while (std::regex_search(temp, matches, opacityPattern)) {
-        uniqueOpacities.insert(std::stof(matches[1]));
-        temp = matches.suffix();
+    std::pmr::set<float> uniqueOpacities(arena);
+    for (std::cregex_iterator it(result.data(), result.data() + result.size(), opacityPattern), end;
+         it != end; ++it) {
+        uniqueOpacities.insert(std::stof((*it)[1].str()));
     }
     
     if (uniqueOpacities.empty()) {
@@ -110,10 +792,11 @@ std::string Vectorizer::getSolid(const std::string& svgContent, bool stroke) {
     }
     
     // Sort opacities in descending order
-    std::vector<float> sortedOpacities(uniqueOpacities.begin(), uniqueOpacities.end());
-    std::sort(sortedOpacities.rbegin(), sortedOpacities.rend());
+    std::pmr::vector<float> sortedOpacities(uniqueOpacities.rbegin(), uniqueOpacities.rend(), arena);
     
     // Calculate true opacity and create replacements
+    std::pmr::string oldAttr(arena);
+    std::pmr::string newAttr(arena);
     for (size_t i = 0; i < sortedOpacities.size(); ++i) {
         float trueOpacity = sortedOpacities[i];
         
@@ -126,27 +809,25 @@ std::string Vectorizer::getSolid(const std::string& svgContent, bool stroke) {
         std::string hexColor = rgbaToHex(0, 0, 0, trueOpacity);
         
         // Create replacement string
-        std::string oldAttr = "fill-opacity=\"" + std::to_string(sortedOpacities[i]) + "\"";
-        std::string newAttr;
+        oldAttr.assign("fill-opacity=\"");
+        oldAttr += std::to_string(sortedOpacities[i]);
+        oldAttr += '"';
         
+        newAttr.assign("fill=\"");
+        newAttr += hexColor;
+        newAttr += '"';
         if (stroke) {
-            newAttr = "fill=\"" + hexColor + "\" stroke-width=\"1\" stroke=\"" + hexColor + "\"";
-        } else {
-            newAttr = "fill=\"" + hexColor + "\"";
+            newAttr += " stroke-width=\"1\" stroke=\"";
+            newAttr += hexColor;
+            newAttr += '"';
         }
         
         // Replace in result
-        size_t pos = 0;
-        while ((pos = result.find(oldAttr, pos)) != std::string::npos) {
-            result.replace(pos, oldAttr.length(), newAttr);
-            pos += newAttr.length();
-        }
+        replaceAll(result, oldAttr, newAttr);
     }
     
     // Remove stroke="none" attributes
-    result = std::regex_replace(result, std::regex(" stroke=\"none\""), "");
-    
-    return result;
+    return regexReplace(result, strokeNonePattern, "");
 }
 
 PixelData Vectorizer::getPixels(const std::string& imagePath) {
@@ -172,17 +853,10 @@ PixelData Vectorizer::getPixels(const std::string& imagePath) {
         default: data.mode = "UNKNOWN"; break;
     }
     
-    // Convert to 3D vector
-    data.pixels.resize(height);
-    for (int y = 0; y < height; ++y) {
-        data.pixels[y].resize(width);
-        for (int x = 0; x < width; ++x) {
-            data.pixels[y][x].resize(channels);
-            for (int c = 0; c < channels; ++c) {
-                data.pixels[y][x][c] = pixels[(y * width + x) * channels + c];
-            }
-        }
-    }
+    // Copy into a flat buffer owned by the job arena
+    data.pixels = std::pmr::vector<uint8_t>(
+        pixels.get(), pixels.get() + static_cast<size_t>(width) * height * channels,
+        JobArena::current());
     
     // No need to manually free - smart pointer handles it
     return data;
@@ -213,105 +887,101 @@ std::string Vectorizer::findNearestColor(const std::string& color, const std::ve
 }
 
 std::vector<std::string> Vectorizer::extractDominantColors(const PixelData& data, int numColors) {
-    std::vector<std::string> dominantColors;
-    
+    return extractDominantColors(data.pixels.data(), data.width, data.height, data.channels, numColors);
+}
+
+std::vector<std::string> Vectorizer::extractDominantColors(const uint8_t* pixels, int width, int height,
+                                                           int channels, int numColors) {
     // Simple color quantization using histogram
     // This is a simplified version - in production, you'd want to use proper K-means clustering
-    std::map<std::string, int> colorCount;
-    
-    // Sample pixels for faster processing
-    int sampleStep = std::max(1, std::min(data.width, data.height) / 100);
-    
-    for (int y = 0; y < data.height; y += sampleStep) {
-        for (int x = 0; x < data.width; x += sampleStep) {
-            if (data.channels >= 3) {
-                // Skip transparent pixels if RGBA
-                if (data.channels == 4 && data.pixels[y][x][3] < 128) {
-                    continue;
-                }
-                
-                // Quantize colors to reduce color space
-                int r = (data.pixels[y][x][0] / 32) * 32;
-                int g = (data.pixels[y][x][1] / 32) * 32;
-                int b = (data.pixels[y][x][2] / 32) * 32;
-                
-                std::string color = rgbToHex(r, g, b);
-                colorCount[color]++;
-            }
-        }
-    }
-    
-    // Sort colors by frequency and take top N
-    std::vector<std::pair<std::string, int>> sortedColors(colorCount.begin(), colorCount.end());
-    std::sort(sortedColors.begin(), sortedColors.end(),
-              [](const auto& a, const auto& b) { return a.second > b.second; });
-    
-    for (int i = 0; i < numColors && i < static_cast<int>(sortedColors.size()); ++i) {
-        dominantColors.push_back(sortedColors[i].first);
-    }
-    
-    return dominantColors;
+    ColorHistogramSink histogram;
+    histogram.begin(width, height, channels);
+    histogram.rows(0, height, pixels, static_cast<size_t>(width) * channels);
+    histogram.end();
+    return histogram.topColors(numColors);
 }
 
 std::string Vectorizer::replaceColors(const std::string& svgContent, const std::string& originalImagePath) {
-    // Get pixel data from original image
-    PixelData originalData = getPixels(originalImagePath);
-    
-    // Check if image is grayscale
-    if (originalData.mode == "L" || originalData.mode == "LA") {
-        return svgContent;
-    }
+    ArenaScope scope;
+    std::pmr::string result = recolorPass(svgContent, ImageSource{originalImagePath});
+    AllocProfile::countCopy(result.size());
+    return std::string(result.begin(), result.end());
+}
+
+std::pmr::string Vectorizer::recolorPass(std::string_view svgContent, const ImageSource& original) {
+    static const std::regex hexPattern("#([a-f0-9]{3}){1,2}\\b", std::regex::icase);
+    std::pmr::memory_resource* arena = JobArena::current();
+    std::pmr::string result(svgContent, arena);
+    AllocProfile::countCopy(result.size());
     
     // Find all hex colors in SVG
-    std::regex hexPattern("#([a-f0-9]{3}){1,2}\\b", std::regex::icase);
-    std::set<std::string> svgColorsSet;
-    std::smatch match;
-    std::string temp = svgContent;
-    
-    while (std::regex_search(temp, match, hexPattern)) {
-        svgColorsSet.insert(match[0]);
-        temp = match.suffix();
+    std::pmr::set<std::string> svgColorsSet(arena);
+    for (std::cregex_iterator it(svgContent.data(), svgContent.data() + svgContent.size(), hexPattern), end;
+         it != end; ++it) {
+        svgColorsSet.insert((*it)[0].str());
     }
     
     if (svgColorsSet.empty()) {
-        return svgContent;
+        return result;
     }
     
     std::vector<std::string> svgColors(svgColorsSet.begin(), svgColorsSet.end());
-    
-    // Extract dominant colors from original image
     int numColors = std::min(static_cast<int>(svgColors.size()), 5);
-    std::vector<std::string> dominantColors = extractDominantColors(originalData, numColors);
+    
+    if (!sharedPalette_.empty()) {
+        std::vector<std::string> dominantColors(
+            sharedPalette_.begin(), sharedPalette_.begin() + std::min<size_t>(numColors, sharedPalette_.size()));
+        for (const auto& svgColor : svgColors) {
+            replaceAll(result, svgColor, findNearestColor(svgColor, dominantColors));
+        }
+        return result;
+    }
+    
+    // Extract dominant colors from the original image as it decodes
+    ColorHistogramSink histogram;
+    decodeRows(original, histogram, "Failed to load image: " + original.path);
+    
+    // Check if image is grayscale
+    if (histogram.channels() < 3) {
+        return result;
+    }
+    
+    std::vector<std::string> dominantColors = histogram.topColors(numColors);
     
     if (dominantColors.empty()) {
-        return svgContent;
+        return result;
     }
     
     // Map SVG colors to dominant colors
-    std::string result = svgContent;
     for (const auto& svgColor : svgColors) {
         std::string nearest = findNearestColor(svgColor, dominantColors);
         
         // Replace all occurrences
-        size_t pos = 0;
-        while ((pos = result.find(svgColor, pos)) != std::string::npos) {
-            result.replace(pos, svgColor.length(), nearest);
-            pos += nearest.length();
-        }
+        replaceAll(result, svgColor, nearest);
     }
     
     return result;
 }
 
 std::string Vectorizer::viewboxify(const std::string& svgContent) {
-    std::regex widthPattern("width=\"(\\d+)\"");
-    std::regex heightPattern("height=\"(\\d+)\"");
-    std::smatch widthMatch, heightMatch;
-    
-    std::string result = svgContent;
-    
-    if (std::regex_search(svgContent, widthMatch, widthPattern) &&
-        std::regex_search(svgContent, heightMatch, heightPattern)) {
+    ArenaScope scope;
+    std::pmr::string result = viewboxPass(svgContent);
+    AllocProfile::countCopy(result.size());
+    return std::string(result.begin(), result.end());
+}
+
+std::pmr::string Vectorizer::viewboxPass(std::string_view svgContent) {
+    static const std::regex widthPattern("width=\"(\\d+)\"");
+    static const std::regex heightPattern("height=\"(\\d+)\"");
+    std::cmatch widthMatch, heightMatch;
+    const char* first = svgContent.data();
+    const char* last = svgContent.data() + svgContent.size();
+    
+    std::pmr::string result(svgContent, JobArena::current());
+    AllocProfile::countCopy(result.size());
+    
+    if (std::regex_search(first, last, widthMatch, widthPattern) &&
+        std::regex_search(first, last, heightMatch, heightPattern)) {
         
         std::string width = widthMatch[1];
         std::string height = heightMatch[1];
@@ -321,9 +991,9 @@ std::string Vectorizer::viewboxify(const std::string& svgContent) {
         std::string newHeader = "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"0 0 " + 
                                 width + " " + height + "\">";
         
-        size_t pos = result.find(oldHeader);
-        if (pos != std::string::npos) {
-            result.replace(pos, oldHeader.length(), newHeader);
+        size_t pos = result.find(oldHeader.data(), 0, oldHeader.size());
+        if (pos != std::pmr::string::npos) {
+            result.replace(pos, oldHeader.length(), newHeader.data(), newHeader.size());
         }
     }
     
@@ -331,152 +1001,394 @@ std::string Vectorizer::viewboxify(const std::string& svgContent) {
 }
 
 std::string Vectorizer::optimizeSvg(const std::string& svgContent) {
-    std::string result = svgContent;
-    
-    // Remove excessive whitespace
-    result = std::regex_replace(result, std::regex("\\s+"), " ");
-    result = std::regex_replace(result, std::regex("> <"), "><");
-    
-    return result;
-}
-
-bool Vectorizer::runPotrace(const std::string& inputPath, const std::string& outputPath) {
-    std::string command = "potrace \"" + inputPath + "\" -s -o \"" + outputPath + "\" --opttolerance 0.5";
-    int result = std::system(command.c_str());
-    return result == 0;
+    ArenaScope scope;
+    std::pmr::string result = optimizePass(svgContent);
+    AllocProfile::countCopy(result.size());
+    return std::string(result.begin(), result.end());
 }
 
-void Vectorizer::posterizeImage(const std::string& inputPath, const std::string& outputPath, int levels) {
-    int width, height, channels;
-    
-    // Load image using smart pointer
-    StbiImagePtr pixels(stbi_load(inputPath.c_str(), &width, &height, &channels, 0));
-    
-    if (!pixels) {
-        throw std::runtime_error("Failed to load image for posterization");
-    }
-    
-    // Use vector for grayscale conversion
-    std::vector<unsigned char> grayPixels;
-    unsigned char* workingPixels = pixels.get();
-    
-    // Convert to grayscale if needed
-    if (channels > 1) {
-        grayPixels.resize(width * height);
-        for (int i = 0; i < width * height; ++i) {
-            // Simple grayscale conversion
-            int r = pixels[i * channels];
-            int g = pixels[i * channels + 1];
-            int b = pixels[i * channels + 2];
-            grayPixels[i] = static_cast<unsigned char>(0.299 * r + 0.587 * g + 0.114 * b);
-        }
-        workingPixels = grayPixels.data();
-        channels = 1;
-    }
-    
-    // Apply posterization
-    if (levels > 1) {
-        int step = 256 / levels;
-        for (int i = 0; i < width * height; ++i) {
-            workingPixels[i] = static_cast<unsigned char>((workingPixels[i] / step) * step);
-        }
-    }
+std::pmr::string Vectorizer::optimizePass(std::string_view svgContent) {
+    static const std::regex whitespacePattern("\\s+");
+    static const std::regex gapPattern("> <");
     
-    // Save as BMP (potrace works better with BMP)
-    stbi_write_bmp(outputPath.c_str(), width, height, 1, workingPixels);
+    // Remove excessive whitespace
+    std::pmr::string result = regexReplace(svgContent, whitespacePattern, " ");
+    return regexReplace(result, gapPattern, "><");
 }
 
 std::string Vectorizer::parseImage(const std::string& imageName, int step, 
                                    const std::vector<std::string>& colors) {
+    // All scratch memory of this conversion lives in the job arena
+    ArenaScope scope;
     std::string imagePath = "./" + imageName + ".png";
+    std::pmr::string svgContent = traceImage(ImageSource{imagePath}, step, colors);
+    
+    // Save the result
+    std::string outputPath = "./" + imageName + ".svg";
+    std::ofstream outFile(outputPath);
+    outFile << svgContent;
+    outFile.close();
+    
+    logInfo("svg_saved").field("output", outputPath) << "SVG saved to " << outputPath;
+    AllocProfile::countCopy(svgContent.size());
+    return std::string(svgContent.begin(), svgContent.end());
+}
+
+std::string Vectorizer::convertImage(const uint8_t* data, size_t size, int step,
+                                     const std::vector<std::string>& colors) {
+    ArenaScope scope;
+    ImageSource image;
+    image.data = data;
+    image.size = size;
+    std::pmr::string svgContent = traceImage(image, step, colors);
+    AllocProfile::countCopy(svgContent.size());
+    return std::string(svgContent.begin(), svgContent.end());
+}
+
+std::pmr::string Vectorizer::traceImage(const ImageSource& image, int step,
+                                        const std::vector<std::string>& colors) {
+    // Images too large for the resident limit are processed out of core
+    ScratchScope scratch(ScratchSpace::exceedsLimit(decodedSize(image)));
     
     // Check if potrace is installed
-    if (std::system("which potrace > /dev/null 2>&1") != 0) {
+    if (!PotraceProcess::available()) {
         throw std::runtime_error("Potrace is not installed. Please install it first.");
     }
     
-    // Create temporary BMP file
-    std::string tempBmpPath = "/tmp/" + imageName + "_temp.bmp";
-    
-    // Posterize if needed
-    if (step > 1) {
-        posterizeImage(imagePath, tempBmpPath, step);
-    } else {
-        // Just convert to BMP
-        int width, height, channels;
-        
-        // Use smart pointer for image loading
-        StbiImagePtr pixels(stbi_load(imagePath.c_str(), &width, &height, &channels, 0));
-        if (!pixels) {
-            throw std::runtime_error("Failed to load image");
-        }
-        
-        // Convert to grayscale if needed using vector
-        if (channels > 1) {
-            std::vector<unsigned char> grayPixels(width * height);
-            for (int i = 0; i < width * height; ++i) {
-                int r = pixels[i * channels];
-                int g = (channels > 1) ? pixels[i * channels + 1] : r;
-                int b = (channels > 2) ? pixels[i * channels + 2] : r;
-                grayPixels[i] = static_cast<unsigned char>(0.299 * r + 0.587 * g + 0.114 * b);
+    CallMeter meter(stats_);
+    StageClock clock(stats_);
+    
+    // Gray conversion, posterized if needed
+    const PosterizeTable table = makePosterizeTable(step);
+    const ComplexityLimits& limits = ComplexityGuard::limits();
+    ComplexityMeter complexity;
+    bool guarded = limits.maxEdges > 0 || limits.maxComponents > 0;
+    
+    // A bitmap that breaks a complexity cap is abandoned mid-decode, along
+    // with its potrace, and decoded again reduced or embedded as a raster
+    std::pmr::string svgContent(JobArena::current());
+    int scale = 1, width = 0, height = 0;
+    for (int attempt = 0;; ++attempt) {
+        // The bitmap goes to potrace while the image decodes
+        PotraceProcess potrace;
+        BitmapSink bitmap(potrace, step > 1 ? &table : nullptr, scale, guarded ? &complexity : nullptr);
+        try {
+            decodeRows(image, bitmap, step > 1 ? "Failed to load image for posterization" : "Failed to load image");
+        } catch (const ComplexityExceeded& exceeded) {
+            if (scale == 1) {
+                stats_.edges = exceeded.edges;
+                stats_.components = exceeded.components;
             }
-            stbi_write_bmp(tempBmpPath.c_str(), width, height, 1, grayPixels.data());
-        } else {
-            stbi_write_bmp(tempBmpPath.c_str(), width, height, 1, pixels.get());
+            scale = nextPreviewScale(scale, exceeded, limits);
+            int side = std::min(bitmap.width(), bitmap.height());
+            if (limits.fallback == ComplexityFallback::Preview &&
+                attempt + 1 < kMaxPreviewTries && side / scale >= kMinPreviewSide) {
+                continue;
+            }
+            
+            logWarn("complexity_raster").field("edges", stats_.edges).field("components", stats_.components)
+                << "  ! 位图过于复杂（边界 " << stats_.edges << "，区域 " << stats_.components
+                << "），改为嵌入位图";
+            svgContent = rasterSvg(image, bitmap.width(), bitmap.height());
+            clock.lap("raster");
+            stats_.downgrade = "raster";
+            if (stats_.width == 0) {
+                stats_.width = bitmap.width();
+                stats_.height = bitmap.height();
+                stats_.channels = bitmap.channels();
+            }
+            stats_.outputBytes = svgContent.size();
+            countPaths(svgContent, stats_.pathCount, stats_.nodeCount);
+            return svgContent;
+        }
+        clock.lap("bitmap");
+        if (stats_.width == 0) {
+            stats_.width = bitmap.width();
+            stats_.height = bitmap.height();
+            stats_.channels = bitmap.channels();
+        }
+        if (scale == 1) {
+            stats_.edges = complexity.edges();
+            stats_.components = complexity.components();
         }
+        width = bitmap.width();
+        height = bitmap.height();
+        svgContent = potrace.finish();
+        stats_.potraceCpuMs += potrace.cpuMs();
+        break;
     }
-    
-    // Run potrace
-    std::string tempSvgPath = "/tmp/" + imageName + "_temp.svg";
-    if (!runPotrace(tempBmpPath, tempSvgPath)) {
-        std::remove(tempBmpPath.c_str());
-        throw std::runtime_error("Potrace failed");
+    clock.lap("potrace");
+    if (scale > 1) {
+        logWarn("complexity_preview").field("edges", stats_.edges).field("components", stats_.components)
+            .field("scale", scale)
+            << "  ! 位图过于复杂（边界 " << stats_.edges << "，区域 " << stats_.components
+            << "），缩小 " << scale << " 倍预览";
+        scaleSvgSize(svgContent, scale, width, height);
+        stats_.downgrade = "preview";
+        stats_.previewScale = scale;
     }
-    
-    // Read SVG content
-    std::ifstream svgFile(tempSvgPath);
-    std::string svgContent((std::istreambuf_iterator<char>(svgFile)),
-                           std::istreambuf_iterator<char>());
-    svgFile.close();
-    
-    // Clean up temporary files
-    std::remove(tempBmpPath.c_str());
-    std::remove(tempSvgPath.c_str());
+    return finishTrace(std::move(svgContent), image, step, colors);
+}
+
+std::pmr::string Vectorizer::finishTrace(std::pmr::string svgContent, const ImageSource& image, int step,
+                                         const std::vector<std::string>& colors) {
+    StageClock clock(stats_);
     
     // Process the SVG
-    svgContent = getSolid(svgContent, step != 1);
+    svgContent = solidPass(svgContent, step != 1);
+    clock.lap("solid");
     
     if (step == 1 && !colors.empty()) {
         // Replace black with specified color
-        svgContent = std::regex_replace(svgContent, std::regex("#000000"), colors[0]);
+        replaceAll(svgContent, "#000000", colors[0]);
     } else if (step > 1) {
         // Replace colors based on original image
-        svgContent = replaceColors(svgContent, imagePath);
+        svgContent = recolorPass(svgContent, image);
     }
+    clock.lap("recolor");
     
     // Optimize and viewboxify
-    svgContent = optimizeSvg(svgContent);
-    svgContent = viewboxify(svgContent);
-    
-    // Save the result
-    std::string outputPath = "./" + imageName + ".svg";
-    std::ofstream outFile(outputPath);
-    outFile << svgContent;
-    outFile.close();
+    svgContent = optimizePass(svgContent);
+    clock.lap("optimize");
+    svgContent = viewboxPass(svgContent);
+    clock.lap("viewbox");
     
-    std::cout << "SVG saved to " << outputPath << std::endl;
+    stats_.outputBytes = svgContent.size();
+    countPaths(svgContent, stats_.pathCount, stats_.nodeCount);
     return svgContent;
 }
 
+std::string Vectorizer::convertImage(const uint8_t* data, size_t size, int step,
+                                     const std::vector<std::string>& colors, TileCache& cache) {
+    ArenaScope scope;
+    ImageSource image;
+    image.data = data;
+    image.size = size;
+    std::pmr::string svgContent = traceTiles(image, step, colors, cache);
+    AllocProfile::countCopy(svgContent.size());
+    return std::string(svgContent.begin(), svgContent.end());
+}
+
+std::vector<VectorizationOption> Vectorizer::inspectFrames(const uint8_t* rgba, int width, int height,
+                                                         int frames) {
+    ArenaScope scope;
+    ImageSource image;
+    image.pixels = rgba;
+    image.width = width;
+    image.height = height * frames;
+    image.channels = 4;
+    std::vector<VectorizationOption> options = inspectSource(image);
+    stats_.height = height;
+    return options;
+}
+
+std::string Vectorizer::convertFrame(const uint8_t* rgba, int width, int height, int step,
+                                     const std::vector<std::string>& colors, TileCache& cache) {
+    ArenaScope scope;
+    ImageSource image;
+    image.pixels = rgba;
+    image.width = width;
+    image.height = height;
+    image.channels = 4;
+    std::pmr::string svgContent = traceTiles(image, step, colors, cache);
+    AllocProfile::countCopy(svgContent.size());
+    return std::string(svgContent.begin(), svgContent.end());
+}
+
+std::pmr::string Vectorizer::traceTiles(const ImageSource& image, int step,
+                                        const std::vector<std::string>& colors, TileCache& cache) {
+    try {
+        return traceTileGrid(image, step, colors, cache);
+    } catch (const ComplexityExceeded&) {
+        // Too complex to trace tile by tile either; the whole-image trace
+        // applies the preview or raster fallback. Its output has no tiles,
+        // so the next conversion through the cache retraces everything.
+        cache.width = 0;
+        cache.height = 0;
+        cache.bitmap.clear();
+        cache.tiles.clear();
+        cache.tilesCurrent = false;
+        cache.tilesTraced = 0;
+        return traceImage(image, step, colors);
+    }
+}
+
+std::pmr::string Vectorizer::traceTileGrid(const ImageSource& image, int step,
+                                           const std::vector<std::string>& colors, TileCache& cache) {
+    ScratchScope scratch(ScratchSpace::exceedsLimit(decodedSize(image)));
+    if (!PotraceProcess::available()) {
+        throw std::runtime_error("Potrace is not installed. Please install it first.");
+    }
+    
+    CallMeter meter(stats_);
+    StageClock clock(stats_);
+    
+    // The whole bitmap is kept; it is 1/8 of the gray image. It is metered
+    // as a whole, since paths cross tiles and the caps are per image.
+    const PosterizeTable table = makePosterizeTable(step);
+    const ComplexityLimits& limits = ComplexityGuard::limits();
+    ComplexityMeter complexity;
+    bool guarded = limits.maxEdges > 0 || limits.maxComponents > 0;
+    std::vector<uint8_t> bitmap;
+    PackedBitmapSink sink(bitmap, step > 1 ? &table : nullptr, guarded ? &complexity : nullptr);
+    decodeRows(image, sink, step > 1 ? "Failed to load image for posterization" : "Failed to load image");
+    clock.lap("bitmap");
+    int width = sink.width();
+    int height = sink.height();
+    if (stats_.width == 0) {
+        stats_.width = width;
+        stats_.height = height;
+        stats_.channels = sink.channels();
+    }
+    stats_.edges = complexity.edges();
+    stats_.components = complexity.components();
+    
+    // Byte-aligned tiles, so a tile's rows are plain slices of the packed
+    // rows and the padding bits of the last column are already clear
+    int tileSize = std::max(8, (cache.tileSize + 7) / 8 * 8);
+    int columns = (width + tileSize - 1) / tileSize;
+    int rows = (height + tileSize - 1) / tileSize;
+    size_t packedBytes = (static_cast<size_t>(width) + 7) / 8;
+    size_t tileCount = static_cast<size_t>(columns) * rows;
+    bool reuse = cache.width == width && cache.height == height && cache.step == step &&
+                 cache.tileSize == tileSize && cache.tiles.size() == tileCount;
+    
+    // Tiles whose bits differ from the cached bitmap, and tiles with no ink
+    std::vector<char> changed(tileCount, 1), blank(tileCount, 1);
+    size_t changedCount = 0;
+    for (int ty = 0; ty < rows; ++ty) {
+        for (int tx = 0; tx < columns; ++tx) {
+            int x0 = tx * tileSize, y0 = ty * tileSize;
+            int tileHeight = std::min(tileSize, height - y0);
+            size_t offset = static_cast<size_t>(x0 / 8);
+            size_t tileBytes = (static_cast<size_t>(std::min(tileSize, width - x0)) + 7) / 8;
+            size_t index = static_cast<size_t>(ty) * columns + tx;
+            bool differs = !reuse;
+            bool empty = true;
+            for (int y = y0; y < y0 + tileHeight; ++y) {
+                const uint8_t* bits = bitmap.data() + static_cast<size_t>(y) * packedBytes + offset;
+                differs = differs || std::memcmp(bits, cache.bitmap.data() + (bits - bitmap.data()), tileBytes) != 0;
+                empty = empty && std::all_of(bits, bits + tileBytes, [](uint8_t b) { return b == 0; });
+            }
+            changed[index] = differs;
+            blank[index] = empty;
+            changedCount += differs;
+        }
+    }
+    
+    // Nothing to splice: one potrace over the whole bitmap, as a one-shot
+    // conversion does, so no path is cut at a tile edge. The tiles are
+    // traced when an edit first needs them.
+    if (cache.wholeFirst && changedCount == tileCount) {
+        PotraceProcess potrace;
+        std::string header = "P4\n" + std::to_string(width) + " " + std::to_string(height) + "\n";
+        potrace.write(header.data(), header.size());
+        potrace.write(bitmap.data(), bitmap.size());
+        std::pmr::string svgContent = potrace.finish();
+        stats_.potraceCpuMs += potrace.cpuMs();
+        clock.lap("potrace");
+        cache.width = width;
+        cache.height = height;
+        cache.step = step;
+        cache.tileSize = tileSize;
+        cache.bitmap.swap(bitmap);
+        cache.tiles.assign(tileCount, std::string());
+        cache.tilesCurrent = false;
+        cache.tilesTraced = tileCount;
+        return finishTrace(std::move(svgContent), image, step, colors);
+    }
+    if (!reuse || !cache.tilesCurrent) {
+        cache.tiles.assign(tileCount, std::string());
+        std::fill(changed.begin(), changed.end(), 1);
+    }
+    
+    cache.tilesTraced = 0;
+    for (int ty = 0; ty < rows; ++ty) {
+        for (int tx = 0; tx < columns; ++tx) {
+            int x0 = tx * tileSize, y0 = ty * tileSize;
+            int tileWidth = std::min(tileSize, width - x0);
+            int tileHeight = std::min(tileSize, height - y0);
+            size_t offset = static_cast<size_t>(x0 / 8);
+            size_t tileBytes = (static_cast<size_t>(tileWidth) + 7) / 8;
+            size_t index = static_cast<size_t>(ty) * columns + tx;
+            if (!changed[index]) {
+                continue;
+            }
+            
+            std::string& tile = cache.tiles[index];
+            tile.clear();
+            cache.tilesTraced++;
+            if (blank[index]) {
+                continue;
+            }
+            PotraceProcess potrace;
+            std::string header = "P4\n" + std::to_string(tileWidth) + " " + std::to_string(tileHeight) + "\n";
+            potrace.write(header.data(), header.size());
+            for (int y = y0; y < y0 + tileHeight; ++y) {
+                potrace.write(bitmap.data() + static_cast<size_t>(y) * packedBytes + offset, tileBytes);
+            }
+            std::pmr::string traced = potrace.finish();
+            stats_.potraceCpuMs += potrace.cpuMs();
+            tile = spliceableTile(traced, x0, y0);
+        }
+    }
+    clock.lap("potrace");
+    
+    cache.width = width;
+    cache.height = height;
+    cache.step = step;
+    cache.tileSize = tileSize;
+    cache.bitmap.swap(bitmap);
+    cache.tilesCurrent = true;
+    
+    // One document in potrace's layout, the tiles in place
+    char header[256];
+    std::snprintf(header, sizeof(header),
+                  "<?xml version=\"1.0\" standalone=\"no\"?>\n"
+                  "<svg version=\"1.0\" xmlns=\"http://www.w3.org/2000/svg\"\n"
+                  " width=\"%d.000000pt\" height=\"%d.000000pt\" viewBox=\"0 0 %d.000000 %d.000000\"\n"
+                  " preserveAspectRatio=\"xMidYMid meet\">\n",
+                  width, height, width, height);
+    std::pmr::string svgContent(header, JobArena::current());
+    for (const auto& tile : cache.tiles) {
+        svgContent += tile;
+    }
+    svgContent += "</svg>\n";
+    clock.lap("splice");
+    return finishTrace(std::move(svgContent), image, step, colors);
+}
+
 std::vector<VectorizationOption> Vectorizer::inspectImage(const std::string& imageName) {
-    std::string imagePath = "./" + imageName + ".png";
+    ArenaScope scope;
+    return inspectSource(ImageSource{"./" + imageName + ".png"});
+}
+
+std::vector<VectorizationOption> Vectorizer::inspectImage(const uint8_t* data, size_t size) {
+    ArenaScope scope;
+    ImageSource image;
+    image.data = data;
+    image.size = size;
+    return inspectSource(image);
+}
+
+std::vector<VectorizationOption> Vectorizer::inspectSource(const ImageSource& image) {
     std::vector<VectorizationOption> options;
     
-    // Get pixel data
-    PixelData data = getPixels(imagePath);
-    
-    // Extract dominant colors (simplified version)
-    std::vector<std::string> palette = extractDominantColors(data, 5);
+    // Images too large for the resident limit are processed out of core
+    ScratchScope scratch(ScratchSpace::exceedsLimit(decodedSize(image)));
+    
+    CallMeter meter(stats_);
+    StageClock clock(stats_);
+    
+    // Extract dominant colors (simplified version) while the image decodes
+    ColorHistogramSink histogram;
+    decodeRows(image, histogram, "Failed to load image: " + image.path);
+    std::vector<std::string> palette = histogram.topColors(5);
+    clock.lap("inspect");
+    stats_.width = histogram.width();
+    stats_.height = histogram.height();
+    stats_.channels = histogram.channels();
+    stats_.palette = palette;
     
     if (palette.empty()) {
         // Default to black
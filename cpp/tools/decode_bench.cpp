@@ -0,0 +1,182 @@
+// Compare PngStreamDecoder against stb_image on a set of PNG files.
+//
+// Usage: decode_bench [--iterations N] <file.png|directory>...
+//
+// Each file is read into memory once, so only decoding is timed. Both
+// decoders are run N times per file and the median is reported; the
+// decoded pixels are compared once to make sure the fast path matches stb.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "png_stream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps the decoded image, or just a checksum when timing
+class CollectSink : public RowSink {
+public:
+    explicit CollectSink(bool keep) : keep_(keep) {}
+
+    void begin(int width, int height, int channels) override {
+        width_ = width;
+        height_ = height;
+        channels_ = channels;
+        if (keep_) pixels_.resize(static_cast<size_t>(width) * height * channels);
+    }
+
+    void rows(int y, int count, const uint8_t* data, size_t stride) override {
+        size_t rowBytes = static_cast<size_t>(width_) * channels_;
+        for (int i = 0; i < count; ++i) {
+            const uint8_t* row = data + i * stride;
+            if (keep_) {
+                std::memcpy(pixels_.data() + static_cast<size_t>(y + i) * rowBytes, row, rowBytes);
+            } else {
+                checksum_ += row[0] + row[rowBytes - 1];
+            }
+        }
+    }
+
+    int width_ = 0;
+    int height_ = 0;
+    int channels_ = 0;
+    std::vector<uint8_t> pixels_;
+    uint64_t checksum_ = 0;
+
+private:
+    bool keep_;
+};
+
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+template <typename Fn>
+double timeMs(Fn&& fn) {
+    auto start = Clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+std::vector<uint8_t> readFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int iterations = 20;
+    std::vector<fs::path> files;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::max(1, std::stoi(argv[++i]));
+        } else if (fs::is_directory(arg)) {
+            for (const auto& entry : fs::directory_iterator(arg)) {
+                std::string ext = entry.path().extension().string();
+                if (entry.is_regular_file() && (ext == ".png" || ext == ".PNG")) {
+                    files.push_back(entry.path());
+                }
+            }
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty()) {
+        std::cerr << "用法: decode_bench [--iterations N] <PNG文件或目录>..." << std::endl;
+        return 1;
+    }
+    std::sort(files.begin(), files.end());
+
+    double totalStb = 0, totalStream = 0, totalPixelBytes = 0;
+    int mismatches = 0, fallbacks = 0;
+
+    std::printf("%-32s %12s %10s %10s %8s\n", "file", "size", "stb ms", "stream ms", "speedup");
+    for (const auto& path : files) {
+        std::vector<uint8_t> data = readFile(path);
+        PngStreamDecoder decoder;
+
+        // Correctness check against stb
+        int width, height, channels;
+        stbi_uc* reference = stbi_load_from_memory(data.data(), static_cast<int>(data.size()),
+                                                   &width, &height, &channels, 0);
+        CollectSink collected(true);
+        bool streamed = false;
+        try {
+            streamed = decoder.decode(data.data(), data.size(), collected);
+        } catch (const std::exception& e) {
+            std::cerr << path.filename().string() << ": " << e.what() << std::endl;
+        }
+        if (!reference) {
+            std::cerr << path.filename().string() << ": stb 无法解码, 跳过" << std::endl;
+            continue;
+        }
+        size_t pixelBytes = static_cast<size_t>(width) * height * channels;
+        if (!streamed) {
+            ++fallbacks;
+        } else if (collected.width_ != width || collected.height_ != height ||
+                   collected.channels_ != channels ||
+                   std::memcmp(collected.pixels_.data(), reference, pixelBytes) != 0) {
+            std::cerr << path.filename().string() << ": 解码结果与stb不一致" << std::endl;
+            ++mismatches;
+        }
+        stbi_image_free(reference);
+
+        std::vector<double> stbTimes, streamTimes;
+        for (int i = 0; i < iterations; ++i) {
+            stbTimes.push_back(timeMs([&] {
+                int w, h, c;
+                stbi_image_free(stbi_load_from_memory(data.data(), static_cast<int>(data.size()),
+                                                      &w, &h, &c, 0));
+            }));
+            if (streamed) {
+                streamTimes.push_back(timeMs([&] {
+                    CollectSink sink(false);
+                    decoder.decode(data.data(), data.size(), sink);
+                }));
+            }
+        }
+
+        double stbMs = median(stbTimes);
+        double streamMs = streamed ? median(streamTimes) : stbMs;
+        totalStb += stbMs;
+        totalStream += streamMs;
+        totalPixelBytes += static_cast<double>(pixelBytes);
+
+        char size[32];
+        std::snprintf(size, sizeof(size), "%dx%dx%d", width, height, channels);
+        std::printf("%-32s %12s %10.3f %10.3f %7.2fx%s\n", path.filename().string().c_str(), size,
+                    stbMs, streamMs, stbMs / streamMs, streamed ? "" : " (stb)");
+    }
+
+    double mb = totalPixelBytes / (1024.0 * 1024.0);
+    std::printf("\n合计: stb %.3f ms (%.1f MB/s), stream %.3f ms (%.1f MB/s), 加速 %.2fx\n",
+                totalStb, mb / (totalStb / 1000.0), totalStream, mb / (totalStream / 1000.0),
+                totalStb / totalStream);
+    if (fallbacks > 0) {
+        std::printf("回退到stb: %d 个文件\n", fallbacks);
+    }
+    if (mismatches > 0) {
+        std::printf("不一致: %d 个文件\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,711 @@
+// Write a deterministic corpus of PNG images for benchmarks.
+//
+// Usage: make_corpus [--huge] [--pathological] [--gif] [--sizes N,N,...]
+//                    [--only CATEGORY] [--seed N] <directory>
+//
+// Each category imitates one kind of input we convert in production, in
+// the pixel formats it usually arrives in:
+//
+//   logo       flat shapes in a few colors            RGB, RGBA
+//   lineart    anti-aliased strokes on paper          L, LA
+//   gradient   smooth linear and radial blends        L, RGB
+//   pixelart   upscaled sprites with hard edges       RGBA
+//   scan       noisy paper with rows of dark text     L
+//   texture    photo-like multi-octave noise          RGB
+//   icon       rounded tile, soft shadow, highlight   LA, RGBA
+//
+// --pathological writes worst cases for the tracer instead, images whose
+// bitmap has a boundary at nearly every pixel:
+//
+//   noise      independent random pixels              L, RGB
+//   checker    one-pixel checkerboard                 L
+//   dither     ordered-dithered gradient              L
+//   speckle    sparse random dots on white            L
+//
+// Images are square, 16 to 4096 pixels a side by default; --huge adds
+// 8192 and 16384. Every pixel is a pure function of the seed, category,
+// size and position computed with integer hashing and basic float
+// arithmetic only, so the same arguments give byte-identical files on
+// every platform and no download is ever needed.
+//
+// --gif writes one animated GIF per category and size instead of PNGs:
+// the RGB image in a 3-3-2 palette with a dark square crossing it over
+// 12 frames, so most tiles of a frame repeat the frame before it.
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Rgba {
+    float r, g, b, a;   // 0..1, straight alpha
+};
+
+// Stateless integer hash (lowbias32); everything random goes through this
+uint32_t mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+uint32_t hash(uint32_t seed, uint32_t a, uint32_t b = 0, uint32_t c = 0) {
+    return mix(seed ^ mix(a ^ mix(b ^ mix(c))));
+}
+
+// Uniform in [0, 1)
+float unit(uint32_t h) {
+    return static_cast<float>(h >> 8) * (1.0f / 16777216.0f);
+}
+
+float clamp01(float v) {
+    return std::min(1.0f, std::max(0.0f, v));
+}
+
+float lerp(float a, float b, float t) {
+    return a + (b - a) * t;
+}
+
+Rgba lerp(const Rgba& a, const Rgba& b, float t) {
+    return {lerp(a.r, b.r, t), lerp(a.g, b.g, t), lerp(a.b, b.b, t), lerp(a.a, b.a, t)};
+}
+
+// Source-over compositing of `top` with coverage `cover` onto `dst`
+void blend(Rgba& dst, const Rgba& top, float cover) {
+    float a = top.a * cover;
+    float outA = a + dst.a * (1 - a);
+    if (outA <= 0) {
+        dst = {0, 0, 0, 0};
+        return;
+    }
+    dst.r = (top.r * a + dst.r * dst.a * (1 - a)) / outA;
+    dst.g = (top.g * a + dst.g * dst.a * (1 - a)) / outA;
+    dst.b = (top.b * a + dst.b * dst.a * (1 - a)) / outA;
+    dst.a = outA;
+}
+
+// Pixel coverage of a shape given the signed distance (pixels) to its edge
+float coverage(float distance) {
+    return clamp01(0.5f - distance);
+}
+
+float segmentDistance(float px, float py, float ax, float ay, float bx, float by) {
+    float dx = bx - ax, dy = by - ay;
+    float len2 = dx * dx + dy * dy;
+    float t = len2 > 0 ? clamp01(((px - ax) * dx + (py - ay) * dy) / len2) : 0;
+    float ex = px - (ax + t * dx), ey = py - (ay + t * dy);
+    return std::sqrt(ex * ex + ey * ey);
+}
+
+// Signed distance to a rectangle with rounded corners, centred on (cx, cy)
+float roundedBoxDistance(float px, float py, float cx, float cy, float halfW, float halfH, float radius) {
+    float qx = std::fabs(px - cx) - halfW + radius;
+    float qy = std::fabs(py - cy) - halfH + radius;
+    float ox = std::max(qx, 0.0f), oy = std::max(qy, 0.0f);
+    return std::sqrt(ox * ox + oy * oy) + std::min(std::max(qx, qy), 0.0f) - radius;
+}
+
+uint32_t nameHash(const char* name) {
+    uint32_t h = 2166136261u;   // FNV-1a
+    for (; *name; ++name) {
+        h = (h ^ static_cast<uint8_t>(*name)) * 16777619u;
+    }
+    return h;
+}
+
+Rgba paletteColor(uint32_t seed, uint32_t index) {
+    uint32_t h = hash(seed, 0xC0105u, index);
+    return {unit(h), unit(mix(h + 1)), unit(mix(h + 2)), 1};
+}
+
+// Smoothly interpolated lattice noise in [0, 1)
+float valueNoise(uint32_t seed, float x, float y) {
+    float fx = std::floor(x), fy = std::floor(y);
+    auto ix = static_cast<uint32_t>(static_cast<int32_t>(fx));
+    auto iy = static_cast<uint32_t>(static_cast<int32_t>(fy));
+    float tx = x - fx, ty = y - fy;
+    tx = tx * tx * (3 - 2 * tx);
+    ty = ty * ty * (3 - 2 * ty);
+    float v00 = unit(hash(seed, ix, iy)), v10 = unit(hash(seed, ix + 1, iy));
+    float v01 = unit(hash(seed, ix, iy + 1)), v11 = unit(hash(seed, ix + 1, iy + 1));
+    return lerp(lerp(v00, v10, tx), lerp(v01, v11, tx), ty);
+}
+
+// Pixel generator for one category; (x, y) is the pixel centre in pixels
+class Pattern {
+public:
+    virtual ~Pattern() = default;
+    virtual Rgba at(float x, float y) const = 0;
+};
+
+class LogoPattern : public Pattern {
+public:
+    LogoPattern(uint32_t seed, int size) : size_(static_cast<float>(size)) {
+        int count = 3 + static_cast<int>(hash(seed, 1) % 3);
+        for (int i = 0; i < count; ++i) {
+            uint32_t h = hash(seed, 2, i);
+            Shape s;
+            s.kind = h % 3;
+            s.cx = (0.25f + 0.5f * unit(mix(h + 1))) * size_;
+            s.cy = (0.25f + 0.5f * unit(mix(h + 2))) * size_;
+            s.extent = (0.12f + 0.2f * unit(mix(h + 3))) * size_;
+            s.color = paletteColor(seed, i % 4);
+            shapes_.push_back(s);
+        }
+    }
+
+    Rgba at(float x, float y) const override {
+        Rgba pixel = {1, 1, 1, 0};
+        for (const Shape& s : shapes_) {
+            float d;
+            if (s.kind == 0) {   // disc
+                d = std::sqrt((x - s.cx) * (x - s.cx) + (y - s.cy) * (y - s.cy)) - s.extent;
+            } else if (s.kind == 1) {   // ring
+                float r = std::sqrt((x - s.cx) * (x - s.cx) + (y - s.cy) * (y - s.cy));
+                d = std::fabs(r - s.extent) - s.extent * 0.18f;
+            } else {   // box
+                d = roundedBoxDistance(x, y, s.cx, s.cy, s.extent, s.extent * 0.6f, 0);
+            }
+            blend(pixel, s.color, coverage(d));
+        }
+        return pixel;
+    }
+
+private:
+    struct Shape {
+        uint32_t kind;
+        float cx, cy, extent;
+        Rgba color;
+    };
+
+    float size_;
+    std::vector<Shape> shapes_;
+};
+
+class LineArtPattern : public Pattern {
+public:
+    LineArtPattern(uint32_t seed, int size) {
+        float s = static_cast<float>(size);
+        halfWidth_ = std::max(0.6f, s / 400.0f);
+        for (int i = 0; i < 12; ++i) {
+            uint32_t h = hash(seed, 3, i);
+            Stroke stroke;
+            stroke.ax = unit(h) * s;
+            stroke.ay = unit(mix(h + 1)) * s;
+            stroke.bx = unit(mix(h + 2)) * s;
+            stroke.by = unit(mix(h + 3)) * s;
+            stroke.circle = i % 3 == 0;
+            strokes_.push_back(stroke);
+        }
+    }
+
+    Rgba at(float x, float y) const override {
+        float ink = 0;
+        for (const Stroke& st : strokes_) {
+            float d;
+            if (st.circle) {
+                float r = std::sqrt((st.bx - st.ax) * (st.bx - st.ax) + (st.by - st.ay) * (st.by - st.ay)) * 0.3f;
+                d = std::fabs(std::sqrt((x - st.ax) * (x - st.ax) + (y - st.ay) * (y - st.ay)) - r);
+            } else {
+                d = segmentDistance(x, y, st.ax, st.ay, st.bx, st.by);
+            }
+            ink = std::max(ink, coverage(d - halfWidth_));
+        }
+        // Black ink; formats without alpha composite it onto white paper
+        return {0, 0, 0, ink};
+    }
+
+private:
+    struct Stroke {
+        float ax, ay, bx, by;
+        bool circle;
+    };
+
+    float halfWidth_;
+    std::vector<Stroke> strokes_;
+};
+
+class GradientPattern : public Pattern {
+public:
+    GradientPattern(uint32_t seed, int size)
+        : size_(static_cast<float>(size)),
+          from_(paletteColor(seed, 0)), to_(paletteColor(seed, 1)), centre_(paletteColor(seed, 2)) {}
+
+    Rgba at(float x, float y) const override {
+        float u = x / size_, v = y / size_;
+        Rgba linear = lerp(from_, to_, clamp01(0.6f * u + 0.4f * v));
+        float dx = u - 0.35f, dy = v - 0.4f;
+        float radial = clamp01(1 - std::sqrt(dx * dx + dy * dy) * 2.2f);
+        return lerp(linear, centre_, radial * radial);
+    }
+
+private:
+    float size_;
+    Rgba from_, to_, centre_;
+};
+
+class PixelArtPattern : public Pattern {
+public:
+    PixelArtPattern(uint32_t seed, int size)
+        : seed_(seed), cells_(size >= 32 ? 32 : 16), cellSize_(static_cast<float>(size) / cells_) {}
+
+    Rgba at(float x, float y) const override {
+        int cx = std::min(cells_ - 1, static_cast<int>(x / cellSize_));
+        int cy = std::min(cells_ - 1, static_cast<int>(y / cellSize_));
+        // Mirrored left to right like most sprites, with an empty margin
+        int mx = std::min(cx, cells_ - 1 - cx);
+        int margin = cells_ / 8;
+        if (mx < margin || cy < margin || cy >= cells_ - margin) {
+            return {0, 0, 0, 0};
+        }
+        uint32_t h = hash(seed_, 4, mx, cy);
+        if (h % 5 == 0) {
+            return {0, 0, 0, 0};
+        }
+        return paletteColor(seed_, (h >> 3) % 8);
+    }
+
+private:
+    uint32_t seed_;
+    int cells_;
+    float cellSize_;
+};
+
+class ScanPattern : public Pattern {
+public:
+    ScanPattern(uint32_t seed, int size)
+        : seed_(seed), size_(static_cast<float>(size)), line_(std::max(4.0f, size_ / 24.0f)) {}
+
+    Rgba at(float x, float y) const override {
+        float u = x / size_, v = y / size_;
+        // Paper: slightly uneven, darker towards the edges, with grain
+        float paper = 0.9f - 0.08f * ((u - 0.5f) * (u - 0.5f) + (v - 0.5f) * (v - 0.5f));
+        paper += 0.03f * (valueNoise(seed_, x / 37.0f, y / 37.0f) - 0.5f);
+        auto px = static_cast<uint32_t>(x), py = static_cast<uint32_t>(y);
+        paper += 0.08f * (unit(hash(seed_, 5, px, py)) - 0.5f);
+
+        // Text: words on every other line band inside the margins
+        float ink = 0;
+        int row = static_cast<int>(y / line_);
+        float inRow = y / line_ - row;
+        if (row % 2 == 1 && u > 0.08f && u < 0.92f && inRow > 0.2f && inRow < 0.8f) {
+            int word = static_cast<int>(x / (line_ * 2.5f));
+            if (hash(seed_, 6, row, word) % 4 != 0) {
+                ink = 0.75f + 0.2f * unit(hash(seed_, 7, px, py));
+            }
+        }
+        // Dust
+        if (hash(seed_, 8, px, py) % 4000 == 0) {
+            ink = 0.6f;
+        }
+        float value = clamp01(paper * (1 - ink));
+        return {value, value, value, 1};
+    }
+
+private:
+    uint32_t seed_;
+    float size_;
+    float line_;
+};
+
+class TexturePattern : public Pattern {
+public:
+    TexturePattern(uint32_t seed, int size)
+        : seed_(seed), scale_(static_cast<float>(size) / 8.0f),
+          dark_(paletteColor(seed, 3)), light_(paletteColor(seed, 4)) {}
+
+    Rgba at(float x, float y) const override {
+        float value = 0, amplitude = 0.5f, frequency = 1 / scale_;
+        for (int octave = 0; octave < 5; ++octave) {
+            value += amplitude * valueNoise(seed_ + octave, x * frequency, y * frequency);
+            amplitude *= 0.5f;
+            frequency *= 2;
+        }
+        float grain = 0.06f * (unit(hash(seed_, 9, static_cast<uint32_t>(x), static_cast<uint32_t>(y))) - 0.5f);
+        Rgba pixel = lerp(dark_, light_, clamp01(value * 1.1f + grain));
+        pixel.a = 1;
+        return pixel;
+    }
+
+private:
+    uint32_t seed_;
+    float scale_;
+    Rgba dark_, light_;
+};
+
+class IconPattern : public Pattern {
+public:
+    IconPattern(uint32_t seed, int size)
+        : size_(static_cast<float>(size)), tile_(paletteColor(seed, 5)), glyph_(paletteColor(seed, 6)) {}
+
+    Rgba at(float x, float y) const override {
+        float c = size_ * 0.5f, half = size_ * 0.36f, radius = size_ * 0.1f;
+        Rgba pixel = {0, 0, 0, 0};
+
+        // Soft shadow, offset down
+        float shadow = roundedBoxDistance(x, y, c, c + size_ * 0.04f, half, half, radius);
+        float falloff = clamp01(1 - shadow / (size_ * 0.06f));
+        blend(pixel, {0, 0, 0, 0.45f}, falloff * falloff);
+
+        blend(pixel, tile_, coverage(roundedBoxDistance(x, y, c, c, half, half, radius)));
+
+        float r = std::sqrt((x - c) * (x - c) + (y - c) * (y - c));
+        blend(pixel, glyph_, coverage(std::fabs(r - size_ * 0.18f) - size_ * 0.04f));
+
+        // Translucent glossy highlight over the top half of the tile
+        if (y < c) {
+            float highlight = coverage(roundedBoxDistance(x, y, c, c, half, half, radius));
+            blend(pixel, {1, 1, 1, 0.35f * (1 - (y - (c - half)) / half)}, highlight);
+        }
+        return pixel;
+    }
+
+private:
+    float size_;
+    Rgba tile_, glyph_;
+};
+
+class NoisePattern : public Pattern {
+public:
+    NoisePattern(uint32_t seed, int) : seed_(seed) {}
+
+    Rgba at(float x, float y) const override {
+        uint32_t h = hash(seed_, 10, static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+        return {unit(h), unit(mix(h + 1)), unit(mix(h + 2)), 1};
+    }
+
+private:
+    uint32_t seed_;
+};
+
+class CheckerPattern : public Pattern {
+public:
+    CheckerPattern(uint32_t, int) {}
+
+    Rgba at(float x, float y) const override {
+        float value = (static_cast<int>(x) + static_cast<int>(y)) % 2 ? 1.0f : 0.0f;
+        return {value, value, value, 1};
+    }
+};
+
+class DitherPattern : public Pattern {
+public:
+    DitherPattern(uint32_t, int size) : size_(static_cast<float>(size)) {}
+
+    Rgba at(float x, float y) const override {
+        static const int bayer[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+        auto px = static_cast<int>(x), py = static_cast<int>(y);
+        float threshold = (bayer[py % 4][px % 4] + 0.5f) / 16.0f;
+        float value = (x + y) / (2 * size_) < threshold ? 0.0f : 1.0f;
+        return {value, value, value, 1};
+    }
+
+private:
+    float size_;
+};
+
+class SpecklePattern : public Pattern {
+public:
+    SpecklePattern(uint32_t seed, int) : seed_(seed) {}
+
+    Rgba at(float x, float y) const override {
+        uint32_t h = hash(seed_, 11, static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+        float value = h % 8 == 0 ? 0.0f : 1.0f;
+        return {value, value, value, 1};
+    }
+
+private:
+    uint32_t seed_;
+};
+
+struct Category {
+    const char* name;
+    std::vector<int> channels;   // 1 = L, 2 = LA, 3 = RGB, 4 = RGBA
+    Pattern* (*make)(uint32_t seed, int size);
+    bool pathological = false;   // only with --pathological
+};
+
+template <typename T>
+Pattern* makePattern(uint32_t seed, int size) {
+    return new T(seed, size);
+}
+
+const std::vector<Category>& categories() {
+    static const std::vector<Category> list = {
+        {"logo", {3, 4}, makePattern<LogoPattern>},
+        {"lineart", {1, 2}, makePattern<LineArtPattern>},
+        {"gradient", {1, 3}, makePattern<GradientPattern>},
+        {"pixelart", {4}, makePattern<PixelArtPattern>},
+        {"scan", {1}, makePattern<ScanPattern>},
+        {"texture", {3}, makePattern<TexturePattern>},
+        {"icon", {2, 4}, makePattern<IconPattern>},
+        {"noise", {1, 3}, makePattern<NoisePattern>, true},
+        {"checker", {1}, makePattern<CheckerPattern>, true},
+        {"dither", {1}, makePattern<DitherPattern>, true},
+        {"speckle", {1}, makePattern<SpecklePattern>, true},
+    };
+    return list;
+}
+
+const char* modeName(int channels) {
+    switch (channels) {
+        case 1: return "l";
+        case 2: return "la";
+        case 3: return "rgb";
+        default: return "rgba";
+    }
+}
+
+uint8_t toByte(float v) {
+    return static_cast<uint8_t>(clamp01(v) * 255.0f + 0.5f);
+}
+
+// Render one image row by row in the requested pixel format. Formats
+// without alpha are composited onto white, as a viewer would show them.
+std::vector<uint8_t> render(const Pattern& pattern, int size, int channels) {
+    std::vector<uint8_t> pixels(static_cast<size_t>(size) * size * channels);
+    uint8_t* out = pixels.data();
+    bool alpha = channels == 2 || channels == 4;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            Rgba p = pattern.at(x + 0.5f, y + 0.5f);
+            if (!alpha) {
+                p = {lerp(1, p.r, p.a), lerp(1, p.g, p.a), lerp(1, p.b, p.a), 1};
+            }
+            if (channels <= 2) {
+                // Rec. 601 luma
+                *out++ = toByte(0.299f * p.r + 0.587f * p.g + 0.114f * p.b);
+            } else {
+                *out++ = toByte(p.r);
+                *out++ = toByte(p.g);
+                *out++ = toByte(p.b);
+            }
+            if (alpha) {
+                *out++ = toByte(p.a);
+            }
+        }
+    }
+    return pixels;
+}
+
+constexpr int kGifFrames = 12;
+
+// Palette index of an RGB pixel: 3 bits red, 3 green, 2 blue
+uint8_t paletteIndex(const uint8_t* rgb) {
+    return static_cast<uint8_t>((rgb[0] & 0xE0) | ((rgb[1] & 0xE0) >> 3) | (rgb[2] >> 6));
+}
+
+// GIF89a of `rgb` with a square of a quarter of the side moving from the
+// top-left to the bottom-right corner. The LZW streams are literal 9-bit
+// codes with a clear code every 250 pixels, so no encoder is needed and
+// the bytes depend on the pixels alone.
+std::vector<uint8_t> animatedGif(const std::vector<uint8_t>& rgb, int size) {
+    std::vector<uint8_t> gif = {'G', 'I', 'F', '8', '9', 'a'};
+    auto word = [&](int v) {
+        gif.push_back(static_cast<uint8_t>(v & 0xFF));
+        gif.push_back(static_cast<uint8_t>(v >> 8));
+    };
+    word(size);
+    word(size);
+    gif.insert(gif.end(), {0xF7, 0, 0});
+    for (int i = 0; i < 256; ++i) {
+        gif.push_back(static_cast<uint8_t>((i >> 5) * 255 / 7));
+        gif.push_back(static_cast<uint8_t>(((i >> 2) & 7) * 255 / 7));
+        gif.push_back(static_cast<uint8_t>((i & 3) * 255 / 3));
+    }
+    // Loop forever
+    gif.insert(gif.end(), {0x21, 0xFF, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 3, 1, 0, 0, 0});
+
+    int square = std::max(1, size / 4);
+    for (int f = 0; f < kGifFrames; ++f) {
+        int corner = (size - square) * f / (kGifFrames - 1);
+        gif.insert(gif.end(), {0x21, 0xF9, 4, 0});
+        word(10);   // delay in 1/100 s
+        gif.insert(gif.end(), {0, 0, 0x2C});
+        word(0);
+        word(0);
+        word(size);
+        word(size);
+        gif.push_back(0);
+
+        std::vector<uint8_t> codes;
+        uint32_t bits = 0;
+        int count = 0;
+        auto emit = [&](uint32_t code) {
+            bits |= code << count;
+            count += 9;
+            while (count >= 8) {
+                codes.push_back(static_cast<uint8_t>(bits & 0xFF));
+                bits >>= 8;
+                count -= 8;
+            }
+        };
+        for (int i = 0; i < size * size; ++i) {
+            if (i % 250 == 0) emit(256);
+            int x = i % size, y = i / size;
+            bool inSquare = x >= corner && x < corner + square && y >= corner && y < corner + square;
+            emit(inSquare ? 0x20 : paletteIndex(rgb.data() + static_cast<size_t>(i) * 3));
+        }
+        emit(257);
+        if (count > 0) codes.push_back(static_cast<uint8_t>(bits));
+
+        gif.push_back(8);
+        for (size_t i = 0; i < codes.size(); i += 255) {
+            size_t n = std::min<size_t>(255, codes.size() - i);
+            gif.push_back(static_cast<uint8_t>(n));
+            gif.insert(gif.end(), codes.begin() + i, codes.begin() + i + n);
+        }
+        gif.push_back(0);
+    }
+    gif.push_back(0x3B);
+    return gif;
+}
+
+std::vector<int> parseSizes(const std::string& text) {
+    std::vector<int> sizes;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        int size = std::stoi(item);
+        if (size < 1 || size > 16384) {
+            throw std::runtime_error("尺寸超出范围(1-16384): " + item);
+        }
+        sizes.push_back(size);
+    }
+    return sizes;
+}
+
+void printUsage() {
+    std::cerr << "用法: make_corpus [--huge] [--pathological] [--gif] [--sizes N,N,...] [--only 类别] [--seed N] <输出目录>"
+              << std::endl;
+    for (bool pathological : {false, true}) {
+        std::cerr << (pathological ? "病态类别 (--pathological):" : "类别:");
+        for (const auto& category : categories()) {
+            if (category.pathological == pathological) {
+                std::cerr << " " << category.name;
+            }
+        }
+        std::cerr << std::endl;
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<int> sizes = {16, 64, 256, 1024, 4096};
+    std::string only;
+    bool pathological = false;
+    bool gif = false;
+    uint32_t seed = 1;
+    fs::path outDir;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--huge") {
+                sizes.push_back(8192);
+                sizes.push_back(16384);
+            } else if (arg == "--pathological") {
+                pathological = true;
+            } else if (arg == "--gif") {
+                gif = true;
+            } else if (arg == "--sizes" && i + 1 < argc) {
+                sizes = parseSizes(argv[++i]);
+            } else if (arg == "--only" && i + 1 < argc) {
+                only = argv[++i];
+            } else if (arg == "--seed" && i + 1 < argc) {
+                seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--help" || arg == "-h") {
+                printUsage();
+                return 0;
+            } else if (outDir.empty() && arg[0] != '-') {
+                outDir = arg;
+            } else {
+                printUsage();
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "参数错误: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (outDir.empty()) {
+        printUsage();
+        return 1;
+    }
+    fs::create_directories(outDir);
+
+    // Fixed compression settings so the encoded bytes never vary
+    stbi_write_png_compression_level = 8;
+    stbi_write_force_png_filter = -1;
+
+    int written = 0;
+    double totalBytes = 0;
+    for (const auto& category : categories()) {
+        if (category.pathological != pathological || (!only.empty() && only != category.name)) {
+            continue;
+        }
+        for (int size : sizes) {
+            uint32_t imageSeed = hash(seed, nameHash(category.name), size);
+            std::unique_ptr<Pattern> pattern(category.make(imageSeed, size));
+            if (gif) {
+                std::string name = std::string(category.name) + "_" + std::to_string(size) + ".gif";
+                fs::path path = outDir / name;
+                std::vector<uint8_t> bytes = animatedGif(render(*pattern, size, 3), size);
+                std::ofstream out(path, std::ios::binary | std::ios::trunc);
+                out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+                out.flush();
+                if (!out) {
+                    std::cerr << "写入失败: " << path.string() << std::endl;
+                    return 1;
+                }
+                totalBytes += static_cast<double>(bytes.size());
+                ++written;
+                std::printf("%-28s %10zu bytes\n", name.c_str(), bytes.size());
+                continue;
+            }
+            for (int channels : category.channels) {
+                std::string name = std::string(category.name) + "_" + std::to_string(size) + "_" +
+                                   modeName(channels) + ".png";
+                fs::path path = outDir / name;
+                std::vector<uint8_t> pixels = render(*pattern, size, channels);
+                if (!stbi_write_png(path.string().c_str(), size, size, channels, pixels.data(),
+                                    size * channels)) {
+                    std::cerr << "写入失败: " << path.string() << std::endl;
+                    return 1;
+                }
+                auto bytes = fs::file_size(path);
+                totalBytes += static_cast<double>(bytes);
+                ++written;
+                std::printf("%-28s %10llu bytes\n", name.c_str(), static_cast<unsigned long long>(bytes));
+            }
+        }
+    }
+
+    if (written == 0) {
+        std::cerr << "没有匹配的类别: " << only << std::endl;
+        printUsage();
+        return 1;
+    }
+    std::printf("\n已生成 %d 个文件 (%.1f MB) 到 %s\n", written, totalBytes / (1024.0 * 1024.0),
+                outDir.string().c_str());
+    return 0;
+}
@@ -0,0 +1,369 @@
+// Regression checks for the parts of the converter that have no other
+// coverage: allocator hooks used by stb_image, GIF decoding through them,
+// the placement of reduced frames in an animation, the complexity caps, the
+// content hash used to find duplicate inputs and the streaming PNG decoder
+// on malformed input.
+//
+// Usage: self_check
+//
+// Prints one line per check and exits 1 if any failed.
+
+#include "animation.h"
+#include "arena.h"
+#include "batch_io.h"
+#include "buffer_pool.h"
+#include "complexity.h"
+#include "png_stream.h"
+
+// A private stb_image on the default allocator, to compare against the
+// converter's own, which allocates from the job arena
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#include "stb_image.h"
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Pattern byte of offset i, so lost or shifted data is noticed
+uint8_t pattern(size_t i) {
+    return static_cast<uint8_t>((i * 131 + 7) >> 3);
+}
+
+void fill(uint8_t* p, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) p[i] = pattern(i);
+}
+
+// Index of the first byte in [0, size) that lost its pattern, or size
+size_t firstMismatch(const uint8_t* p, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (p[i] != pattern(i)) return i;
+    }
+    return size;
+}
+
+// A pool block grown in place and then moved keeps everything written to
+// it, the way stb_image grows a GIF's frame buffer one frame at a time
+std::string checkPoolRealloc() {
+    ArenaScope scope;
+    size_t size = size_t(256) << 10;
+    auto* p = static_cast<uint8_t*>(arenaMalloc(size));
+    if (!p) return "arenaMalloc failed";
+    fill(p, 0, size);
+
+    // Still inside the size class: grows in place
+    size_t grown = size + (size_t(32) << 10);
+    auto* q = static_cast<uint8_t*>(arenaRealloc(p, size, grown));
+    if (q != p) return "pool block within its size class was moved";
+    fill(q, size, grown);
+
+    // Beyond it: moves
+    size_t moved = size_t(1) << 20;
+    auto* r = static_cast<uint8_t*>(arenaRealloc(q, grown, moved));
+    if (!r) return "arenaRealloc failed";
+    size_t bad = firstMismatch(r, grown);
+    arenaFree(r);
+    if (bad != grown) {
+        return "byte " + std::to_string(bad) + " of " + std::to_string(grown) + " lost when the block moved";
+    }
+    return std::string();
+}
+
+// Uncompressed GIF89a: 256-color palette, each frame a full-canvas image
+// whose LZW stream is literal codes with a clear code every 250 pixels, so
+// the code size never grows past 9 bits
+std::vector<uint8_t> makeGif(int width, int height, int frames) {
+    std::vector<uint8_t> gif = {'G', 'I', 'F', '8', '9', 'a'};
+    auto word = [&](int v) {
+        gif.push_back(static_cast<uint8_t>(v & 0xFF));
+        gif.push_back(static_cast<uint8_t>(v >> 8));
+    };
+    word(width);
+    word(height);
+    gif.insert(gif.end(), {0xF7, 0, 0});
+    for (int i = 0; i < 256; ++i) {
+        gif.insert(gif.end(), {static_cast<uint8_t>(i), static_cast<uint8_t>(255 - i),
+                               static_cast<uint8_t>(i * 7)});
+    }
+    for (int f = 0; f < frames; ++f) {
+        gif.insert(gif.end(), {0x21, 0xF9, 4, 0});
+        word(5 + f);   // delay in 1/100 s
+        gif.insert(gif.end(), {0, 0, 0x2C});
+        word(0);
+        word(0);
+        word(width);
+        word(height);
+        gif.push_back(0);
+        
+        std::vector<uint8_t> codes;
+        uint32_t bits = 0;
+        int count = 0;
+        auto emit = [&](uint32_t code) {
+            bits |= code << count;
+            count += 9;
+            while (count >= 8) {
+                codes.push_back(static_cast<uint8_t>(bits & 0xFF));
+                bits >>= 8;
+                count -= 8;
+            }
+        };
+        for (int i = 0; i < width * height; ++i) {
+            if (i % 250 == 0) emit(256);
+            int x = i % width, y = i / width;
+            emit(static_cast<uint32_t>((x * 3 + y * 5 + f * 17) & 0xFF));
+        }
+        emit(257);
+        if (count > 0) codes.push_back(static_cast<uint8_t>(bits));
+        
+        gif.push_back(8);
+        for (size_t i = 0; i < codes.size(); i += 255) {
+            size_t n = std::min<size_t>(255, codes.size() - i);
+            gif.push_back(static_cast<uint8_t>(n));
+            gif.insert(gif.end(), codes.begin() + i, codes.begin() + i + n);
+        }
+        gif.push_back(0);
+    }
+    gif.push_back(0x3B);
+    return gif;
+}
+
+// decodeGif, whose frame buffer outgrows several pool size classes on the
+// way, returns every frame exactly as stb_image on the default allocator
+std::string checkGifFrames() {
+    const int width = 80, height = 64, frames = 24;
+    std::vector<uint8_t> gif = makeGif(width, height, frames);
+    
+    int* delays = nullptr;
+    int w = 0, h = 0, z = 0, channels = 0;
+    stbi_uc* expected = stbi_load_gif_from_memory(gif.data(), static_cast<int>(gif.size()), &delays,
+                                                  &w, &h, &z, &channels, 4);
+    if (!expected) return std::string("reference decode failed: ") + stbi_failure_reason();
+    std::vector<uint8_t> reference(expected, expected + static_cast<size_t>(w) * h * z * 4);
+    stbi_image_free(expected);
+    stbi_image_free(delays);
+    
+    GifFrames decoded;
+    try {
+        decoded = decodeGif(gif.data(), gif.size());
+    } catch (const std::exception& e) {
+        return e.what();
+    }
+    if (decoded.width != width || decoded.height != height || decoded.count != frames || z != frames) {
+        return "decoded " + std::to_string(decoded.count) + " frames of " + std::to_string(decoded.width) +
+               "x" + std::to_string(decoded.height);
+    }
+    if (decoded.delaysMs.size() != static_cast<size_t>(frames) || decoded.delaysMs.back() != (5 + frames - 1) * 10) {
+        return "frame delays not kept";
+    }
+    size_t frameBytes = static_cast<size_t>(width) * height * 4;
+    for (size_t i = 0; i < reference.size(); ++i) {
+        if (decoded.pixels[i] != reference[i]) {
+            return "frame " + std::to_string(i / frameBytes) + " differs from stb_image at byte " +
+                   std::to_string(i % frameBytes);
+        }
+    }
+    return std::string();
+}
+
+// A frame traced at half size after a complexity cap keeps its reduced
+// viewBox, and the animation scales it back to the canvas instead of drawing
+// it in the top-left quarter
+std::string checkDowngradedFrame() {
+    TracedAnimation animation;
+    animation.width = 80;
+    animation.height = 64;
+    animation.delaysMs = {100, 100};
+    const char* full = "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"80.000000pt\" height=\"64.000000pt\""
+                       " viewBox=\"0 0 80.000000 64.000000\"><path d=\"M0 0h80v64z\"/></svg>";
+    const char* reduced = "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"80.000000pt\" height=\"64.000000pt\""
+                          " viewBox=\"0 0 40.000000 32.000000\"><path d=\"M0 0h40v32z\"/></svg>";
+    animation.frames = {full, reduced};
+    std::string svg = animatedSvg(animation);
+    
+    std::string inlined = "repeatCount=\"indefinite\"/><path d=\"M0 0h80v64z\"/></g>";
+    std::string nested = "<svg viewBox=\"0 0 40.000000 32.000000\" width=\"80\" height=\"64\">"
+                         "<path d=\"M0 0h40v32z\"/></svg></g>";
+    if (svg.find(inlined) == std::string::npos) return "full-size frame not drawn in the canvas";
+    if (svg.find(nested) == std::string::npos) return "reduced frame not scaled to the canvas";
+    return std::string();
+}
+
+// A bitmap busy from the top stops the meter on the counts projected to the
+// full height, well before the raw counts reach the cap
+std::string checkComplexityProjection() {
+    const int width = 512, height = 512;
+    ComplexityLimits limits;
+    limits.maxEdges = 300000;   // a full checkerboard has about 524k
+    limits.maxComponents = 0;
+    ComplexityMeter meter;
+    meter.begin(width, height);
+    std::vector<uint8_t> row(width / 8);
+    for (int y = 0; y < height; ++y) {
+        std::fill(row.begin(), row.end(), y % 2 ? 0x55 : 0xAA);
+        meter.addRow(row.data());
+        try {
+            meter.check(limits);
+        } catch (const ComplexityExceeded& exceeded) {
+            if (meter.rows() > height / 4) {
+                return "stopped only after " + std::to_string(meter.rows()) + " rows";
+            }
+            if (exceeded.edges <= limits.maxEdges) {
+                return "reported " + std::to_string(exceeded.edges) + " edges, not the projection";
+            }
+            return std::string();
+        }
+    }
+    return "cap never hit";
+}
+
+// An empty input hashes without touching its (null) data pointer, and a
+// one-byte change anywhere, including the tail, changes the hash
+std::string checkContentHash() {
+    uint8_t empty = 0;
+    if (contentHash(nullptr, 0) != contentHash(&empty, 0)) {
+        return "empty input hash depends on the pointer";
+    }
+    std::vector<uint8_t> bytes(21);
+    for (size_t i = 0; i < bytes.size(); ++i) bytes[i] = pattern(i);
+    uint64_t base = contentHash(bytes.data(), bytes.size());
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        bytes[i] ^= 1;
+        bool same = contentHash(bytes.data(), bytes.size()) == base;
+        bytes[i] ^= 1;
+        if (same) return "hash ignores byte " + std::to_string(i);
+    }
+    return std::string();
+}
+
+// DEFLATE bits, least significant first; Huffman codes go most significant
+// bit first
+class BitWriter {
+public:
+    void put(uint32_t value, int bits) {
+        for (int i = 0; i < bits; ++i) push((value >> i) & 1);
+    }
+    void putCode(uint32_t code, int bits) {
+        for (int i = bits - 1; i >= 0; --i) push((code >> i) & 1);
+    }
+    std::vector<uint8_t> bytes() const { return out_; }
+
+private:
+    void push(uint32_t bit) {
+        if (used_ == 0) out_.push_back(0);
+        out_.back() |= static_cast<uint8_t>(bit << used_);
+        used_ = (used_ + 1) & 7;
+    }
+    std::vector<uint8_t> out_;
+    int used_ = 0;
+};
+
+uint32_t crc32(const uint8_t* p, size_t n, uint32_t crc = 0) {
+    crc = ~crc;
+    for (size_t i = 0; i < n; ++i) {
+        crc ^= p[i];
+        for (int k = 0; k < 8; ++k) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+// 1x1 8-bit gray PNG around the given zlib stream
+std::vector<uint8_t> makePng(const std::vector<uint8_t>& zlib) {
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    auto chunk = [&](const char* type, const std::vector<uint8_t>& data) {
+        uint32_t n = static_cast<uint32_t>(data.size());
+        for (int shift = 24; shift >= 0; shift -= 8) png.push_back(static_cast<uint8_t>(n >> shift));
+        size_t start = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data.begin(), data.end());
+        uint32_t crc = crc32(png.data() + start, png.size() - start);
+        for (int shift = 24; shift >= 0; shift -= 8) png.push_back(static_cast<uint8_t>(crc >> shift));
+    };
+    chunk("IHDR", {0, 0, 0, 1, 0, 0, 0, 1, 8, 0, 0, 0, 0});
+    chunk("IDAT", zlib);
+    chunk("IEND", {});
+    return png;
+}
+
+class DiscardSink : public RowSink {
+public:
+    void begin(int, int, int) override {}
+    void rows(int, int, const uint8_t*, size_t) override {}
+};
+
+// A dynamic block declaring HLIT=288 and HDIST=32, the field maxima, with
+// complete code lengths for all 320 symbols. RFC 1951 allows 286 and 30;
+// the decoder used to store all 320 lengths into a 318-entry array.
+std::string checkOversizedCodeLengths() {
+    BitWriter w;
+    w.put(1, 1);    // final block
+    w.put(2, 2);    // dynamic Huffman
+    w.put(31, 5);   // HLIT = 288
+    w.put(31, 5);   // HDIST = 32
+    w.put(15, 4);   // all 19 code length code lengths follow
+    // Code length symbols 5, 7, 8 and 9 get 2-bit codes 00, 01, 10, 11
+    static const int order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+    for (int symbol : order) {
+        w.put(symbol == 5 || symbol == 7 || symbol == 8 || symbol == 9 ? 2 : 0, 3);
+    }
+    // Literal/length lengths of the fixed code, then 32 distances of 5 bits
+    auto length = [&](int bits) { w.putCode(bits == 5 ? 0 : bits == 7 ? 1 : bits == 8 ? 2 : 3, 2); };
+    for (int i = 0; i < 288; ++i) length(i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8);
+    for (int i = 0; i < 32; ++i) length(5);
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    std::vector<uint8_t> deflate = w.bytes();
+    zlib.insert(zlib.end(), deflate.begin(), deflate.end());
+    zlib.resize(zlib.size() + 16, 0);
+    std::vector<uint8_t> png = makePng(zlib);
+
+    DiscardSink sink;
+    try {
+        PngStreamDecoder().decode(png.data(), png.size(), sink);
+    } catch (const std::exception& e) {
+        if (std::strstr(e.what(), "bad code lengths")) return std::string();
+        return std::string("rejected for another reason: ") + e.what();
+    }
+    return "accepted";
+}
+
+struct Check {
+    const char* name;
+    std::function<std::string()> run;
+};
+
+} // namespace
+
+int main() {
+    std::vector<Check> checks = {
+        {"pool realloc in place, then moved", checkPoolRealloc},
+        {"GIF frames match stb_image", checkGifFrames},
+        {"downgraded GIF frame scaled to the canvas", checkDowngradedFrame},
+        {"complexity caps compare projected counts", checkComplexityProjection},
+        {"content hash of empty and changed inputs", checkContentHash},
+        {"PNG with HLIT=288, HDIST=32 rejected", checkOversizedCodeLengths},
+    };
+    int failed = 0;
+    for (const auto& check : checks) {
+        std::string error = check.run();
+        if (error.empty()) {
+            std::printf("通过  %s\n", check.name);
+        } else {
+            std::printf("失败  %s: %s\n", check.name, error.c_str());
+            failed++;
+        }
+    }
+    std::printf("\n%zu 项检查, %d 项失败\n", checks.size(), failed);
+    return failed > 0 ? 1 : 0;
+}